@@ -1,6 +1,10 @@
 #include "Commit.h"
+#include "LogFormat.h"
+#include "Reachability.h"
 #include "Utils.h"
 #include <stdlib.h>
+#include <queue>
+#include <unordered_set>
 
 using namespace std;
 
@@ -34,7 +38,7 @@ Blob *list_find_name(const List *list, const string &name) {
     return nullptr;
 }
 
-Blob *list_put(List *list, const string &name, const string &ref) {
+Blob *list_put(List *list, const string &name, const ObjectId &ref) {
     Blob *find_blob = list_find_name(list, name);
     if(find_blob == nullptr){ //no blob with the same name exists in the linked list 
         Blob *new_node = new Blob;
@@ -131,12 +135,15 @@ int list_size(const List *list) {
 }
 
 void list_clear(List *list) {
-    Blob *last_node = list->head->prev;
-    Blob *blob = last_node;
+    // free the nodes front to back in one pass, without looking any of them up by name
+    Blob *blob = list->head->next;
     while(blob != list->head){
-        blob = blob->prev;
-        list_remove(list, blob->next->name);
+        Blob *next_blob = blob->next;
+        delete blob;
+        blob = next_blob;
     }
+    list->head->next = list->head;
+    list->head->prev = list->head;
 }
 
 void list_delete(List *list) {
@@ -145,139 +152,68 @@ void list_delete(List *list) {
 }
 
 void list_replace(List *list, const List *another) {
-
+    list_clear(list);
+    for (Blob *blob = another->head->next; blob != another->head; blob = blob->next) {
+        Blob *copy = new Blob;
+        copy->name = blob->name;
+        copy->ref = blob->ref;
+        copy->commit = blob->commit;
+        list_push_back(list, copy);
+    }
 }
 
 List *list_copy(const List *list) {
-    return nullptr;
+    List *copy = list_new();
+    list_replace(copy, list);
+    return copy;
 }
 
 // Part 2: Gitlite Commands
 
 // Print out the commit info. Used in log.
 void commit_print(const Commit *commit) {
-    cout << "commit " << commit->commit_id << endl;
-
-    if (commit->second_parent != nullptr) {
-        cout << "Merge: " << commit->parent->commit_id.substr(0, 7)
-             << " " << commit->second_parent->commit_id.substr(0, 7) << endl;
-    }
-
-    cout << "Date: " << commit->time << endl << commit->message;
+    string out;
+    LogFormat::standard().render(commit, out);
+    cout << out;
 }
 
+// Find the latest common ancestor, i.e. the common ancestor closest to c2.
+// Used to locate the split point (and the base version of each file) when merging.
 Commit *get_lca(Commit *c1, Commit *c2) {
-    return nullptr;
-}
-
-/*  ------------ For testing ---------- */
-void forward_transverse(List *list){
-    cout << "Forward:" << endl;
-    cout << "Array size:" << list_size(list) << endl;
-    cout << list->head->name << " " << list->head->ref << endl;
-    for(Blob *blob = list->head->next; blob != list->head; blob = blob->next){
-        cout << blob->name << " " << blob->ref << endl;
-    }
-    cout << endl;
-}
-
-void backward_transverse(List *list){
-    cout << "Backward:" << endl;
-    cout << "Array size:" << list_size(list) << endl;
-    for(Blob *blob = list->head->prev; blob != list->head; blob = blob->prev){
-        cout << blob->name << " " << blob->ref << endl;
+    // Use the reachability bitmaps when they cover both commits
+    const ReachabilityIndex *index = reachability_index();
+    if (index != nullptr && index->contains(c1) && index->contains(c2))
+        return const_cast<Commit *>(index->merge_base(c1, c2));
+
+    // Mark all the ancestors of c1, including itself
+    unordered_set<const Commit *> ancestors;
+    queue<Commit *> pending;
+    pending.push(c1);
+    while (!pending.empty()) {
+        Commit *commit = pending.front();
+        pending.pop();
+        if (commit == nullptr || !ancestors.insert(commit).second)
+            continue;
+        pending.push(commit->parent);
+        pending.push(commit->second_parent);
+        for (Commit *other : commit->other_parents)
+            pending.push(other);
     }
-    cout << list->head->name << " " << list->head->ref << endl;
-    cout << endl;
-}
-
-// for linked list testing
-int main(){
-    /* Task 1: ListNew */
-    List *list = list_new();
-
-    /* Task 2: ListPushBackOne */
-    Blob *blob = new Blob;
-    blob->name = "#2 node";
-    list_push_back(list, blob);
-    cout << list->head->next->name << " " << list->head->prev->name << " " << list->head->prev->prev->name << " " << list->head->next->next->name << endl;
 
-    /* Task 3: ListPushBackMultiple */
-    cout << "===================" << endl;
-    cout << "Task 3" << endl;
-    for(int i = 3; i <= 7; ++ i){
-        Blob *blob = new Blob;
-        string no = "";
-        no += (char)(i+'0');
-        blob->name = "#" + no + " node";
-        list_push_back(list, blob);
+    // Breadth-first search from c2, the first marked commit reached is the closest
+    unordered_set<const Commit *> visited;
+    pending.push(c2);
+    while (!pending.empty()) {
+        Commit *commit = pending.front();
+        pending.pop();
+        if (commit == nullptr || !visited.insert(commit).second)
+            continue;
+        if (ancestors.count(commit))
+            return commit;
+        pending.push(commit->parent);
+        pending.push(commit->second_parent);
+        for (Commit *other : commit->other_parents)
+            pending.push(other);
     }
-
-    forward_transverse(list);
-    backward_transverse(list);
-
-    /* Task 4, 5: ListFindNameFound */
-    cout << "==============" << endl;
-    cout << "Task 4, 5" << endl;
-    Blob *name_blob_four = list_find_name(list, "#4 node");
-    cout << name_blob_four->next->name << endl;
-    Blob *name_blob_seven = list_find_name(list, "#7 node");
-    cout << name_blob_seven->next->name << endl; 
-    Blob *name_blob_one = list_find_name(list, "#3 node");
-    cout << name_blob_one->prev->name << endl;
-    Blob *name_blob_eight = list_find_name(list, "#8 node");
-    if(name_blob_eight == nullptr){
-        cout << "nullptr" << endl;
-    } else{
-        cout << name_blob_eight->prev->name << endl; 
-    }     
-
-    /* Task 6, 7, 8: ListPutNew */
-    cout << "==============" << endl;
-    cout << "Task 6, 7, 8" << endl;
-    Blob *task6_node = list_put(list, "#5 node", "Reference");
-    Blob *task6_node_two = list_put(list, "#62 node", "Reference2");
-    Commit *task6_commit = new Commit; task6_commit->message = "First Commit";
-    Blob *task6_node_three = list_put(list, "#0 node", task6_commit);
-    cout << task6_node_three->commit->message << " " << task6_node_three->next->name << endl;
-
-    Blob *task6_node_four = list_put(list, "#8 node", "Reference3");
-    Blob *task6_node_five = list_put(list, "#63 node", "Reference4");
-    
-    forward_transverse(list);
-    backward_transverse(list);
-
-    /* Task 12, 13, 14: ListRemove */
-    cout << "==============" << endl;
-    cout << "Task 12, 13, 14" << endl;
-
-    cout << list_remove(list, "haha") << endl;
-    forward_transverse(list);
-    backward_transverse(list);
-
-    cout << list_remove(list, "#2 node") << endl;
-    forward_transverse(list);
-    backward_transverse(list); 
-
-    blob = list->head;
-    while(blob->name != "#8 node"){
-        list_remove(list, blob->name);
-        blob = blob->next;
-    }
-    list_remove(list, "#8 node");
-    cout << (list->head->next == list->head) << endl; 
-
-    cout << "==============" << endl;
-    cout << "Task 16, 17" << endl;
-    /* Task 16: ListClearEmpty */  
-    list_clear(list);
-    cout << (list->head->next == list->head) << endl;
-    cout << list_size(list) << endl;
-
-    /* Task 17: ListClearNonEmpty */
-    list_put(list, "#2 node", "A");
-    list_put(list, "#1 node", "R");
-    cout << list_size(list) << endl;
-    list_clear(list);
-    cout << list_size(list) << endl;
+    return nullptr;
 }
\ No newline at end of file
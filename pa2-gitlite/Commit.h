@@ -8,6 +8,10 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
+
+#include "Intern.h"
+#include "ObjectId.h"
 
 using std::string;
 
@@ -21,11 +25,13 @@ struct Commit;
 // of implementing this.
 struct Blob {
     // The filename of the blob, or the branch name.
-    string name;
+    // Interned, so the same name in every commit is stored once.
+    InternedString name;
 
     // The SHA1 hash of the blob. This is the unique reference to a blob.
-    // Remains empty when representing a branch.
-    string ref;
+    // Kept as the 20 bytes of the digest; the hex form is only the name of the file in .gitlite/blobs.
+    // Remains null when representing a branch.
+    ObjectId ref;
 
     // Pointer to a Commit structure, ONLY USED WHEN REPRESENTING A BRANCH.
     Commit *commit = nullptr;
@@ -51,10 +57,14 @@ struct Commit {
 
     string time;     // time of the commit
 
-    string commit_id; // the commit id, generated as an SHA1 string of message and time
+    ObjectId commit_id;  // the commit id, generated as the SHA1 of message and time
+
+    ObjectId tree_id;    // root tree of tracked_files (see Tree.h), null until the commit is stored
 
     Commit *parent = nullptr, *second_parent = nullptr;  // nullptr if parents do not exist
 
+    std::vector<Commit *> other_parents;    // parents after second_parent, only for octopus merges
+
     List *tracked_files = nullptr;     // files being tracked in this commit
 };
 
@@ -67,7 +77,7 @@ void list_push_back(List *list, Blob *blob);
 
 Blob *list_find_name(const List *list, const string &name);
 
-Blob *list_put(List *list, const string &name, const string &ref);
+Blob *list_put(List *list, const string &name, const ObjectId &ref);
 
 Blob *list_put(List *list, const string &name, Commit *commit);
 
@@ -0,0 +1,191 @@
+#include <stdexcept>
+
+#include "CommitFile.h"
+
+using namespace std;
+
+static const char MAGIC[4] = {'G', 'L', 'C', '2'};
+static const char FILE_LIST_MAGIC[4] = {'G', 'L', 'F', '1'};
+static constexpr size_t HEADER_SIZE = 4 + 6 * 4;   // magic, counts, message and time offset/length
+static constexpr size_t FILE_LIST_HEADER_SIZE = 4 + 4;
+static constexpr size_t FILE_ENTRY_SIZE = 4 + 4 + ObjectId::SIZE;
+
+static uint32_t read_u32(const char *ptr) {
+    auto bytes = reinterpret_cast<const unsigned char *>(ptr);
+    return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+static void write_u32(string &out, size_t value) {
+    if (value > UINT32_MAX)
+        throw std::length_error("commit too large to store");
+    for (int i = 0; i < 4; ++i) {
+        out += static_cast<char>(value >> (i * 8) & 0xff);
+    }
+}
+
+static ObjectId read_id(const char *ptr) {
+    return ObjectId::from_bytes(reinterpret_cast<const uint8_t *>(ptr));
+}
+
+static void write_id(string &out, const ObjectId &id) {
+    out.append(reinterpret_cast<const char *>(id.bytes().data()), ObjectId::SIZE);
+}
+
+CommitView::CommitView(std::string_view data) : data(data) {
+    if (data.size() < HEADER_SIZE + 2 * ObjectId::SIZE || data.compare(0, 4, MAGIC, 4) != 0)
+        throw std::runtime_error("not a commit file");
+
+    parents = read_u32(data.data() + 4);
+    files = read_u32(data.data() + 8);
+    parents_start = HEADER_SIZE + 2 * ObjectId::SIZE;
+    files_start = parents_start + static_cast<size_t>(parents) * ObjectId::SIZE;
+    pool_start = files_start + static_cast<size_t>(files) * FILE_ENTRY_SIZE;
+    if (pool_start > data.size())
+        throw std::runtime_error("truncated commit file");
+
+    // Check every string once, so the accessors can trust the offsets
+    size_t pool_size = data.size() - pool_start;
+    auto check = [&](size_t position) {
+        uint64_t end = uint64_t(read_u32(data.data() + position)) + read_u32(data.data() + position + 4);
+        if (end > pool_size)
+            throw std::runtime_error("corrupted commit file");
+    };
+    check(12);
+    check(20);
+    for (size_t i = 0; i < files; ++i) {
+        check(files_start + i * FILE_ENTRY_SIZE);
+    }
+}
+
+std::string_view CommitView::pool_string(size_t offset_position) const {
+    return data.substr(pool_start + read_u32(data.data() + offset_position), read_u32(data.data() + offset_position + 4));
+}
+
+ObjectId CommitView::commit_id() const {
+    return read_id(data.data() + HEADER_SIZE);
+}
+
+ObjectId CommitView::tree_id() const {
+    return read_id(data.data() + HEADER_SIZE + ObjectId::SIZE);
+}
+
+std::string_view CommitView::message() const {
+    return pool_string(12);
+}
+
+std::string_view CommitView::time() const {
+    return pool_string(20);
+}
+
+size_t CommitView::parent_count() const {
+    return parents;
+}
+
+ObjectId CommitView::parent(size_t i) const {
+    return read_id(data.data() + parents_start + i * ObjectId::SIZE);
+}
+
+size_t CommitView::file_count() const {
+    return files;
+}
+
+std::string_view CommitView::file_name(size_t i) const {
+    return pool_string(files_start + i * FILE_ENTRY_SIZE);
+}
+
+ObjectId CommitView::file_ref(size_t i) const {
+    return read_id(data.data() + files_start + i * FILE_ENTRY_SIZE + 8);
+}
+
+// Write the table of files, their names start at pool_offset in the pool
+static void write_files(string &out, const vector<pair<string_view, ObjectId>> &files, size_t pool_offset) {
+    size_t offset = pool_offset;
+    for (auto &file : files) {
+        write_u32(out, offset);
+        write_u32(out, file.first.size());
+        write_id(out, file.second);
+        offset += file.first.size();
+    }
+}
+
+FileListView::FileListView(std::string_view data) : data(data) {
+    if (data.size() < FILE_LIST_HEADER_SIZE || data.compare(0, 4, FILE_LIST_MAGIC, 4) != 0)
+        throw std::runtime_error("not a file list");
+
+    files = read_u32(data.data() + 4);
+    size_t pool_start = FILE_LIST_HEADER_SIZE + static_cast<size_t>(files) * FILE_ENTRY_SIZE;
+    if (pool_start > data.size())
+        throw std::runtime_error("truncated file list");
+    this->data = data.substr(0, pool_start);
+
+    size_t pool_size = data.size() - pool_start;
+    for (size_t i = 0; i < files; ++i) {
+        const char *entry = data.data() + FILE_LIST_HEADER_SIZE + i * FILE_ENTRY_SIZE;
+        if (uint64_t(read_u32(entry)) + read_u32(entry + 4) > pool_size)
+            throw std::runtime_error("corrupted file list");
+    }
+    pool = data.substr(pool_start);
+}
+
+size_t FileListView::file_count() const {
+    return files;
+}
+
+std::string_view FileListView::file_name(size_t i) const {
+    const char *entry = data.data() + FILE_LIST_HEADER_SIZE + i * FILE_ENTRY_SIZE;
+    return pool.substr(read_u32(entry), read_u32(entry + 4));
+}
+
+ObjectId FileListView::file_ref(size_t i) const {
+    return read_id(data.data() + FILE_LIST_HEADER_SIZE + i * FILE_ENTRY_SIZE + 8);
+}
+
+std::string encode_commit(const ObjectId &commit_id, const ObjectId &tree_id, std::string_view message,
+                          std::string_view time, const std::vector<ObjectId> &parents,
+                          const std::vector<std::pair<std::string_view, ObjectId>> &files) {
+    size_t pool_size = message.size() + time.size();
+    for (auto &file : files) {
+        pool_size += file.first.size();
+    }
+
+    string out;
+    out.reserve(HEADER_SIZE + ObjectId::SIZE * (2 + parents.size()) + FILE_ENTRY_SIZE * files.size() + pool_size);
+    out.append(MAGIC, 4);
+    write_u32(out, parents.size());
+    write_u32(out, files.size());
+    write_u32(out, 0);
+    write_u32(out, message.size());
+    write_u32(out, message.size());
+    write_u32(out, time.size());
+    write_id(out, commit_id);
+    write_id(out, tree_id);
+    for (auto &parent : parents) {
+        write_id(out, parent);
+    }
+
+    write_files(out, files, message.size() + time.size());
+
+    out += message;
+    out += time;
+    for (auto &file : files) {
+        out += file.first;
+    }
+    return out;
+}
+
+std::string encode_file_list(const std::vector<std::pair<std::string_view, ObjectId>> &files) {
+    size_t pool_size = 0;
+    for (auto &file : files) {
+        pool_size += file.first.size();
+    }
+
+    string out;
+    out.reserve(FILE_LIST_HEADER_SIZE + FILE_ENTRY_SIZE * files.size() + pool_size);
+    out.append(FILE_LIST_MAGIC, 4);
+    write_u32(out, files.size());
+    write_files(out, files, 0);
+    for (auto &file : files) {
+        out += file.first;
+    }
+    return out;
+}
@@ -0,0 +1,95 @@
+//
+// On-disk layout of a commit, read in place from the mapped file. A commit file is made of:
+//   header     magic "GLC2", then the number of parents and files, and where the message and
+//              the time are in the string pool
+//   commit id  20 bytes
+//   tree id    20 bytes, the root tree of the files (see Tree.h), null if not recorded
+//   parents    20 bytes each
+//   files      name offset and length in the string pool, then the 20-byte ref, for each file
+//   pool       the characters of the message, the time and the file names
+// All integers are 32-bit little-endian. Reading a commit through a CommitView allocates nothing.
+//
+// .gitlite/TREE and .gitlite/STAGE hold a list of files in the same way: magic "GLF1", the number
+// of files, the files, then the pool of their names. They are read through a FileListView.
+//
+
+#ifndef COMP2012H_FA21_PA2_COMMITFILE_H
+#define COMP2012H_FA21_PA2_COMMITFILE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "ObjectId.h"
+
+class CommitView {
+public:
+    /**
+     * Check the layout of a commit file and prepare to read it
+     * @param data contents of the file, must outlive the view
+     * @throw std::runtime_error if the contents are not a valid commit file
+     */
+    explicit CommitView(std::string_view data);
+
+    ObjectId commit_id() const;
+    ObjectId tree_id() const;
+    std::string_view message() const;
+    std::string_view time() const;
+
+    size_t parent_count() const;
+    ObjectId parent(size_t i) const;
+
+    size_t file_count() const;
+    std::string_view file_name(size_t i) const;
+    ObjectId file_ref(size_t i) const;
+
+private:
+    std::string_view pool_string(size_t offset_position) const;
+
+    std::string_view data;
+    size_t parents_start = 0, files_start = 0, pool_start = 0;
+    uint32_t parents = 0, files = 0;
+};
+
+class FileListView {
+public:
+    /**
+     * Check the layout of a file list and prepare to read it
+     * @param data contents of the file, must outlive the view
+     * @throw std::runtime_error if the contents are not a valid file list
+     */
+    explicit FileListView(std::string_view data);
+
+    size_t file_count() const;
+    std::string_view file_name(size_t i) const;
+    ObjectId file_ref(size_t i) const;
+
+private:
+    std::string_view data, pool;     // the header and the files, then the names
+    uint32_t files = 0;
+};
+
+/**
+ * Lay out a commit in the format read by CommitView
+ * @param commit_id id of the commit
+ * @param tree_id id of the root tree of the files
+ * @param message message of the commit
+ * @param time time of the commit
+ * @param parents ids of the parents, first parent first
+ * @param files name and ref of each tracked file
+ * @return contents of the commit file
+ */
+std::string encode_commit(const ObjectId &commit_id, const ObjectId &tree_id, std::string_view message,
+                          std::string_view time, const std::vector<ObjectId> &parents,
+                          const std::vector<std::pair<std::string_view, ObjectId>> &files);
+
+/**
+ * Lay out a list of files in the format read by FileListView
+ * @param files name and ref of each file
+ * @return contents of the file list
+ */
+std::string encode_file_list(const std::vector<std::pair<std::string_view, ObjectId>> &files);
+
+#endif //COMP2012H_FA21_PA2_COMMITFILE_H
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <string_view>
+
+#include "CommitGraph.h"
+
+using namespace std;
+
+// Parents of a commit in order: parent, second_parent, then the other parents
+static vector<const Commit *> commit_parents(const Commit *commit) {
+    vector<const Commit *> result;
+    if (commit->parent != nullptr)
+        result.push_back(commit->parent);
+    if (commit->second_parent != nullptr)
+        result.push_back(commit->second_parent);
+    result.insert(result.end(), commit->other_parents.begin(), commit->other_parents.end());
+    return result;
+}
+
+CommitGraph::CommitGraph(const std::vector<const Commit *> &commits) {
+    positions.reserve(commits.size());
+    for (const Commit *commit : commits) {
+        positions.emplace_back(commit, NONE);
+    }
+    sort(positions.begin(), positions.end());
+    auto lookup = [this](const Commit *commit) {
+        auto iter = lower_bound(positions.begin(), positions.end(), make_pair(commit, uint32_t(0)));
+        return iter != positions.end() && iter->first == commit ? iter : positions.end();
+    };
+
+    // Depth-first search, a commit gets its position once all its parents have one
+    this->commits.reserve(commits.size());
+    vector<pair<const Commit *, bool>> stack;   // commit, whether its parents have been pushed
+    for (const Commit *root : commits) {
+        stack.emplace_back(root, false);
+        while (!stack.empty()) {
+            auto [commit, expanded] = stack.back();
+            auto entry = lookup(commit);
+            if (entry->second != NONE) {
+                stack.pop_back();
+            } else if (expanded) {
+                stack.pop_back();
+                entry->second = static_cast<uint32_t>(this->commits.size());
+                this->commits.push_back(commit);
+            } else {
+                stack.back().second = true;
+                for (const Commit *parent : commit_parents(commit)) {
+                    auto parent_entry = lookup(parent);
+                    if (parent_entry != positions.end() && parent_entry->second == NONE)
+                        stack.emplace_back(parent, false);
+                }
+            }
+        }
+    }
+
+    offsets.reserve(this->commits.size() + 1);
+    offsets.push_back(0);
+    for (const Commit *commit : this->commits) {
+        for (const Commit *parent : commit_parents(commit)) {
+            auto parent_entry = lookup(parent);
+            if (parent_entry != positions.end())
+                parents.push_back(parent_entry->second);
+        }
+        offsets.push_back(static_cast<uint32_t>(parents.size()));
+    }
+}
+
+size_t CommitGraph::size() const {
+    return commits.size();
+}
+
+const Commit *CommitGraph::commit(uint32_t position) const {
+    return commits[position];
+}
+
+uint32_t CommitGraph::position(const Commit *commit) const {
+    auto iter = lower_bound(positions.begin(), positions.end(), make_pair(commit, uint32_t(0)));
+    return iter != positions.end() && iter->first == commit ? iter->second : NONE;
+}
+
+const uint32_t *CommitGraph::parents_begin(uint32_t position) const {
+    return parents.data() + offsets[position];
+}
+
+const uint32_t *CommitGraph::parents_end(uint32_t position) const {
+    return parents.data() + offsets[position + 1];
+}
+
+std::vector<uint32_t> CommitGraph::first_parent_order(uint32_t head) const {
+    vector<uint32_t> order;
+    for (uint32_t position = head; position != NONE;) {
+        order.push_back(position);
+        position = parents_begin(position) != parents_end(position) ? *parents_begin(position) : NONE;
+    }
+    return order;
+}
+
+std::vector<uint32_t> CommitGraph::topo_order(uint32_t head, bool first_parent) const {
+    auto end_of_parents = [&](uint32_t position) {
+        const uint32_t *begin = parents_begin(position), *end = parents_end(position);
+        return first_parent && begin != end ? begin + 1 : end;
+    };
+
+    // Mark the ancestors and count the children each of them has among the ancestors
+    vector<bool> visited(commits.size());
+    vector<uint32_t> children(commits.size());
+    vector<uint32_t> stack{head};
+    visited[head] = true;
+    while (!stack.empty()) {
+        uint32_t position = stack.back();
+        stack.pop_back();
+        for (const uint32_t *parent = parents_begin(position); parent != end_of_parents(position); ++parent) {
+            ++children[*parent];
+            if (!visited[*parent]) {
+                visited[*parent] = true;
+                stack.push_back(*parent);
+            }
+        }
+    }
+
+    // A commit is ready once all its children are listed. Taking the most recently readied one
+    // keeps following the current line of history.
+    vector<uint32_t> order;
+    stack.push_back(head);
+    while (!stack.empty()) {
+        uint32_t position = stack.back();
+        stack.pop_back();
+        order.push_back(position);
+        for (const uint32_t *parent = parents_begin(position); parent != end_of_parents(position); ++parent) {
+            if (--children[*parent] == 0)
+                stack.push_back(*parent);
+        }
+    }
+    return order;
+}
+
+// Append a row of the graph followed by the text. Each column is two characters wide; lines
+// moving to another column ('\\' and '/') are drawn between the column and the one on its left.
+static void append_row(string &out, const string &glyphs, string_view text) {
+    size_t start = out.size();
+    out.append(glyphs.size() * 2, ' ');
+    for (size_t i = 0; i < glyphs.size(); ++i) {
+        bool diagonal = glyphs[i] == '\\' || glyphs[i] == '/';
+        if (glyphs[i] == '_') {
+            out[start + i * 2 - 1] = '_';     // a line passing under this column
+            out[start + i * 2] = '|';
+        } else {
+            out[start + (diagonal && i > 0 ? i * 2 - 1 : i * 2)] = glyphs[i];
+        }
+    }
+    out += text;
+    while (out.size() > start && out.back() == ' ')
+        out.pop_back();
+    out += '\n';
+}
+
+// Append a row with a line from one column into another in the row below, passing the columns
+// in between along the bottom of the row: "|\|_|" to the right, "|_|/|" to the left.
+static void append_edge(string &out, size_t width, size_t from, size_t to, string_view text) {
+    size_t start = out.size();
+    append_row(out, string(width, '|'), text);
+    if (to > from) {
+        out[start + from * 2 + 1] = '\\';
+        for (size_t i = from + 1; i < to; ++i)
+            out[start + i * 2 + 1] = '_';
+    } else {
+        out[start + from * 2 - 1] = '/';
+        for (size_t i = to + 1; i < from; ++i)
+            out[start + i * 2 - 1] = '_';
+    }
+}
+
+void print_graph(OutputBuffer &out, const CommitGraph &graph, const std::vector<uint32_t> &order,
+                 const LogFormat &format, bool first_parent) {
+    vector<uint32_t> columns;   // the commit each column of the graph leads to
+    string text;
+    for (uint32_t position : order) {
+        size_t column = find(columns.begin(), columns.end(), position) - columns.begin();
+        if (column == columns.size())
+            columns.push_back(position);
+
+        const uint32_t *parents = graph.parents_begin(position);
+        const uint32_t *parents_end = graph.parents_end(position);
+        if (first_parent && parents != parents_end)
+            parents_end = parents + 1;
+
+        // Lay out the columns below this commit. The first parent takes over the column unless it
+        // already has one, in which case the column to the right goes away.
+        vector<uint32_t> next = columns;
+        size_t removed = columns.size();
+        size_t kept = columns.size();     // the column the removed one joins
+        size_t insert_at = column + 1;
+        if (parents == parents_end) {
+            removed = column;
+            insert_at = column;
+        } else {
+            size_t other = find(columns.begin(), columns.end(), *parents) - columns.begin();
+            if (other == columns.size() || other == column) {
+                next[column] = *parents;
+            } else {
+                kept = min(column, other);
+                removed = max(column, other);
+                next[kept] = *parents;
+                insert_at = column < other ? column + 1 : column;
+            }
+        }
+        if (removed < columns.size())
+            next.erase(next.begin() + static_cast<ptrdiff_t>(removed));
+        size_t inserted = 0;
+        for (const uint32_t *parent = parents + 1; parent < parents_end; ++parent) {
+            if (find(next.begin(), next.end(), *parent) == next.end()) {
+                next.insert(next.begin() + static_cast<ptrdiff_t>(min(insert_at + inserted, next.size())), *parent);
+                ++inserted;
+            }
+        }
+
+        text.clear();
+        format.render(graph.commit(position), text);
+        if (!text.empty() && text.back() == '\n')
+            text.pop_back();
+        vector<string_view> lines;
+        for (size_t begin = 0;;) {
+            size_t end = text.find('\n', begin);
+            lines.emplace_back(text.data() + begin, (end == string::npos ? text.size() : end) - begin);
+            if (end == string::npos)
+                break;
+            begin = end + 1;
+        }
+
+        string glyphs(columns.size(), '|');
+        glyphs[column] = '*';
+        append_row(out.buffer(), glyphs, lines[0]);
+
+        // Parents that already have a column, e.g. in a criss-cross merge, get a line into it
+        size_t line = 1;
+        for (const uint32_t *parent = parents + 1; parent < parents_end; ++parent) {
+            size_t existing = find(columns.begin(), columns.end(), *parent) - columns.begin();
+            if (*parent != *parents && existing < columns.size() && existing != column) {
+                append_edge(out.buffer(), columns.size(), column, existing,
+                            line < lines.size() ? lines[line++] : string_view());
+            }
+        }
+        if (inserted > 0) {
+            // New columns branch off to the right of the merge
+            glyphs.assign(next.size(), '|');
+            for (size_t i = insert_at; i < next.size(); ++i)
+                glyphs[i] = '\\';
+            append_row(out.buffer(), glyphs, line < lines.size() ? lines[line++] : string_view());
+        }
+        const vector<uint32_t> &layout = inserted > 0 ? next : columns;
+        glyphs.assign(layout.size(), '|');
+        if (inserted == 0 && parents == parents_end)
+            glyphs[column] = ' ';
+        for (; line < lines.size(); ++line)
+            append_row(out.buffer(), glyphs, lines[line]);
+
+        if (removed < columns.size() && (parents != parents_end || removed + 1 < columns.size())) {
+            // The removed column joins the one of its parent, the columns to its right move left
+            glyphs.assign(columns.size(), '|');
+            for (size_t i = removed; i < columns.size(); ++i)
+                glyphs[i] = '/';
+            for (size_t i = kept + 1; i < removed; ++i)
+                glyphs[i] = '_';
+            if (parents == parents_end)
+                glyphs[removed] = ' ';
+            append_row(out.buffer(), glyphs, string_view());
+        }
+
+        columns.swap(next);
+        out.maybe_flush();
+    }
+}
@@ -0,0 +1,74 @@
+//
+// Compact view of the commit DAG. Every commit gets a position, parents come before their
+// children, and the parents of all the commits are stored in one array. Traversals mark commits
+// in bitmaps indexed by position instead of hashing commit ids or pointers.
+//
+
+#ifndef COMP2012H_FA21_PA2_COMMITGRAPH_H
+#define COMP2012H_FA21_PA2_COMMITGRAPH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Commit.h"
+#include "LogFormat.h"
+
+class CommitGraph {
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    /**
+     * Build the graph of a set of commits. Parents outside of the set are left out.
+     * @param commits the commits, in any order
+     */
+    explicit CommitGraph(const std::vector<const Commit *> &commits);
+
+    size_t size() const;
+    const Commit *commit(uint32_t position) const;
+
+    /**
+     * Find the position of a commit
+     * @param commit the commit to look for
+     * @return its position, or NONE if the commit is not in the graph
+     */
+    uint32_t position(const Commit *commit) const;
+
+    // Parents of the commit at a position, first parent first
+    const uint32_t *parents_begin(uint32_t position) const;
+    const uint32_t *parents_end(uint32_t position) const;
+
+    /**
+     * List the ancestors of a commit following only first parents, from the commit itself
+     * @param head position of the commit
+     * @return positions of the commits
+     */
+    std::vector<uint32_t> first_parent_order(uint32_t head) const;
+
+    /**
+     * List the ancestors of a commit (including itself) so that no commit comes before any of its
+     * children, and a line of history is listed to its end before switching to another
+     * @param head position of the commit
+     * @param first_parent only follow the first parent of merges
+     * @return positions of the commits
+     */
+    std::vector<uint32_t> topo_order(uint32_t head, bool first_parent = false) const;
+
+private:
+    std::vector<const Commit *> commits;    // by position
+    std::vector<uint32_t> offsets;          // parents of position i are parents[offsets[i], offsets[i + 1])
+    std::vector<uint32_t> parents;
+    std::vector<std::pair<const Commit *, uint32_t>> positions;    // sorted by pointer, for lookup
+};
+
+/**
+ * Print commits with the history drawn as a graph on the left
+ * @param out the buffer to print to
+ * @param graph the commit graph
+ * @param order positions of the commits to print, as from topo_order
+ * @param format the format of each commit
+ * @param first_parent only draw the first parent of merges
+ */
+void print_graph(OutputBuffer &out, const CommitGraph &graph, const std::vector<uint32_t> &order,
+                 const LogFormat &format, bool first_parent = false);
+
+#endif //COMP2012H_FA21_PA2_COMMITGRAPH_H
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <fstream>
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/vector.hpp>
+#include <cereal/types/string.hpp>
+
+#include "CommitIndex.h"
+
+using namespace std;
+
+static thread_local const CommitIdIndex *abbreviation_index = nullptr;
+
+// Length of the common prefix of two ids
+static size_t common_prefix(const string &a, const string &b) {
+    return mismatch(a.begin(), a.begin() + min(a.size(), b.size()), b.begin()).first - a.begin();
+}
+
+CommitIdIndex::CommitIdIndex(std::vector<std::string> ids) : ids(std::move(ids)) {
+    sort(this->ids.begin(), this->ids.end());
+    this->ids.erase(unique(this->ids.begin(), this->ids.end()), this->ids.end());
+}
+
+void CommitIdIndex::insert(const std::string &commit_id) {
+    auto iter = lower_bound(ids.begin(), ids.end(), commit_id);
+    if (iter == ids.end() || *iter != commit_id) {
+        ids.insert(iter, commit_id);
+    }
+}
+
+std::string CommitIdIndex::resolve(const std::string &prefix) const {
+    if (prefix.size() < MIN_PREFIX_LENGTH || prefix.size() > 40) {
+        return string();
+    }
+
+    // All the ids starting with the prefix are adjacent, and the first one is not less than it
+    auto iter = lower_bound(ids.begin(), ids.end(), prefix);
+    if (iter == ids.end() || iter->compare(0, prefix.size(), prefix) != 0) {
+        return string();    // no match
+    }
+    auto next = iter + 1;
+    if (next != ids.end() && next->compare(0, prefix.size(), prefix) == 0) {
+        return string();    // multiple matches
+    }
+    return *iter;
+}
+
+std::string CommitIdIndex::shortest_unique_prefix(const std::string &commit_id, size_t min_length) const {
+    // Only the neighbours in sorted order can share a longer prefix than any other id
+    auto iter = lower_bound(ids.begin(), ids.end(), commit_id);
+    size_t longest = 0;
+    if (iter != ids.begin()) {
+        longest = common_prefix(commit_id, *(iter - 1));
+    }
+    if (iter != ids.end() && *iter == commit_id) {
+        ++iter;
+    }
+    if (iter != ids.end()) {
+        longest = max(longest, common_prefix(commit_id, *iter));
+    }
+    return commit_id.substr(0, max(min_length, longest + 1));
+}
+
+size_t CommitIdIndex::size() const {
+    return ids.size();
+}
+
+bool CommitIdIndex::load(const std::filesystem::path &file) {
+    ifstream is(file, ios::in | ios::binary);
+    if (!is.is_open()) {
+        return false;
+    }
+    try {
+        cereal::BinaryInputArchive iarchive(is);
+        iarchive(ids);
+    } catch (...) {
+        ids.clear();
+        return false;
+    }
+    return true;
+}
+
+void CommitIdIndex::save(const std::filesystem::path &file) const {
+    ofstream os(file, ios::out | ios::binary);
+    if (!os.is_open()) {
+        throw std::invalid_argument("failed to write " + file.string());
+    }
+    cereal::BinaryOutputArchive oarchive(os);
+    oarchive(ids);
+}
+
+std::string abbreviate_commit_id(const std::string &commit_id) {
+    if (abbreviation_index == nullptr) {
+        return commit_id.substr(0, CommitIdIndex::ABBREV_LENGTH);
+    }
+    return abbreviation_index->shortest_unique_prefix(commit_id);
+}
+
+void set_abbreviation_index(const CommitIdIndex *index) {
+    abbreviation_index = index;
+}
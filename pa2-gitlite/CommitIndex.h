@@ -0,0 +1,67 @@
+//
+// Sorted array of all the commit ids in the repository. Resolving an abbreviated id is a binary
+// search, and so is finding the shortest prefix that still names a single commit.
+//
+
+#ifndef COMP2012H_FA21_PA2_COMMITINDEX_H
+#define COMP2012H_FA21_PA2_COMMITINDEX_H
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+class CommitIdIndex {
+public:
+    static constexpr size_t MIN_PREFIX_LENGTH = 2;      // like .gitlite/commits/<xx>
+    static constexpr size_t ABBREV_LENGTH = 7;          // default length of abbreviated ids
+
+    CommitIdIndex() = default;
+    explicit CommitIdIndex(std::vector<std::string> ids);
+
+    /**
+     * Add a commit id, keeping the array sorted. Adding an existing id does nothing.
+     * @param commit_id the full commit id
+     */
+    void insert(const std::string &commit_id);
+
+    /**
+     * Find the commit whose id starts with the prefix
+     * @param prefix an abbreviated (or full) commit id
+     * @return the full commit id, or an empty string if there is no match or more than one
+     */
+    std::string resolve(const std::string &prefix) const;
+
+    /**
+     * Get the shortest prefix of a commit id that no other commit id starts with
+     * @param commit_id a full commit id
+     * @param min_length the prefix is never shorter than this
+     * @return the prefix
+     */
+    std::string shortest_unique_prefix(const std::string &commit_id, size_t min_length = ABBREV_LENGTH) const;
+
+    size_t size() const;
+
+    /**
+     * Load an index written by save
+     * @param file the persisted index
+     * @return false if the file is missing or cannot be read
+     */
+    bool load(const std::filesystem::path &file);
+    void save(const std::filesystem::path &file) const;
+
+private:
+    std::vector<std::string> ids;   // sorted, no duplicates
+};
+
+/**
+ * Abbreviate a commit id for display, e.g. in the Merge: line of log. Uses the index registered
+ * with set_abbreviation_index on the calling thread so the result is unambiguous, or the first
+ * 7 characters if none is.
+ * @param commit_id a full commit id
+ * @return the abbreviated id
+ */
+std::string abbreviate_commit_id(const std::string &commit_id);
+
+void set_abbreviation_index(const CommitIdIndex *index);
+
+#endif //COMP2012H_FA21_PA2_COMMITINDEX_H
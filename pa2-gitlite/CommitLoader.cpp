@@ -0,0 +1,249 @@
+#include "CommitLoader.h"
+#include "CommitFile.h"
+#include "Diff.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+using path = std::filesystem::path;
+
+namespace {
+
+// The names decoded by one worker, each distinct one kept once. They are interned together when the
+// worker is done, so the workers do not take the lock of the global pool for every blob. Ids need no
+// such step, they are stored in the blobs and commits as they are.
+class PendingStrings {
+public:
+    void add_name(InternedString *target, string_view name) {
+        auto iter = name_index.find(name);
+        if (iter == name_index.end()) {
+            const string &stored = names.emplace_back(name);
+            iter = name_index.emplace(stored, static_cast<uint32_t>(names.size() - 1)).first;
+        }
+        name_targets.emplace_back(target, iter->second);
+    }
+
+    void resolve() {
+        vector<InternedString> interned = InternedString::intern_all(vector<string_view>(names.begin(), names.end()));
+        for (auto &target : name_targets) {
+            *target.first = interned[target.second];
+        }
+    }
+
+private:
+    deque<string> names;
+    unordered_map<string_view, uint32_t> name_index;
+    vector<pair<InternedString *, uint32_t>> name_targets;
+};
+
+void free_commit(Commit *commit) {
+    if (commit->tracked_files != nullptr) {
+        list_delete(commit->tracked_files);
+        delete commit->tracked_files;
+    }
+    delete commit;
+}
+
+struct CommitDeleter {
+    void operator()(Commit *commit) const { free_commit(commit); }
+};
+
+LoadedCommit decode_commit_file(const path &file, PendingStrings &pending) {
+    // Build the commit straight from the mapped file, without an intermediate copy
+    MappedFile mapped(file);
+    CommitView view(mapped.view());
+    trace_count(TraceCounter::FILE_OPERATIONS);
+    trace_count(TraceCounter::BYTES_READ, mapped.view().size());
+    unique_ptr<Commit, CommitDeleter> commit(new Commit);
+    commit->message = string(view.message());
+    commit->time = string(view.time());
+    commit->commit_id = view.commit_id();
+    commit->tree_id = view.tree_id();
+    commit->tracked_files = list_new();
+    for (size_t i = 0; i < view.file_count(); ++i) {
+        Blob *blob = new Blob;
+        pending.add_name(&blob->name, view.file_name(i));
+        blob->ref = view.file_ref(i);
+        list_push_back(commit->tracked_files, blob);
+    }
+
+    LoadedCommit loaded{nullptr, {}};
+    loaded.parents.reserve(view.parent_count());
+    for (size_t i = 0; i < view.parent_count(); ++i) {
+        loaded.parents.push_back(view.parent(i));
+    }
+    loaded.commit = commit.release();
+    return loaded;
+}
+
+}
+
+LoadedCommit load_commit_file(const path &file) {
+    PendingStrings pending;
+    LoadedCommit loaded = decode_commit_file(file, pending);
+    pending.resolve();
+    return loaded;
+}
+
+namespace {
+
+// The shards waiting to be read by one worker. The owner takes from the back, thieves from the front.
+struct ShardQueue {
+    mutex lock;
+    deque<path> shards;
+
+    bool pop_back(path &shard) {
+        lock_guard<mutex> guard(lock);
+        if (shards.empty())
+            return false;
+        shard = std::move(shards.back());
+        shards.pop_back();
+        return true;
+    }
+
+    bool pop_front(path &shard) {
+        lock_guard<mutex> guard(lock);
+        if (shards.empty())
+            return false;
+        shard = std::move(shards.front());
+        shards.pop_front();
+        return true;
+    }
+};
+
+class Loader {
+public:
+    Loader(vector<path> shards, unsigned threads) : queues(threads), buffers(threads) {
+        for (size_t i = 0; i < shards.size(); ++i) {
+            queues[i % threads].shards.push_back(std::move(shards[i]));
+        }
+    }
+
+    void run() {
+        vector<thread> workers;
+        for (unsigned i = 1; i < queues.size(); ++i) {
+            workers.emplace_back(&Loader::work, this, i);
+        }
+        work(0);
+        for (thread &worker : workers) {
+            worker.join();
+        }
+        if (error) {
+            // Nothing has been linked yet, so the commits decoded by every worker are still ours to free
+            for (auto &buffer : buffers) {
+                for (LoadedCommit &entry : buffer) {
+                    free_commit(entry.commit);
+                }
+                buffer.clear();
+            }
+            rethrow_exception(error);
+        }
+    }
+
+    vector<LoadedCommit> result() {
+        size_t total = 0;
+        for (auto &buffer : buffers) {
+            total += buffer.size();
+        }
+        vector<LoadedCommit> loaded;
+        loaded.reserve(total);
+        for (auto &buffer : buffers) {
+            move(buffer.begin(), buffer.end(), back_inserter(loaded));
+        }
+        return loaded;
+    }
+
+private:
+    bool next_shard(unsigned self, path &shard) {
+        if (queues[self].pop_back(shard))
+            return true;
+        for (size_t i = 1; i < queues.size(); ++i) {
+            if (queues[(self + i) % queues.size()].pop_front(shard))
+                return true;
+        }
+        return false;
+    }
+
+    void work(unsigned self) {
+        TraceScope trace("load_commit_files worker", "load");
+        try {
+            PendingStrings pending;
+            path shard;
+            while (next_shard(self, shard)) {
+                for (auto &file : filesystem::directory_iterator(shard)) {
+                    buffers[self].push_back(decode_commit_file(file.path(), pending));
+                }
+            }
+            TraceScope intern("intern strings", "load");
+            pending.resolve();
+        } catch (...) {
+            lock_guard<mutex> guard(error_lock);
+            if (!error)
+                error = current_exception();
+        }
+    }
+
+    vector<ShardQueue> queues;
+    vector<vector<LoadedCommit>> buffers;   // one per worker, so decoding never contends on the output
+    mutex error_lock;
+    exception_ptr error;
+};
+
+}
+
+vector<LoadedCommit> load_commit_files(const path &commits_dir, unsigned threads) {
+    TraceScope trace("load_commit_files", "load");
+    vector<path> shards;
+    for (auto &dir : filesystem::directory_iterator(commits_dir)) {
+        if (dir.is_directory()) {
+            shards.push_back(dir.path());
+        }
+    }
+
+    if (threads == 0) {
+        // GITLITE_LOAD_THREADS=<n> pins the worker count, e.g. to compare one worker with many
+        const char *env = getenv("GITLITE_LOAD_THREADS");
+        threads = env != nullptr ? static_cast<unsigned>(strtoul(env, nullptr, 10)) : 0;
+    }
+    if (threads == 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned>(min<size_t>(threads, max<size_t>(1, shards.size())));
+
+    Loader loader(std::move(shards), threads);
+    loader.run();
+    return loader.result();
+}
+
+void link_commits(const vector<LoadedCommit> &loaded, unordered_map<ObjectId, Commit *> &commits) {
+    TraceScope trace("link_commits", "load");
+    commits.reserve(commits.size() + loaded.size());
+    for (const LoadedCommit &entry : loaded) {
+        commits.insert({entry.commit->commit_id, entry.commit});
+    }
+
+    for (const LoadedCommit &entry : loaded) {
+        for (size_t i = 0; i < entry.parents.size(); ++i) {
+            auto parent = commits.find(entry.parents[i]);
+            if (parent == commits.end()) {
+                throw std::runtime_error("failed to find the parent of commit " + entry.commit->commit_id.to_hex());
+            }
+            if (i == 0) {
+                entry.commit->parent = parent->second;
+            } else if (i == 1) {
+                entry.commit->second_parent = parent->second;
+            } else {
+                entry.commit->other_parents.push_back(parent->second);
+            }
+        }
+    }
+}
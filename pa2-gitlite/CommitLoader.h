@@ -0,0 +1,48 @@
+//
+// Reads the commit files under .gitlite/commits on several threads. The shard directories are
+// dealt out to the workers, and a worker that runs out of shards steals from the others.
+// Each worker keeps the file names it decodes in its own pool, and interns the distinct ones in a
+// single batch when it is done.
+//
+
+#ifndef COMP2012H_FA21_PA2_COMMITLOADER_H
+#define COMP2012H_FA21_PA2_COMMITLOADER_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <filesystem>
+#include <unordered_map>
+
+#include "Commit.h"
+#include "ObjectId.h"
+
+// A decoded commit whose parents are not linked yet
+struct LoadedCommit {
+    Commit *commit;
+    std::vector<ObjectId> parents;
+};
+
+/**
+ * Decode a single commit file. The parents of the commit are left as ids.
+ * @param file path of the commit file
+ * @return the commit and the ids of its parents
+ */
+LoadedCommit load_commit_file(const std::filesystem::path &file);
+
+/**
+ * Decode every commit file in the shard directories of commits_dir
+ * @param commits_dir the directory of the commits, i.e. .gitlite/commits
+ * @param threads number of worker threads, 0 to use GITLITE_LOAD_THREADS or else one per core
+ * @return the commits in no particular order, each with the ids of its parents
+ */
+std::vector<LoadedCommit> load_commit_files(const std::filesystem::path &commits_dir, unsigned threads = 0);
+
+/**
+ * Put the loaded commits in the map by id and point every commit to its parents
+ * @param loaded the commits returned by load_commit_files
+ * @param commits the map from commit id to commit to fill
+ */
+void link_commits(const std::vector<LoadedCommit> &loaded, std::unordered_map<ObjectId, Commit *> &commits);
+
+#endif //COMP2012H_FA21_PA2_COMMITLOADER_H
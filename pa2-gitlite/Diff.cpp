@@ -0,0 +1,485 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Diff.h"
+#include "Utils.h"
+
+using namespace std;
+using path = std::filesystem::path;
+
+// Histogram diff gives up on a region (and lets Myers handle it) when every common line
+// occurs more often than this, same as the limit used by git.
+static const size_t MAX_CHAIN_LENGTH = 64;
+
+MappedFile::MappedFile(const path &path) {
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::invalid_argument("failed to read " + path.string());
+
+    struct stat st {};
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            data = static_cast<const char *>(addr);
+            size = st.st_size;
+            mapped = true;
+        }
+    }
+    ::close(fd);
+    if (mapped || st.st_size == 0)
+        return;
+#endif
+    fallback = read_content(path);
+    data = fallback.data();
+    size = fallback.size();
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        unmap();
+        mapped = other.mapped;
+        fallback = std::move(other.fallback);
+        data = mapped ? other.data : fallback.data();
+        size = other.size;
+        other.data = nullptr;
+        other.size = 0;
+        other.mapped = false;
+    }
+    return *this;
+}
+
+std::string_view MappedFile::view() const {
+    return size == 0 ? std::string_view() : std::string_view(data, size);
+}
+
+void MappedFile::unmap() {
+#ifndef _WIN32
+    if (mapped)
+        munmap(const_cast<char *>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+    mapped = false;
+}
+
+std::vector<std::string_view> split_lines(std::string_view content) {
+    vector<string_view> lines;
+    size_t start = 0;
+    while (start < content.size()) {
+        size_t end = content.find('\n', start);
+        if (end == string_view::npos) {
+            lines.push_back(content.substr(start));
+            break;
+        }
+        lines.push_back(content.substr(start, end - start + 1));
+        start = end + 1;
+    }
+    return lines;
+}
+
+bool is_binary(std::string_view content) {
+    return content.substr(0, 8000).find('\0') != string_view::npos;
+}
+
+namespace {
+
+// Lines of both files are replaced by integer ids so that the algorithms only compare ints.
+// changed_a[i] / changed_b[j] are set for lines that are not part of the common subsequence.
+struct DiffContext {
+    vector<int> a, b;
+    vector<char> changed_a, changed_b;
+    vector<int> forward, backward;     // V arrays of Myers' algorithm, indexed by diagonal
+
+    // Positions in a of every line id, grouped by id: occurrences[first_occurrence[id], first_occurrence[id + 1])
+    vector<int> first_occurrence, occurrences;
+};
+
+// Build the position index of the lines in a, used by histogram diff
+void index_occurrences(DiffContext &ctx, int id_count) {
+    ctx.first_occurrence.assign(id_count + 1, 0);
+    for (int id : ctx.a) {
+        ++ctx.first_occurrence[id + 1];
+    }
+    for (int id = 0; id < id_count; ++id) {
+        ctx.first_occurrence[id + 1] += ctx.first_occurrence[id];
+    }
+    ctx.occurrences.resize(ctx.a.size());
+    vector<int> fill_pos(ctx.first_occurrence.begin(), ctx.first_occurrence.end() - 1);
+    for (int i = 0; i < (int) ctx.a.size(); ++i) {
+        ctx.occurrences[fill_pos[ctx.a[i]]++] = i;
+    }
+}
+
+void mark_changed(DiffContext &ctx, int a_lo, int a_hi, int b_lo, int b_hi) {
+    fill(ctx.changed_a.begin() + a_lo, ctx.changed_a.begin() + a_hi, 1);
+    fill(ctx.changed_b.begin() + b_lo, ctx.changed_b.begin() + b_hi, 1);
+}
+
+// Strip the common prefix and suffix of the region. Return true if nothing is left to match.
+bool trim_region(DiffContext &ctx, int &a_lo, int &a_hi, int &b_lo, int &b_hi) {
+    while (a_lo < a_hi && b_lo < b_hi && ctx.a[a_lo] == ctx.b[b_lo]) {
+        ++a_lo;
+        ++b_lo;
+    }
+    while (a_lo < a_hi && b_lo < b_hi && ctx.a[a_hi - 1] == ctx.b[b_hi - 1]) {
+        --a_hi;
+        --b_hi;
+    }
+    if (a_lo == a_hi || b_lo == b_hi) {
+        mark_changed(ctx, a_lo, a_hi, b_lo, b_hi);
+        return true;
+    }
+    return false;
+}
+
+// Find a point on an optimal edit path through the region by running Myers' algorithm
+// from both ends at once until the furthest reaching paths overlap.
+// Both sides of the region must be non-empty and share no common prefix or suffix.
+pair<int, int> middle_snake(DiffContext &ctx, int a_lo, int a_hi, int b_lo, int b_hi) {
+    const int *a = ctx.a.data() + a_lo, *b = ctx.b.data() + b_lo;
+    const int n = a_hi - a_lo, m = b_hi - b_lo;
+    const int delta = n - m;
+    const bool odd = delta & 1;
+    const int max_d = (n + m + 1) / 2;
+    const int offset = max_d + 1;
+
+    // forward[k] is the furthest x on diagonal k = x - y from (0, 0);
+    // backward[k] is the furthest distance from (n, m) on diagonal k = (n - x) - (m - y)
+    int *forward = ctx.forward.data() + offset, *backward = ctx.backward.data() + offset;
+    forward[1] = 0;
+    backward[1] = 0;
+
+    for (int d = 0; d <= max_d; ++d) {
+        for (int k = -d; k <= d; k += 2) {
+            int x = (k == -d || (k != d && forward[k - 1] < forward[k + 1])) ? forward[k + 1] : forward[k - 1] + 1;
+            int y = x - k;
+            while (x < n && y < m && a[x] == b[y]) {
+                ++x;
+                ++y;
+            }
+            forward[k] = x;
+            int c = delta - k;
+            if (odd && c >= -(d - 1) && c <= d - 1 && x + backward[c] >= n) {
+                return {a_lo + x, b_lo + y};
+            }
+        }
+        for (int k = -d; k <= d; k += 2) {
+            int x = (k == -d || (k != d && backward[k - 1] < backward[k + 1])) ? backward[k + 1] : backward[k - 1] + 1;
+            int y = x - k;
+            while (x < n && y < m && a[n - 1 - x] == b[m - 1 - y]) {
+                ++x;
+                ++y;
+            }
+            backward[k] = x;
+            int c = delta - k;
+            if (!odd && c >= -d && c <= d && x + forward[c] >= n) {
+                return {a_lo + n - x, b_lo + m - y};
+            }
+        }
+    }
+    throw std::logic_error("diff: failed to find the middle snake");
+}
+
+void myers(DiffContext &ctx, int a_lo, int a_hi, int b_lo, int b_hi) {
+    // The second half is handled by the loop instead of recursion to keep the stack shallow
+    while (!trim_region(ctx, a_lo, a_hi, b_lo, b_hi)) {
+        auto split = middle_snake(ctx, a_lo, a_hi, b_lo, b_hi);
+        myers(ctx, a_lo, split.first, b_lo, split.second);
+        a_lo = split.first;
+        b_lo = split.second;
+    }
+}
+
+void histogram(DiffContext &ctx, int a_lo, int a_hi, int b_lo, int b_hi) {
+    while (!trim_region(ctx, a_lo, a_hi, b_lo, b_hi)) {
+        // Pick the longest common region around the least frequent line. Ties are broken towards
+        // the middle of the region so that the recursion stays balanced.
+        size_t best_count = MAX_CHAIN_LENGTH + 1;
+        int best_a = -1, best_b = -1, best_length = 0;
+        const int middle = b_lo + (b_hi - b_lo) / 2;
+        for (int j = b_lo; j < b_hi;) {
+            // Occurrences of the line within [a_lo, a_hi)
+            const int *all_begin = ctx.occurrences.data() + ctx.first_occurrence[ctx.b[j]];
+            const int *all_end = ctx.occurrences.data() + ctx.first_occurrence[ctx.b[j] + 1];
+            const int *begin = lower_bound(all_begin, all_end, a_lo), *end = lower_bound(begin, all_end, a_hi);
+            size_t count = end - begin;
+            if (count == 0 || count > best_count || count > MAX_CHAIN_LENGTH) {
+                ++j;
+                continue;
+            }
+            int next_j = j + 1;
+            for (const int *iter = begin; iter != end; ++iter) {
+                int i = *iter;
+                int start_a = i, start_b = j, end_a = i + 1, end_b = j + 1;
+                while (start_a > a_lo && start_b > b_lo && ctx.a[start_a - 1] == ctx.b[start_b - 1]) {
+                    --start_a;
+                    --start_b;
+                }
+                while (end_a < a_hi && end_b < b_hi && ctx.a[end_a] == ctx.b[end_b]) {
+                    ++end_a;
+                    ++end_b;
+                }
+                int length = end_a - start_a;
+                if (count < best_count || length > best_length
+                    || (length == best_length && abs(start_b - middle) < abs(best_b - middle))) {
+                    best_count = count;
+                    best_a = start_a;
+                    best_b = start_b;
+                    best_length = length;
+                }
+                next_j = max(next_j, end_b);
+            }
+            j = next_j;
+        }
+
+        if (best_length == 0) {
+            myers(ctx, a_lo, a_hi, b_lo, b_hi);
+            return;
+        }
+        histogram(ctx, a_lo, best_a, b_lo, best_b);
+        a_lo = best_a + best_length;
+        b_lo = best_b + best_length;
+    }
+}
+
+} // namespace
+
+std::vector<DiffChange> diff_lines(const std::vector<std::string_view> &a, const std::vector<std::string_view> &b,
+                                   DiffAlgorithm algorithm) {
+    DiffContext ctx;
+    unordered_map<string_view, int> ids;
+    ids.reserve(a.size() + b.size());
+    ctx.a.reserve(a.size());
+    ctx.b.reserve(b.size());
+    for (auto &line : a) {
+        ctx.a.push_back(ids.emplace(line, ids.size()).first->second);
+    }
+    for (auto &line : b) {
+        ctx.b.push_back(ids.emplace(line, ids.size()).first->second);
+    }
+
+    int n = ctx.a.size(), m = ctx.b.size();
+    ctx.changed_a.assign(n, 0);
+    ctx.changed_b.assign(m, 0);
+    ctx.forward.assign(n + m + 4, 0);
+    ctx.backward.assign(n + m + 4, 0);
+
+    if (algorithm == DiffAlgorithm::HISTOGRAM) {
+        index_occurrences(ctx, ids.size());
+        histogram(ctx, 0, n, 0, m);
+    } else {
+        myers(ctx, 0, n, 0, m);
+    }
+
+    // Unchanged lines of both sides correspond to each other in order
+    vector<DiffChange> changes;
+    int i = 0, j = 0;
+    while (i < n || j < m) {
+        if (i < n && j < m && !ctx.changed_a[i] && !ctx.changed_b[j]) {
+            ++i;
+            ++j;
+            continue;
+        }
+        DiffChange change{i, 0, j, 0};
+        while (i < n && ctx.changed_a[i]) {
+            ++i;
+        }
+        while (j < m && ctx.changed_b[j]) {
+            ++j;
+        }
+        change.old_count = i - change.old_start;
+        change.new_count = j - change.new_start;
+        changes.push_back(change);
+    }
+    return changes;
+}
+
+static void print_range(std::ostream &os, int start, int count) {
+    // Empty ranges are reported by the line before them, as GNU diff does
+    os << (count == 0 ? start : start + 1);
+    if (count != 1) {
+        os << ',' << count;
+    }
+}
+
+static void print_line(std::ostream &os, char prefix, std::string_view line) {
+    os << prefix << line;
+    if (line.empty() || line.back() != '\n') {
+        os << "\n\\ No newline at end of file\n";
+    }
+}
+
+void print_unified_diff(std::ostream &os, const std::string &old_label, const std::string &new_label,
+                        std::string_view old_content, std::string_view new_content,
+                        DiffAlgorithm algorithm, int context) {
+    if (old_content == new_content) {
+        return;
+    }
+    if (is_binary(old_content) || is_binary(new_content)) {
+        os << "Binary files " << old_label << " and " << new_label << " differ\n";
+        return;
+    }
+
+    vector<string_view> a = split_lines(old_content), b = split_lines(new_content);
+    vector<DiffChange> changes = diff_lines(a, b, algorithm);
+    os << "--- " << old_label << '\n' << "+++ " << new_label << '\n';
+
+    int a_size = a.size(), b_size = b.size();
+    for (size_t first = 0; first < changes.size();) {
+        // Changes separated by at most 2 * context unchanged lines share one hunk
+        size_t last = first;
+        while (last + 1 < changes.size()
+               && changes[last + 1].old_start - (changes[last].old_start + changes[last].old_count) <= 2 * context) {
+            ++last;
+        }
+
+        int old_start = max(0, changes[first].old_start - context);
+        int new_start = max(0, changes[first].new_start - context);
+        int old_end = min(a_size, changes[last].old_start + changes[last].old_count + context);
+        int new_end = min(b_size, changes[last].new_start + changes[last].new_count + context);
+
+        os << "@@ -";
+        print_range(os, old_start, old_end - old_start);
+        os << " +";
+        print_range(os, new_start, new_end - new_start);
+        os << " @@\n";
+
+        int i = old_start;
+        for (size_t c = first; c <= last; ++c) {
+            for (; i < changes[c].old_start; ++i) {
+                print_line(os, ' ', a[i]);
+            }
+            for (int k = 0; k < changes[c].old_count; ++k) {
+                print_line(os, '-', a[i++]);
+            }
+            for (int k = 0; k < changes[c].new_count; ++k) {
+                print_line(os, '+', b[changes[c].new_start + k]);
+            }
+        }
+        for (; i < old_end; ++i) {
+            print_line(os, ' ', a[i]);
+        }
+        first = last + 1;
+    }
+}
+
+// For every line of the base, the index of the line it is matched with in the other file, or -1
+static vector<int> match_base_lines(const vector<string_view> &base, const vector<string_view> &other,
+                                    DiffAlgorithm algorithm) {
+    vector<int> matches(base.size(), -1);
+    int i = 0, j = 0;
+    for (auto &change : diff_lines(base, other, algorithm)) {
+        for (; i < change.old_start; ++i, ++j) {
+            matches[i] = j;
+        }
+        i += change.old_count;
+        j += change.new_count;
+    }
+    for (; i < (int) base.size(); ++i, ++j) {
+        matches[i] = j;
+    }
+    return matches;
+}
+
+static void append_lines(std::string &result, const vector<string_view> &lines, int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+        result.append(lines[i]);
+    }
+}
+
+static bool equal_lines(const vector<string_view> &a, int a_begin, int a_end,
+                        const vector<string_view> &b, int b_begin, int b_end) {
+    return a_end - a_begin == b_end - b_begin && equal(a.begin() + a_begin, a.begin() + a_end, b.begin() + b_begin);
+}
+
+// Write a conflict region, keeping the lines common to both sides at its edges outside of the markers
+static void append_conflict(std::string &result, const vector<string_view> &ours, int a_begin, int a_end,
+                            const vector<string_view> &theirs, int b_begin, int b_end) {
+    while (a_begin < a_end && b_begin < b_end && ours[a_begin] == theirs[b_begin]) {
+        result.append(ours[a_begin]);
+        ++a_begin;
+        ++b_begin;
+    }
+    int suffix = 0;
+    while (a_end - suffix > a_begin && b_end - suffix > b_begin
+           && ours[a_end - suffix - 1] == theirs[b_end - suffix - 1]) {
+        ++suffix;
+    }
+
+    auto append_side = [&result](const vector<string_view> &lines, int begin, int end) {
+        append_lines(result, lines, begin, end);
+        if (!result.empty() && result.back() != '\n') {
+            result.push_back('\n');
+        }
+    };
+    result.append("<<<<<<< HEAD\n");
+    append_side(ours, a_begin, a_end - suffix);
+    result.append("=======\n");
+    append_side(theirs, b_begin, b_end - suffix);
+    result.append(">>>>>>>\n");
+    append_lines(result, ours, a_end - suffix, a_end);
+}
+
+int merge_lines(std::string &result, std::string_view base, std::string_view ours, std::string_view theirs,
+                DiffAlgorithm algorithm) {
+    vector<string_view> o = split_lines(base), a = split_lines(ours), b = split_lines(theirs);
+    vector<int> match_a = match_base_lines(o, a, algorithm), match_b = match_base_lines(o, b, algorithm);
+    const int n = o.size();
+
+    result.clear();
+    int conflicts = 0;
+    int i = 0, j = 0, k = 0;    // positions in base, ours and theirs
+    while (i < n || j < (int) a.size() || k < (int) b.size()) {
+        // Stable region: lines of the base kept in order on both sides
+        int stable = 0;
+        while (i + stable < n && match_a[i + stable] == j + stable && match_b[i + stable] == k + stable) {
+            ++stable;
+        }
+        if (stable > 0) {
+            append_lines(result, o, i, i + stable);
+            i += stable;
+            j += stable;
+            k += stable;
+            continue;
+        }
+
+        // Unstable region: up to the next base line kept on both sides
+        int next = i;
+        while (next < n && (match_a[next] < 0 || match_b[next] < 0)) {
+            ++next;
+        }
+        int a_end = next < n ? match_a[next] : (int) a.size();
+        int b_end = next < n ? match_b[next] : (int) b.size();
+
+        if (equal_lines(o, i, next, a, j, a_end)) {
+            append_lines(result, b, k, b_end);       // only theirs changed
+        } else if (equal_lines(o, i, next, b, k, b_end) || equal_lines(a, j, a_end, b, k, b_end)) {
+            append_lines(result, a, j, a_end);       // only ours changed, or both changed the same way
+        } else {
+            append_conflict(result, a, j, a_end, b, k, b_end);
+            ++conflicts;
+        }
+        i = next;
+        j = a_end;
+        k = b_end;
+    }
+    return conflicts;
+}
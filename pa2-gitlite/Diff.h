@@ -0,0 +1,105 @@
+//
+// Line-level diff and three-way merge of file contents. Used by the diff and merge commands.
+//
+
+#ifndef COMP2012H_FA21_PA2_DIFF_H
+#define COMP2012H_FA21_PA2_DIFF_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ostream>
+#include <filesystem>
+
+// Read-only view of the contents of a file. The file is mmapped where the platform
+// supports it, so looking at a large blob does not copy it onto the heap.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::filesystem::path &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    std::string_view view() const;
+
+private:
+    void unmap();
+
+    const char *data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    std::string fallback;   // used when the file cannot be mapped (e.g. empty files, Windows)
+};
+
+enum class DiffAlgorithm {
+    MYERS,      // Myers' O(ND) algorithm, linear space variant
+    HISTOGRAM   // anchor on the least frequent common lines, fall back to Myers
+};
+
+// A changed region: lines [old_start, old_start + old_count) of the old file were replaced
+// by lines [new_start, new_start + new_count) of the new file. Indices are 0-based.
+struct DiffChange {
+    int old_start, old_count;
+    int new_start, new_count;
+};
+
+/**
+ * Split the content into lines. Each line keeps its trailing '\n', so a missing newline
+ * at the end of file is a difference.
+ * @param content the content to split
+ * @return views into content, one for each line
+ */
+std::vector<std::string_view> split_lines(std::string_view content);
+
+/**
+ * Compute the changed regions between two sequences of lines
+ * @param a lines of the old file
+ * @param b lines of the new file
+ * @param algorithm the algorithm used to match lines
+ * @return the changed regions in increasing order
+ */
+std::vector<DiffChange> diff_lines(const std::vector<std::string_view> &a, const std::vector<std::string_view> &b,
+                                   DiffAlgorithm algorithm = DiffAlgorithm::MYERS);
+
+/**
+ * Check whether the content looks like a binary file (contains NUL in the first 8000 bytes)
+ * @param content the content to check
+ * @return true if it is considered binary
+ */
+bool is_binary(std::string_view content);
+
+/**
+ * Print the difference between two files in unified format.
+ * Nothing is printed if the contents are identical.
+ * @param os the stream to print to
+ * @param old_label label of the old file, e.g. a/v1.txt or /dev/null
+ * @param new_label label of the new file, e.g. b/v1.txt or /dev/null
+ * @param old_content content of the old file
+ * @param new_content content of the new file
+ * @param algorithm the algorithm used to match lines
+ * @param context number of unchanged lines shown around each change
+ */
+void print_unified_diff(std::ostream &os, const std::string &old_label, const std::string &new_label,
+                        std::string_view old_content, std::string_view new_content,
+                        DiffAlgorithm algorithm = DiffAlgorithm::MYERS, int context = 3);
+
+/**
+ * Three-way merge of two versions of a file derived from a common base, in the style of diff3.
+ * Regions changed on only one side (or identically on both) are merged automatically; regions
+ * changed differently on both sides are wrapped in conflict markers, trimmed to the lines that
+ * actually differ.
+ * @param result the merged content
+ * @param base content of the common ancestor
+ * @param ours content of the current (HEAD) version
+ * @param theirs content of the version being merged in
+ * @param algorithm the algorithm used to match lines against the base
+ * @return the number of conflict regions written to result
+ */
+int merge_lines(std::string &result, std::string_view base, std::string_view ours, std::string_view theirs,
+                DiffAlgorithm algorithm = DiffAlgorithm::MYERS);
+
+#endif //COMP2012H_FA21_PA2_DIFF_H
@@ -0,0 +1,89 @@
+#include <algorithm>
+
+#include "Ewah.h"
+
+using namespace std;
+
+static constexpr uint64_t MAX_RUN = (uint64_t(1) << 32) - 1;
+static constexpr uint64_t MAX_LITERALS = (uint64_t(1) << 31) - 1;
+
+static uint64_t make_marker(bool bit, uint64_t run, uint64_t literals) {
+    return uint64_t(bit) | run << 1 | literals << 33;
+}
+
+static bool run_bit(uint64_t marker) {
+    return marker & 1;
+}
+
+static uint64_t run_length(uint64_t marker) {
+    return marker >> 1 & MAX_RUN;
+}
+
+static uint64_t literal_count(uint64_t marker) {
+    return marker >> 33;
+}
+
+EwahBitmap EwahBitmap::compress(const std::vector<uint64_t> &words) {
+    EwahBitmap bitmap;
+    size_t i = 0;
+    while (i < words.size()) {
+        // A run of clean words, then the dirty words up to the next clean one
+        bool bit = words[i] == ~uint64_t(0);
+        uint64_t run = 0;
+        uint64_t clean = bit ? ~uint64_t(0) : 0;
+        while (i < words.size() && words[i] == clean && run < MAX_RUN) {
+            ++run;
+            ++i;
+        }
+        size_t marker = bitmap.buffer.size();
+        bitmap.buffer.push_back(0);
+        uint64_t literals = 0;
+        while (i < words.size() && words[i] != 0 && words[i] != ~uint64_t(0) && literals < MAX_LITERALS) {
+            bitmap.buffer.push_back(words[i]);
+            ++literals;
+            ++i;
+        }
+        bitmap.buffer[marker] = make_marker(bit, run, literals);
+    }
+    return bitmap;
+}
+
+void EwahBitmap::or_into(std::vector<uint64_t> &words) const {
+    size_t word = 0;
+    for (size_t i = 0; i < buffer.size() && word < words.size(); ++i) {
+        uint64_t marker = buffer[i];
+        uint64_t run = min<uint64_t>(run_length(marker), words.size() - word);
+        if (run_bit(marker)) {
+            fill(words.begin() + word, words.begin() + word + run, ~uint64_t(0));
+        }
+        word += run;
+        for (uint64_t k = 0; k < literal_count(marker) && i + 1 < buffer.size(); ++k, ++word) {
+            ++i;
+            if (word < words.size())
+                words[word] |= buffer[i];
+        }
+    }
+}
+
+bool EwahBitmap::get(size_t position) const {
+    size_t target = position / 64, word = 0;
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        uint64_t marker = buffer[i];
+        uint64_t run = run_length(marker), literals = literal_count(marker);
+        if (target < word + run) {
+            return run_bit(marker);
+        }
+        word += run;
+        if (target < word + literals) {
+            size_t index = i + 1 + (target - word);
+            return index < buffer.size() && buffer[index] >> position % 64 & 1;
+        }
+        word += literals;
+        i += literals;
+    }
+    return false;
+}
+
+size_t EwahBitmap::word_count() const {
+    return buffer.size();
+}
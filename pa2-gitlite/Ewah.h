@@ -0,0 +1,45 @@
+//
+// EWAH (Enhanced Word-Aligned Hybrid) compressed bitmap. The bits are grouped into 64-bit words;
+// runs of words that are all zeros or all ones are stored as a count, other words as they are.
+// Each marker word holds the bit of a run (bit 0), the number of words in the run (bits 1-32)
+// and the number of literal words that follow the marker (bits 33-63).
+//
+
+#ifndef COMP2012H_FA21_PA2_EWAH_H
+#define COMP2012H_FA21_PA2_EWAH_H
+
+#include <cstdint>
+#include <vector>
+#include <cereal/types/vector.hpp>
+
+class EwahBitmap {
+public:
+    EwahBitmap() = default;
+
+    /**
+     * Compress an uncompressed bitmap
+     * @param words bit i is bit i % 64 of words[i / 64]
+     * @return the compressed bitmap
+     */
+    static EwahBitmap compress(const std::vector<uint64_t> &words);
+
+    /**
+     * Set the bits of this bitmap in an uncompressed bitmap
+     * @param words the uncompressed bitmap, bits past its end are left out
+     */
+    void or_into(std::vector<uint64_t> &words) const;
+
+    bool get(size_t position) const;
+
+    size_t word_count() const;      // compressed size in words
+
+    template <class Archive>
+    void serialize(Archive &archive) {
+        archive(buffer);
+    }
+
+private:
+    std::vector<uint64_t> buffer;
+};
+
+#endif //COMP2012H_FA21_PA2_EWAH_H
@@ -0,0 +1,267 @@
+#include <csignal>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "FsMonitor.h"
+#include "Ignore.h"
+#include "Utils.h"
+
+using namespace std;
+using path = std::filesystem::path;
+
+static path pid_file(const path &state_dir) {
+    return state_dir / path("pid");
+}
+
+static path generation_file(const path &state_dir) {
+    return state_dir / path("generation");
+}
+
+static path journal_file(const path &state_dir) {
+    return state_dir / path("journal");
+}
+
+static path snapshot_file(const path &state_dir) {
+    return state_dir / path("snapshot");
+}
+
+static bool watcher_alive(const path &state_dir) {
+#ifdef __linux__
+    if (!filesystem::is_regular_file(pid_file(state_dir)))
+        return false;
+    pid_t pid = stoi(read_content(pid_file(state_dir)));
+    return pid > 0 && kill(pid, 0) == 0;
+#else
+    (void) state_dir;
+    return false;
+#endif
+}
+
+std::string fsmonitor_token(const std::filesystem::path &state_dir) {
+    if (!watcher_alive(state_dir) || !filesystem::is_regular_file(generation_file(state_dir)))
+        return string();
+    return read_content(generation_file(state_dir)) + ":" + to_string(filesystem::file_size(journal_file(state_dir)));
+}
+
+bool read_fsmonitor_changes(const std::filesystem::path &state_dir, const std::string &token,
+                            std::vector<std::string> &changes, std::string &new_token) {
+    string current = fsmonitor_token(state_dir);
+    size_t separator = token.rfind(':');
+    if (current.empty() || separator == string::npos
+        || current.compare(0, separator + 1, token, 0, separator + 1) != 0) {
+        return false;   // no watcher, or a different journal
+    }
+
+    uintmax_t offset = stoull(token.substr(separator + 1));
+    ifstream is(journal_file(state_dir), ios::in | ios::binary);
+    if (!is.is_open())
+        return false;
+    is.seekg(offset);
+
+    // Only complete lines count, the watcher may be in the middle of writing one
+    string line;
+    while (getline(is, line) && !is.eof()) {
+        if (line == "*")
+            return false;
+        changes.push_back(line);
+        offset += line.size() + 1;
+    }
+    new_token = token.substr(0, separator + 1) + to_string(offset);
+    return true;
+}
+
+bool load_fsmonitor_snapshot(const std::filesystem::path &state_dir, std::string &token,
+                             std::vector<SnapshotFile> &files) {
+    ifstream is(snapshot_file(state_dir));
+    if (!is.is_open() || !getline(is, token))
+        return false;
+    for (string line; getline(is, line);) {
+        size_t separator = line.compare(0, 2, "- ") == 0 ? 1 : ObjectId::HEX_SIZE;
+        if (line.size() <= separator || line[separator] != ' ')
+            return false;   // written by an older version, the listing is done again
+        SnapshotFile file{line.substr(separator + 1), ObjectId()};
+        try {
+            if (separator == ObjectId::HEX_SIZE)
+                file.ref = ObjectId::from_hex(string_view(line).substr(0, separator));
+        } catch (const std::invalid_argument &) {
+            return false;
+        }
+        files.push_back(std::move(file));
+    }
+    return true;
+}
+
+void save_fsmonitor_snapshot(const std::filesystem::path &state_dir, const std::string &token,
+                             const std::vector<SnapshotFile> &files) {
+    ostringstream os;
+    os << token << '\n';
+    for (auto &file : files) {
+        os << (file.ref.is_null() ? "-" : file.ref.to_hex()) << ' ' << file.name << '\n';
+    }
+    write_content(snapshot_file(state_dir), os.str());
+}
+
+#ifdef __linux__
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int) {
+    stop_requested = 1;
+}
+
+namespace {
+
+class Watcher {
+public:
+    Watcher(const path &root, const path &ignore_file, ofstream &journal)
+            : root(root), ignore_file(ignore_file), ignore(IgnoreMatcher::from_file(ignore_file)),
+              journal(journal), fd(inotify_init1(IN_CLOEXEC)) {}
+
+    ~Watcher() {
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    bool valid() const {
+        return fd >= 0;
+    }
+
+    // Watch a directory (given relative to root, empty for root) and everything below it.
+    // Watching a directory again keeps its watch descriptor.
+    void watch_tree(const string &dir) {
+        const uint32_t mask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB
+                              | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR;
+        path full = dir.empty() ? root : root / path(dir);
+        int wd = inotify_add_watch(fd, full.c_str(), mask);
+        if (wd < 0)
+            return;
+        directories[wd] = dir;
+
+        error_code ec;
+        for (auto &entry : filesystem::directory_iterator(full, ec)) {
+            if (!entry.is_directory() || entry.is_symlink() || entry.path().filename() == ".gitlite")
+                continue;
+            string child = dir.empty() ? entry.path().filename().generic_string()
+                                       : dir + "/" + entry.path().filename().generic_string();
+            if (!ignore.is_ignored_entry(child, true))
+                watch_tree(child);
+        }
+    }
+
+    // Wait for events and append the changed paths to the journal
+    void process() {
+        alignas(inotify_event) char buf[64 * 1024];
+        pollfd pfd{fd, POLLIN, 0};
+        while (!stop_requested) {
+            if (poll(&pfd, 1, 500) <= 0)
+                continue;
+            ssize_t length = read(fd, buf, sizeof(buf));
+            if (length <= 0)
+                continue;
+            for (char *ptr = buf; ptr < buf + length;) {
+                auto *event = reinterpret_cast<inotify_event *>(ptr);
+                handle(*event);
+                ptr += sizeof(inotify_event) + event->len;
+            }
+            journal.flush();
+        }
+    }
+
+private:
+    void handle(const inotify_event &event) {
+        if (event.mask & IN_Q_OVERFLOW) {
+            journal << "*\n";   // events were lost, readers must scan everything
+            last_name.clear();
+            return;
+        }
+        auto iter = directories.find(event.wd);
+        if (iter == directories.end())
+            return;
+        if (event.mask & (IN_DELETE_SELF | IN_IGNORED)) {
+            directories.erase(iter);
+            return;
+        }
+        if (event.len == 0)
+            return;
+
+        string name = iter->second.empty() ? string(event.name) : iter->second + "/" + event.name;
+        if (name == ".gitlite")
+            return;
+        if (root / path(name) == ignore_file) {
+            // Directories ignored until now may have to be watched. The ones ignored from now on stay
+            // watched, readers drop their paths. The name is always journaled after the new watches
+            // are in place, so a reader rescanning because of it does not miss their events.
+            ignore = IgnoreMatcher::from_file(ignore_file);
+            watch_tree(string());
+            last_name.clear();
+        }
+        if ((event.mask & IN_ISDIR) && (event.mask & (IN_CREATE | IN_MOVED_TO))
+            && !ignore.is_ignored_entry(name, true)) {
+            watch_tree(name);
+        }
+        if (name != last_name) {    // a write usually comes as several events on the same file
+            journal << name << '\n';
+            last_name = name;
+        }
+    }
+
+    const path root;
+    const path ignore_file;
+    IgnoreMatcher ignore;
+    ofstream &journal;
+    int fd;
+    unordered_map<int, string> directories;     // watch descriptor -> directory relative to root
+    string last_name;
+};
+
+} // namespace
+
+bool run_fsmonitor(const std::filesystem::path &root, const std::filesystem::path &state_dir,
+                   const std::filesystem::path &ignore_file) {
+    if (watcher_alive(state_dir)) {
+        cout << "A watcher is already running." << endl;
+        return false;
+    }
+    filesystem::create_directories(state_dir);
+
+    // A new journal invalidates all the tokens handed out by a previous watcher
+    ofstream journal(journal_file(state_dir), ios::out | ios::binary | ios::trunc);
+    Watcher watcher(root, ignore_file, journal);
+    if (!journal.is_open() || !watcher.valid()) {
+        cout << "Failed to start watching the working directory." << endl;
+        return false;
+    }
+    watcher.watch_tree(string());
+
+    write_content(generation_file(state_dir), to_string(time(nullptr)) + "-" + to_string(getpid()));
+    write_content(pid_file(state_dir), to_string(getpid()));
+    filesystem::remove(snapshot_file(state_dir));
+
+    signal(SIGINT, request_stop);
+    signal(SIGTERM, request_stop);
+    cout << "Watching " << root.string() << " for changes." << endl;
+    watcher.process();
+
+    filesystem::remove(pid_file(state_dir));
+    return true;
+}
+
+#else
+
+bool run_fsmonitor(const std::filesystem::path &, const std::filesystem::path &, const std::filesystem::path &) {
+    cout << "Watching for changes is only supported on Linux." << endl;
+    return false;
+}
+
+#endif
@@ -0,0 +1,68 @@
+//
+// Filesystem monitor. A long-running watcher (gitlite watch, Linux only) records the paths that
+// change in the working directory into a journal under .gitlite/fsmonitor, so that listing the
+// working directory only needs to look at the paths recorded since the last listing.
+//
+// Files in .gitlite/fsmonitor:
+//   pid         process id of the running watcher
+//   generation  identifies the journal, changes whenever a watcher starts
+//   journal     changed paths relative to CWD, one per line, "*" if events were lost
+//   snapshot    files in the working directory as of the token on its first line, one per line:
+//               the SHA1 of the content if it has been computed, otherwise "-", a space and the path
+//
+
+#ifndef COMP2012H_FA21_PA2_FSMONITOR_H
+#define COMP2012H_FA21_PA2_FSMONITOR_H
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "ObjectId.h"
+
+// A file of the snapshot, ref is the SHA1 of its content as of the token or null if not computed yet
+struct SnapshotFile {
+    std::string name;
+    ObjectId ref;
+};
+
+/**
+ * Watch the working directory and record changes until interrupted (SIGINT or SIGTERM)
+ * @param root the working directory
+ * @param state_dir .gitlite/fsmonitor
+ * @param ignore_file .gitliteignore, ignored directories are not watched. The patterns are loaded
+ *                    again whenever the file changes, and the directories no longer ignored are watched.
+ * @return false if the watcher could not be started
+ */
+bool run_fsmonitor(const std::filesystem::path &root, const std::filesystem::path &state_dir,
+                   const std::filesystem::path &ignore_file);
+
+/**
+ * Get the current position in the journal of the running watcher
+ * @param state_dir .gitlite/fsmonitor
+ * @return the token, or an empty string if no watcher is running
+ */
+std::string fsmonitor_token(const std::filesystem::path &state_dir);
+
+/**
+ * Read the paths changed since the given token
+ * @param state_dir .gitlite/fsmonitor
+ * @param token a token from fsmonitor_token
+ * @param changes the changed paths, may contain duplicates
+ * @param new_token the token after the last change read
+ * @return false if the changes are unknown (watcher not running, restarted, or lost events)
+ */
+bool read_fsmonitor_changes(const std::filesystem::path &state_dir, const std::string &token,
+                            std::vector<std::string> &changes, std::string &new_token);
+
+/**
+ * Load the listing of the working directory saved with save_fsmonitor_snapshot
+ * @return false if there is no snapshot or it cannot be read
+ */
+bool load_fsmonitor_snapshot(const std::filesystem::path &state_dir, std::string &token,
+                             std::vector<SnapshotFile> &files);
+
+void save_fsmonitor_snapshot(const std::filesystem::path &state_dir, const std::string &token,
+                             const std::vector<SnapshotFile> &files);
+
+#endif //COMP2012H_FA21_PA2_FSMONITOR_H
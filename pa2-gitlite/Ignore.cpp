@@ -0,0 +1,257 @@
+#include <fstream>
+#include <sstream>
+
+#include "Ignore.h"
+
+using namespace std;
+
+// The executable itself lives in CWD while testing, it is never something to track
+static const char *const DEFAULT_PATTERNS = "/gitlite\n/gitlite.exe\n";
+
+static bool has_wildcard(const string &pattern) {
+    return pattern.find_first_of("*?[\\") != string::npos;
+}
+
+IgnoreMatcher::IgnoreMatcher() : root(make_shared<TrieNode>()) {
+    istringstream is(DEFAULT_PATTERNS);
+    for (string line; getline(is, line);) {
+        add_pattern(line);
+    }
+}
+
+IgnoreMatcher::IgnoreMatcher(const std::string &patterns) : IgnoreMatcher() {
+    istringstream is(patterns);
+    for (string line; getline(is, line);) {
+        add_pattern(line);
+    }
+}
+
+IgnoreMatcher IgnoreMatcher::from_file(const std::filesystem::path &file) {
+    ifstream is(file);
+    if (!is.is_open()) {
+        return IgnoreMatcher();
+    }
+    ostringstream buf;
+    buf << is.rdbuf();
+    return IgnoreMatcher(buf.str());
+}
+
+void IgnoreMatcher::add_pattern(std::string pattern) {
+    while (!pattern.empty() && isspace(static_cast<unsigned char>(pattern.back()))) {
+        pattern.pop_back();
+    }
+    if (pattern.empty() || pattern[0] == '#') {
+        return;
+    }
+
+    Rule rule{static_cast<int>(rules.size()), false, false, {}};
+    if (pattern[0] == '!') {
+        rule.negated = true;
+        pattern.erase(0, 1);
+    }
+    if (!pattern.empty() && pattern.back() == '/') {
+        rule.directory_only = true;
+        pattern.pop_back();
+    }
+    bool anchored = pattern.find('/') != string::npos;
+    if (!pattern.empty() && pattern[0] == '/') {
+        pattern.erase(0, 1);
+    }
+    if (pattern.empty()) {
+        return;
+    }
+
+    bool wildcard = has_wildcard(pattern);
+    if (wildcard) {
+        rule.glob = compile(pattern);
+    }
+    int index = rule.priority;
+    rules.push_back(std::move(rule));
+
+    if (!anchored) {
+        if (wildcard)
+            name_globs.push_back(index);
+        else
+            name_literals[pattern].push_back(index);
+        return;
+    }
+
+    // Anchored patterns hang off the trie at their longest literal directory prefix
+    size_t literal_end = wildcard ? pattern.find_first_of("*?[\\") : pattern.size();
+    size_t prefix_end = wildcard ? pattern.rfind('/', literal_end) : string::npos;
+    TrieNode *node = root.get();
+    size_t start = 0;
+    while (start < pattern.size()) {
+        size_t slash = pattern.find('/', start);
+        if (slash == string::npos)
+            slash = pattern.size();
+        if (wildcard && (prefix_end == string::npos || slash > prefix_end))
+            break;
+        auto &child = node->children[pattern.substr(start, slash - start)];
+        if (!child)
+            child = make_unique<TrieNode>();
+        node = child.get();
+        start = slash + 1;
+    }
+    (wildcard ? node->globs : node->literals).push_back(index);
+}
+
+std::vector<IgnoreMatcher::Token> IgnoreMatcher::compile(const std::string &glob) {
+    vector<Token> tokens;
+    for (size_t i = 0; i < glob.size(); ++i) {
+        char ch = glob[i];
+        if (ch == '*') {
+            if (i + 1 < glob.size() && glob[i + 1] == '*') {
+                // "**/" matches any number of leading directories, a lone "**" anything at all
+                if (i + 2 < glob.size() && glob[i + 2] == '/') {
+                    tokens.emplace_back(Token::GLOBSTAR_DIR);
+                    i += 2;
+                } else {
+                    tokens.emplace_back(Token::GLOBSTAR);
+                    ++i;
+                }
+            } else {
+                tokens.emplace_back(Token::STAR);
+            }
+        } else if (ch == '?') {
+            tokens.emplace_back(Token::ANY);
+        } else if (ch == '[' && glob.find(']', i + 2) != string::npos) {
+            Token token(Token::CLASS);
+            size_t j = i + 1;
+            bool negated = glob[j] == '!' || glob[j] == '^';
+            if (negated)
+                ++j;
+            for (bool first = true; j < glob.size() && (first || glob[j] != ']'); ++j, first = false) {
+                unsigned char low = glob[j], high = low;
+                if (j + 2 < glob.size() && glob[j + 1] == '-' && glob[j + 2] != ']') {
+                    high = glob[j + 2];
+                    j += 2;
+                }
+                for (unsigned c = low; c <= high; ++c)
+                    token.chars.set(c);
+            }
+            if (negated)
+                token.chars.flip();
+            token.chars.reset('/');
+            tokens.push_back(token);
+            i = j;
+        } else {
+            if (ch == '\\' && i + 1 < glob.size())
+                ch = glob[++i];
+            tokens.emplace_back(Token::CHAR, ch);
+        }
+    }
+    return tokens;
+}
+
+// Run the glob as a nondeterministic automaton whose states are the positions in the token list
+bool IgnoreMatcher::match(const std::vector<Token> &glob, const std::string &text) {
+    const size_t n = glob.size();
+    vector<char> states(n + 1, 0), next(n + 1, 0);
+
+    auto close = [&glob, n](vector<char> &set, bool at_boundary) {
+        // Wildcards may match the empty string, "**/" only as zero directories at the start of a component
+        for (size_t i = 0; i < n; ++i) {
+            if (set[i] && glob[i].kind >= Token::STAR && (glob[i].kind != Token::GLOBSTAR_DIR || at_boundary))
+                set[i + 1] = 1;
+        }
+    };
+
+    states[0] = 1;
+    close(states, true);
+    for (char ch : text) {
+        fill(next.begin(), next.end(), 0);
+        bool alive = false;
+        for (size_t i = 0; i < n; ++i) {
+            if (!states[i])
+                continue;
+            const Token &token = glob[i];
+            switch (token.kind) {
+                case Token::CHAR:
+                    if (ch == token.ch)
+                        next[i + 1] = 1;
+                    break;
+                case Token::ANY:
+                    if (ch != '/')
+                        next[i + 1] = 1;
+                    break;
+                case Token::CLASS:
+                    if (token.chars.test(static_cast<unsigned char>(ch)))
+                        next[i + 1] = 1;
+                    break;
+                case Token::STAR:
+                    if (ch != '/')
+                        next[i] = 1;
+                    break;
+                case Token::GLOBSTAR:
+                    next[i] = 1;
+                    break;
+                case Token::GLOBSTAR_DIR:
+                    // Stay inside the leading directories, leaving them only after a whole "name/"
+                    next[i] = 1;
+                    if (ch == '/')
+                        next[i + 1] = 1;
+                    break;
+            }
+        }
+        close(next, ch == '/');
+        for (char state : next)
+            alive |= state != 0;
+        if (!alive)
+            return false;
+        states.swap(next);
+    }
+    return states[n] != 0;
+}
+
+void IgnoreMatcher::consider(int rule, bool is_directory, int &best) const {
+    if (rule > best && (!rules[rule].directory_only || is_directory))
+        best = rule;
+}
+
+bool IgnoreMatcher::is_ignored_entry(const std::string &path, bool is_directory) const {
+    int best = -1;
+    size_t slash = path.rfind('/');
+    string name = slash == string::npos ? path : path.substr(slash + 1);
+
+    auto iter = name_literals.find(name);
+    if (iter != name_literals.end()) {
+        for (int rule : iter->second)
+            consider(rule, is_directory, best);
+    }
+    for (int rule : name_globs) {
+        if (rule > best && match(rules[rule].glob, name))
+            consider(rule, is_directory, best);
+    }
+
+    // Walk down the trie along the components of the path
+    const TrieNode *node = root.get();
+    size_t start = 0;
+    while (node != nullptr) {
+        for (int rule : node->globs) {
+            if (rule > best && match(rules[rule].glob, path))
+                consider(rule, is_directory, best);
+        }
+        if (start > path.size())
+            break;
+        size_t end = path.find('/', start);
+        if (end == string::npos)
+            end = path.size();
+        auto child = node->children.find(path.substr(start, end - start));
+        node = child == node->children.end() ? nullptr : child->second.get();
+        if (node != nullptr && end == path.size()) {
+            for (int rule : node->literals)
+                consider(rule, is_directory, best);
+        }
+        start = end + 1;
+    }
+    return best >= 0 && !rules[best].negated;
+}
+
+bool IgnoreMatcher::is_ignored(const std::string &path, bool is_directory) const {
+    for (size_t slash = path.find('/'); slash != string::npos; slash = path.find('/', slash + 1)) {
+        if (is_ignored_entry(path.substr(0, slash), true))
+            return true;
+    }
+    return is_ignored_entry(path, is_directory);
+}
@@ -0,0 +1,74 @@
+//
+// Matcher for the patterns in .gitliteignore, following the gitignore syntax:
+//   - blank lines and lines starting with '#' are skipped
+//   - '!' re-includes what an earlier pattern excluded; the last matching pattern wins
+//   - a trailing '/' only matches directories
+//   - a '/' at the beginning or in the middle anchors the pattern to CWD,
+//     otherwise it matches the name of a file or directory at any level
+//   - '*', '?' and '[...]' do not match '/', '**' matches across directories
+//
+// The patterns are compiled once. Patterns without wildcards are looked up in a hash map
+// (by name) or a trie of path components (anchored), and only the wildcard patterns reachable
+// through the trie are run, as small automata, against a path.
+//
+
+#ifndef COMP2012H_FA21_PA2_IGNORE_H
+#define COMP2012H_FA21_PA2_IGNORE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <bitset>
+#include <filesystem>
+#include <unordered_map>
+
+class IgnoreMatcher {
+public:
+    IgnoreMatcher();
+    explicit IgnoreMatcher(const std::string &patterns);
+
+    // Load the patterns from the given file, an empty matcher is returned if it does not exist
+    static IgnoreMatcher from_file(const std::filesystem::path &file);
+
+    // Whether a path (relative to CWD, separated by '/') is ignored, either by itself
+    // or because one of its parent directories is ignored
+    bool is_ignored(const std::string &path, bool is_directory = false) const;
+
+    // Whether a path is ignored by itself, not looking at its parent directories.
+    // Used while walking the working directory, where ignored directories are never entered.
+    bool is_ignored_entry(const std::string &path, bool is_directory) const;
+
+private:
+    struct Token {
+        enum Kind { CHAR, ANY, CLASS, STAR, GLOBSTAR, GLOBSTAR_DIR } kind;
+        char ch = 0;
+        std::bitset<256> chars;     // for CLASS
+
+        explicit Token(Kind kind, char ch = 0) : kind(kind), ch(ch) {}
+    };
+
+    struct Rule {
+        int priority;               // later patterns take precedence
+        bool negated;
+        bool directory_only;
+        std::vector<Token> glob;    // empty for literal patterns
+    };
+
+    struct TrieNode {
+        std::unordered_map<std::string, std::unique_ptr<TrieNode>> children;
+        std::vector<int> literals;  // rules matching exactly the path of this node
+        std::vector<int> globs;     // wildcard rules whose literal directory prefix is this node
+    };
+
+    void add_pattern(std::string pattern);
+    static std::vector<Token> compile(const std::string &glob);
+    static bool match(const std::vector<Token> &glob, const std::string &text);
+    void consider(int rule, bool is_directory, int &best) const;
+
+    std::vector<Rule> rules;
+    std::unordered_map<std::string, std::vector<int>> name_literals;
+    std::vector<int> name_globs;
+    std::shared_ptr<TrieNode> root;
+};
+
+#endif //COMP2012H_FA21_PA2_IGNORE_H
@@ -0,0 +1,61 @@
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#include "Intern.h"
+
+using namespace std;
+
+// The pool is never shrunk, so the pointers stay valid for the whole run. Strings in a deque
+// do not move when it grows, so the index can refer to their characters.
+// Created on first use, as strings may be interned while other files are initialized.
+namespace {
+
+struct Pool {
+    deque<string> strings;
+    unordered_map<string_view, const string *> index;
+    mutex lock;
+
+    static Pool &instance() {
+        static Pool pool;
+        return pool;
+    }
+
+    const string *intern_locked(string_view str) {
+        auto iter = index.find(str);
+        if (iter != index.end())
+            return iter->second;
+        const string &stored = strings.emplace_back(str);
+        index.emplace(stored, &stored);
+        return &stored;
+    }
+};
+
+}
+
+static const string *intern(string_view str) {
+    Pool &pool = Pool::instance();
+    lock_guard<mutex> guard(pool.lock);
+    return pool.intern_locked(str);
+}
+
+InternedString::InternedString() {
+    static const string *empty = intern(string_view());
+    value = empty;
+}
+
+InternedString::InternedString(const std::string &str) : value(intern(str)) {}
+
+InternedString::InternedString(const char *str) : value(intern(str)) {}
+
+InternedString::InternedString(std::string_view str) : value(intern(str)) {}
+
+std::vector<InternedString> InternedString::intern_all(const std::vector<std::string_view> &strings) {
+    vector<InternedString> interned(strings.size());
+    Pool &pool = Pool::instance();
+    lock_guard<mutex> guard(pool.lock);
+    for (size_t i = 0; i < strings.size(); ++i) {
+        interned[i].value = pool.intern_locked(strings[i]);
+    }
+    return interned;
+}
@@ -0,0 +1,100 @@
+//
+// Interned strings. Every distinct string is stored once in a global pool, and an InternedString
+// is a pointer into it, so a file name repeated in every commit shares one copy, and comparing
+// two interned strings for equality compares pointers.
+//
+// The pool is process-wide and never shrinks, so only file and branch names are interned: their
+// number is bounded by the distinct paths a process sees, not by the length of the history.
+// Blob refs and commit ids, which are new for every change, are kept as ObjectId instead.
+//
+
+#ifndef COMP2012H_FA21_PA2_INTERN_H
+#define COMP2012H_FA21_PA2_INTERN_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ostream>
+#include <functional>
+
+class InternedString {
+public:
+    InternedString();
+    InternedString(const std::string &str);     // implicit, so strings can be assigned directly
+    InternedString(const char *str);
+    explicit InternedString(std::string_view str);
+
+    /**
+     * Intern many strings at once, taking the lock of the pool a single time
+     * @param strings the strings to intern
+     * @return the interned strings, in the same order
+     */
+    static std::vector<InternedString> intern_all(const std::vector<std::string_view> &strings);
+
+    const std::string &str() const { return *value; }
+    operator const std::string &() const { return *value; }
+
+    bool empty() const { return value->empty(); }
+    size_t size() const { return value->size(); }
+    const char *c_str() const { return value->c_str(); }
+    std::string substr(size_t pos = 0, size_t count = std::string::npos) const { return value->substr(pos, count); }
+    int compare(const std::string &other) const { return value->compare(other); }
+    char operator[](size_t pos) const { return (*value)[pos]; }
+    std::string::const_iterator begin() const { return value->begin(); }
+    std::string::const_iterator end() const { return value->end(); }
+
+    friend bool operator==(const InternedString &a, const InternedString &b) { return a.value == b.value; }
+    friend bool operator!=(const InternedString &a, const InternedString &b) { return a.value != b.value; }
+    friend bool operator<(const InternedString &a, const InternedString &b) {
+        return a.value != b.value && *a.value < *b.value;
+    }
+
+    friend bool operator==(const InternedString &a, const std::string &b) { return *a.value == b; }
+    friend bool operator==(const std::string &a, const InternedString &b) { return a == *b.value; }
+    friend bool operator==(const InternedString &a, const char *b) { return *a.value == b; }
+    friend bool operator!=(const InternedString &a, const std::string &b) { return *a.value != b; }
+    friend bool operator!=(const std::string &a, const InternedString &b) { return a != *b.value; }
+    friend bool operator!=(const InternedString &a, const char *b) { return *a.value != b; }
+    friend bool operator<(const InternedString &a, const std::string &b) { return *a.value < b; }
+    friend bool operator<(const std::string &a, const InternedString &b) { return a < *b.value; }
+
+    friend bool operator>(const InternedString &a, const InternedString &b) { return b < a; }
+    friend bool operator<=(const InternedString &a, const InternedString &b) { return !(b < a); }
+    friend bool operator>=(const InternedString &a, const InternedString &b) { return !(a < b); }
+    friend bool operator>(const InternedString &a, const std::string &b) { return b < a; }
+    friend bool operator<=(const InternedString &a, const std::string &b) { return !(b < a); }
+    friend bool operator>=(const InternedString &a, const std::string &b) { return !(a < b); }
+    friend bool operator>(const std::string &a, const InternedString &b) { return b < a; }
+    friend bool operator<=(const std::string &a, const InternedString &b) { return !(b < a); }
+    friend bool operator>=(const std::string &a, const InternedString &b) { return !(a < b); }
+
+    friend std::string operator+(const std::string &a, const InternedString &b) { return a + *b.value; }
+    friend std::string operator+(const InternedString &a, const std::string &b) { return *a.value + b; }
+    friend std::string operator+(const char *a, const InternedString &b) { return a + *b.value; }
+    friend std::string operator+(const InternedString &a, const char *b) { return *a.value + b; }
+
+    friend std::ostream &operator<<(std::ostream &os, const InternedString &str) { return os << *str.value; }
+
+    // The pool is not part of the value, so persistent formats store the characters
+    template <class Archive>
+    std::string save_minimal(const Archive &) const { return *value; }
+
+    template <class Archive>
+    void load_minimal(const Archive &, const std::string &str) { *this = InternedString(str); }
+
+private:
+    friend struct std::hash<InternedString>;
+
+    const std::string *value;
+};
+
+namespace std {
+    template <>
+    struct hash<InternedString> {
+        size_t operator()(const InternedString &str) const noexcept {
+            return hash<const std::string *>()(str.value);
+        }
+    };
+}
+
+#endif //COMP2012H_FA21_PA2_INTERN_H
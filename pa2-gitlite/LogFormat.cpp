@@ -0,0 +1,144 @@
+#include "LogFormat.h"
+#include "CommitIndex.h"
+
+using namespace std;
+
+OutputBuffer::OutputBuffer(std::ostream &os) : os(os) {
+    data.reserve(CHUNK_SIZE * 2);
+}
+
+OutputBuffer::~OutputBuffer() {
+    flush();
+}
+
+std::string &OutputBuffer::buffer() {
+    return data;
+}
+
+void OutputBuffer::maybe_flush() {
+    if (data.size() >= CHUNK_SIZE)
+        flush();
+}
+
+void OutputBuffer::flush() {
+    if (!data.empty()) {
+        os.write(data.data(), static_cast<streamsize>(data.size()));
+        data.clear();
+    }
+    os.flush();
+}
+
+// Parents in the order they are printed: parent, second_parent, then the other parents
+static void append_parents(const Commit *commit, bool abbreviate, string &out) {
+    auto append = [&](const Commit *parent, bool first) {
+        if (!first)
+            out += ' ';
+        string id = parent->commit_id.to_hex();
+        out += abbreviate ? abbreviate_commit_id(id) : id;
+    };
+    if (commit->parent != nullptr)
+        append(commit->parent, true);
+    if (commit->second_parent != nullptr)
+        append(commit->second_parent, false);
+    for (const Commit *other : commit->other_parents)
+        append(other, false);
+}
+
+LogFormat LogFormat::compile(const std::string &format) {
+    static const pair<const char *, Field> placeholders[] = {
+            {"ad", Field::DATE}, {"H", Field::ID}, {"h", Field::ABBREV_ID}, {"P", Field::PARENTS},
+            {"p", Field::ABBREV_PARENTS}, {"s", Field::MESSAGE}, {"M", Field::MERGE_LINE},
+    };
+
+    LogFormat result;
+    string literal;
+    auto end_literal = [&]() {
+        if (!literal.empty())
+            result.segments.push_back({Field::LITERAL, std::move(literal)});
+        literal.clear();
+    };
+
+    for (size_t i = 0; i < format.size(); ++i) {
+        if (format[i] != '%' || i + 1 == format.size()) {
+            literal += format[i];
+            continue;
+        }
+        if (format[i + 1] == '%' || format[i + 1] == 'n') {
+            literal += format[i + 1] == 'n' ? '\n' : '%';
+            ++i;
+            continue;
+        }
+        bool matched = false;
+        for (auto &placeholder : placeholders) {
+            string_view name(placeholder.first);
+            if (format.compare(i + 1, name.size(), name) == 0) {
+                end_literal();
+                result.segments.push_back({placeholder.second, string()});
+                i += name.size();
+                matched = true;
+                break;
+            }
+        }
+        if (!matched)
+            literal += '%';
+    }
+    end_literal();
+    return result;
+}
+
+static const char STANDARD_FORMAT[] = "commit %H%n%MDate: %ad%n%n%s";
+
+const LogFormat &LogFormat::standard() {
+    static const LogFormat format = compile(STANDARD_FORMAT);
+    return format;
+}
+
+const LogFormat &LogFormat::log_entry() {
+    static const LogFormat format = compile(string("===%n") + STANDARD_FORMAT + "%n%n");
+    return format;
+}
+
+const LogFormat &LogFormat::graph_entry() {
+    static const LogFormat format = compile(string(STANDARD_FORMAT) + "%n%n");
+    return format;
+}
+
+void LogFormat::render(const Commit *commit, std::string &out) const {
+    for (auto &segment : segments) {
+        switch (segment.field) {
+            case Field::LITERAL:
+                out += segment.literal;
+                break;
+            case Field::ID:
+                out += commit->commit_id.to_hex();
+                break;
+            case Field::ABBREV_ID:
+                out += abbreviate_commit_id(commit->commit_id.to_hex());
+                break;
+            case Field::PARENTS:
+                append_parents(commit, false, out);
+                break;
+            case Field::ABBREV_PARENTS:
+                append_parents(commit, true, out);
+                break;
+            case Field::DATE: {
+                // The time from get_time_string ends with a newline
+                size_t length = commit->time.size();
+                if (length > 0 && commit->time[length - 1] == '\n')
+                    --length;
+                out.append(commit->time, 0, length);
+                break;
+            }
+            case Field::MESSAGE:
+                out += commit->message;
+                break;
+            case Field::MERGE_LINE:
+                if (commit->second_parent != nullptr) {
+                    out += "Merge: ";
+                    append_parents(commit, true, out);
+                    out += '\n';
+                }
+                break;
+        }
+    }
+}
@@ -0,0 +1,86 @@
+//
+// Rendering of commits for log and global-log. A format template is compiled once into a list
+// of literal and field segments, and the rendered commits are collected in a large buffer that
+// is written out in big chunks instead of flushing every line.
+//
+
+#ifndef COMP2012H_FA21_PA2_LOGFORMAT_H
+#define COMP2012H_FA21_PA2_LOGFORMAT_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "Commit.h"
+
+// Collects output and writes it to the stream whenever a chunk is full, and on destruction
+class OutputBuffer {
+public:
+    static constexpr size_t CHUNK_SIZE = 1 << 16;
+
+    explicit OutputBuffer(std::ostream &os);
+    ~OutputBuffer();
+
+    OutputBuffer(const OutputBuffer &) = delete;
+    OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+    std::string &buffer();      // append to this, then call maybe_flush
+    void maybe_flush();
+    void flush();
+
+private:
+    std::ostream &os;
+    std::string data;
+};
+
+class LogFormat {
+public:
+    /**
+     * Compile a format template. Supported placeholders:
+     *   %H commit id         %h abbreviated commit id
+     *   %P parent ids        %p abbreviated parent ids
+     *   %ad date             %s message
+     *   %M "Merge: <abbreviated parents>" and a newline, only for merge commits
+     *   %n newline           %% a literal '%'
+     * Anything else is copied as it is.
+     * @param format the template
+     * @return the compiled format
+     */
+    static LogFormat compile(const std::string &format);
+
+    // The format used by commit_print
+    static const LogFormat &standard();
+
+    // The standard format with the separators log and global-log put around each commit
+    static const LogFormat &log_entry();
+
+    // The standard format followed by a blank line, for log --graph
+    static const LogFormat &graph_entry();
+
+    /**
+     * Render a commit and append it to out
+     * @param commit the commit to render
+     * @param out the string to append to
+     */
+    void render(const Commit *commit, std::string &out) const;
+
+private:
+    enum class Field {LITERAL, ID, ABBREV_ID, PARENTS, ABBREV_PARENTS, DATE, MESSAGE, MERGE_LINE};
+
+    struct Segment {
+        Field field;
+        std::string literal;    // only for LITERAL
+    };
+
+    std::vector<Segment> segments;
+};
+
+// Options of the log command
+struct LogOptions {
+    bool graph = false;         // draw the history on the left, implies topo_order
+    bool topo_order = false;    // list all the ancestors, none before its children
+    bool first_parent = false;  // only follow the first parent of merges
+    std::string format;         // template given with --format, empty for the standard format
+};
+
+#endif //COMP2012H_FA21_PA2_LOGFORMAT_H
@@ -0,0 +1,154 @@
+#include <unordered_map>
+
+#include "MergePlan.h"
+#include "Rename.h"
+
+using namespace std;
+using path = std::filesystem::path;
+
+const string &MergeEntry::name() const {
+    return *filename;
+}
+
+bool MergeEntry::moved() const {
+    return current != nullptr && current->name != *filename;
+}
+
+static bool same_version(const Blob *a, const Blob *b) {
+    if (a == nullptr || b == nullptr)
+        return a == b;
+    return a->ref == b->ref;
+}
+
+static MergeAction classify(const MergeEntry &entry) {
+    bool current_modified = !same_version(entry.split, entry.current);
+    bool given_modified = !same_version(entry.split, entry.given);
+
+    if (!given_modified || same_version(entry.current, entry.given)) {
+        // Unchanged in given, or changed in the same way on both sides
+        return MergeAction::KEEP_CURRENT;
+    }
+    if (!current_modified) {
+        return entry.given ? MergeAction::TAKE_GIVEN : MergeAction::REMOVE;
+    }
+    return MergeAction::CONFLICT;
+}
+
+std::vector<MergeEntry> plan_merge(const List *split, const List *current, const List *given) {
+    vector<MergeEntry> plan;
+    Blob *s = split->head->next, *c = current->head->next, *g = given->head->next;
+
+    while (s != split->head || c != current->head || g != given->head) {
+        // The smallest name among the three cursors
+        const string *name = nullptr;
+        if (s != split->head)
+            name = &s->name.str();
+        if (c != current->head && (name == nullptr || c->name < *name))
+            name = &c->name.str();
+        if (g != given->head && (name == nullptr || g->name < *name))
+            name = &g->name.str();
+
+        MergeEntry entry;
+        entry.filename = name;
+        if (s != split->head && s->name == *name)
+            entry.split = s;
+        if (c != current->head && c->name == *name)
+            entry.current = c;
+        if (g != given->head && g->name == *name)
+            entry.given = g;
+
+        // Advance after comparing, as name may point into one of the cursors
+        if (entry.split)
+            s = s->next;
+        if (entry.current)
+            c = c->next;
+        if (entry.given)
+            g = g->next;
+
+        entry.action = classify(entry);
+        plan.push_back(entry);
+    }
+    return plan;
+}
+
+std::vector<MergeEntry> plan_merge(TreeStore &store, const ObjectId &split, const ObjectId &current,
+                                   const ObjectId &given, std::deque<Blob> &blobs) {
+    vector<MergeEntry> plan;
+    walk_merge_trees(store, split, current, given, [&](const string &name, const ObjectId &split_ref,
+                                                       const ObjectId &current_ref, const ObjectId &given_ref) {
+        InternedString interned(name);
+        auto make_blob = [&](const ObjectId &ref) -> const Blob * {
+            if (ref.is_null())
+                return nullptr;
+            Blob &blob = blobs.emplace_back();
+            blob.name = interned;
+            blob.ref = ref;
+            return &blob;
+        };
+
+        MergeEntry entry;
+        entry.split = make_blob(split_ref);
+        entry.current = make_blob(current_ref);
+        entry.given = make_blob(given_ref);
+        entry.filename = &interned.str();   // interned strings live as long as the pool
+        entry.action = classify(entry);
+        plan.push_back(entry);
+    });
+    return plan;
+}
+
+static RenameCandidate to_candidate(const Blob *blob, const path &blobs_dir) {
+    return {blob->name, blob->ref, blobs_dir / path(blob->ref.to_hex())};
+}
+
+// Pairs of (old entry, new entry) for the files renamed on one side
+static vector<pair<size_t, size_t>> renamed_entries(const vector<MergeEntry> &plan, const path &blobs_dir,
+                                                    const Blob *MergeEntry::*side) {
+    vector<RenameCandidate> deleted, added;
+    unordered_map<string, size_t> positions;
+    for (size_t i = 0; i < plan.size(); ++i) {
+        const MergeEntry &entry = plan[i];
+        if (entry.split && !(entry.*side)) {
+            deleted.push_back(to_candidate(entry.split, blobs_dir));
+        } else if (!entry.split && entry.*side) {
+            added.push_back(to_candidate(entry.*side, blobs_dir));
+        } else {
+            continue;
+        }
+        positions[entry.name()] = i;
+    }
+
+    vector<pair<size_t, size_t>> result;
+    if (deleted.empty() || added.empty())
+        return result;
+    for (auto &rename : detect_renames(deleted, added)) {
+        if (!rename.copy)
+            result.emplace_back(positions[rename.old_name], positions[rename.new_name]);
+    }
+    return result;
+}
+
+void follow_renames(std::vector<MergeEntry> &plan, const std::filesystem::path &blobs_dir) {
+    // Renamed in the current commit, still present in the given one: the given changes follow the file
+    for (auto &rename : renamed_entries(plan, blobs_dir, &MergeEntry::current)) {
+        MergeEntry &old_entry = plan[rename.first], &new_entry = plan[rename.second];
+        if (old_entry.given == nullptr || new_entry.given != nullptr)
+            continue;
+        new_entry.split = old_entry.split;
+        new_entry.given = old_entry.given;
+        new_entry.action = classify(new_entry);
+        old_entry.given = nullptr;
+        old_entry.action = MergeAction::KEEP_CURRENT;
+    }
+
+    // Renamed in the given commit, still present in the current one: the current version moves
+    for (auto &rename : renamed_entries(plan, blobs_dir, &MergeEntry::given)) {
+        MergeEntry &old_entry = plan[rename.first], &new_entry = plan[rename.second];
+        if (old_entry.current == nullptr || new_entry.current != nullptr)
+            continue;
+        new_entry.split = old_entry.split;
+        new_entry.current = old_entry.current;
+        new_entry.action = classify(new_entry);
+        old_entry.action = MergeAction::REMOVE;
+    }
+}
@@ -0,0 +1,70 @@
+//
+// Merge planner. Joins the files of the split point, the current commit and the given commit
+// into a single sorted view and decides what merge should do with each file.
+//
+
+#ifndef COMP2012H_FA21_PA2_MERGEPLAN_H
+#define COMP2012H_FA21_PA2_MERGEPLAN_H
+
+#include <deque>
+#include <vector>
+#include <filesystem>
+
+#include "Commit.h"
+#include "Tree.h"
+
+enum class MergeAction {
+    KEEP_CURRENT,   // leave the file as it is in the current commit
+    TAKE_GIVEN,     // check out and stage the version in the given commit
+    REMOVE,         // remove and untrack the file
+    CONFLICT        // modified differently in the current and given commits
+};
+
+// One file of the joined view. A nullptr blob means the file is absent in that commit.
+// After following renames, the blobs may carry the name the file had on that side.
+struct MergeEntry {
+    const Blob *split = nullptr;
+    const Blob *current = nullptr;
+    const Blob *given = nullptr;
+    MergeAction action = MergeAction::KEEP_CURRENT;
+    const string *filename = nullptr;
+
+    const string &name() const;
+
+    // Whether the current version lives under another name in the working directory
+    bool moved() const;
+};
+
+/**
+ * Join the three lists of tracked files by filename in a single pass and classify every file.
+ * All three lists must be sorted by name, which list_put guarantees.
+ * @param split files tracked in the split point
+ * @param current files tracked in the current commit
+ * @param given files tracked in the given commit
+ * @return one entry for every file tracked in any of the commits, sorted by name
+ */
+std::vector<MergeEntry> plan_merge(const List *split, const List *current, const List *given);
+
+/**
+ * Classify the files of three trees, leaving out every subtree and file that is the same in the
+ * current and the given tree; the files left out are all kept as they are in the current commit.
+ * @param store the store holding the trees
+ * @param split root tree of the split point
+ * @param current root tree of the current commit
+ * @param given root tree of the given commit
+ * @param blobs holds the blobs the entries point to, must outlive the plan
+ * @return one entry for every file that differs between the current and the given tree, sorted by name
+ */
+std::vector<MergeEntry> plan_merge(TreeStore &store, const ObjectId &split, const ObjectId &current,
+                                   const ObjectId &given, std::deque<Blob> &blobs);
+
+/**
+ * Follow files renamed on either side since the split point, so that changes made to a file
+ * on one side are merged into it under the name given by the other side.
+ * Renamed files are detected by content, with the blobs read from blobs_dir.
+ * @param plan the plan returned by plan_merge, updated in place
+ * @param blobs_dir directory of the blobs, i.e. .gitlite/blobs
+ */
+void follow_renames(std::vector<MergeEntry> &plan, const std::filesystem::path &blobs_dir);
+
+#endif //COMP2012H_FA21_PA2_MERGEPLAN_H
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/vector.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/unordered_map.hpp>
+
+#include "MessageIndex.h"
+
+using namespace std;
+
+static uint32_t trigram(const string &str, size_t pos) {
+    return static_cast<unsigned char>(str[pos]) << 16 | static_cast<unsigned char>(str[pos + 1]) << 8
+           | static_cast<unsigned char>(str[pos + 2]);
+}
+
+// Collect runs of characters that every match of the pattern must contain. Only the parts of the
+// pattern outside of groups are looked at, and alternatives make every run optional, so a run is
+// ended by anything that is not a plain character.
+static vector<string> required_literals(const string &pattern) {
+    vector<string> literals;
+    if (pattern.find('|') != string::npos) {
+        return literals;
+    }
+
+    string run;
+    auto end_run = [&]() {
+        if (run.size() >= 3)
+            literals.push_back(run);
+        run.clear();
+    };
+
+    int depth = 0;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        char c = pattern[i];
+        if (c == '*' || c == '?' || c == '{') {
+            if (!run.empty())
+                run.pop_back();     // the previous character may not be there at all
+            end_run();
+            if (c == '{')
+                i = min(pattern.find('}', i), pattern.size());
+        } else if (c == '+') {
+            end_run();
+        } else if (c == '(') {
+            end_run();
+            ++depth;
+        } else if (c == ')') {
+            depth = max(depth - 1, 0);
+        } else if (c == '[') {
+            end_run();
+            size_t close = pattern.find(']', i + 2);    // a ']' right after '[' is part of the set
+            i = close == string::npos ? pattern.size() : close;
+        } else if (c == '.' || c == '^' || c == '$') {
+            end_run();
+        } else if (c == '\\' && i + 1 < pattern.size()) {
+            char escaped = pattern[++i];
+            if (depth == 0 && ispunct(static_cast<unsigned char>(escaped))) {
+                run += escaped;
+            } else {
+                end_run();      // character classes such as \d, or escapes we do not interpret
+            }
+        } else if (depth == 0) {
+            run += c;
+        }
+    }
+    end_run();
+    return literals;
+}
+
+void MessageIndex::add(const std::string &commit_id, const std::string &message) {
+    auto position = static_cast<uint32_t>(commit_ids.size());
+    commit_ids.push_back(commit_id);
+    messages.push_back(message);
+    by_message[message].push_back(position);
+    for (size_t i = 0; i + 3 <= message.size(); ++i) {
+        auto &postings = by_trigram[trigram(message, i)];
+        if (postings.empty() || postings.back() != position)
+            postings.push_back(position);
+    }
+}
+
+std::vector<std::string> MessageIndex::find(const std::string &message) const {
+    vector<string> result;
+    auto iter = by_message.find(message);
+    if (iter != by_message.end()) {
+        for (uint32_t position : iter->second) {
+            result.push_back(commit_ids[position]);
+        }
+    }
+    return result;
+}
+
+// Positions of the messages containing every trigram the pattern requires
+std::vector<uint32_t> MessageIndex::candidates(const std::string &pattern) const {
+    vector<uint32_t> keys;
+    for (auto &literal : required_literals(pattern)) {
+        for (size_t i = 0; i + 3 <= literal.size(); ++i) {
+            keys.push_back(trigram(literal, i));
+        }
+    }
+
+    vector<uint32_t> result;
+    if (keys.empty()) {
+        result.resize(commit_ids.size());
+        iota(result.begin(), result.end(), 0);
+        return result;
+    }
+
+    // Intersect starting from the shortest posting list
+    vector<const vector<uint32_t> *> lists;
+    for (uint32_t key : keys) {
+        auto iter = by_trigram.find(key);
+        if (iter == by_trigram.end())
+            return result;
+        lists.push_back(&iter->second);
+    }
+    sort(lists.begin(), lists.end(), [](auto *a, auto *b) { return a->size() < b->size(); });
+
+    result = *lists[0];
+    vector<uint32_t> next;
+    for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+        next.clear();
+        set_intersection(result.begin(), result.end(), lists[i]->begin(), lists[i]->end(), back_inserter(next));
+        result.swap(next);
+    }
+    return result;
+}
+
+std::vector<std::string> MessageIndex::grep(const std::string &pattern) const {
+    regex re(pattern);
+    vector<string> result;
+    for (uint32_t position : candidates(pattern)) {
+        if (regex_search(messages[position], re))
+            result.push_back(commit_ids[position]);
+    }
+    return result;
+}
+
+size_t MessageIndex::size() const {
+    return commit_ids.size();
+}
+
+bool MessageIndex::load(const std::filesystem::path &file) {
+    ifstream is(file, ios::in | ios::binary);
+    if (!is.is_open()) {
+        return false;
+    }
+    try {
+        cereal::BinaryInputArchive iarchive(is);
+        iarchive(*this);
+    } catch (...) {
+        *this = MessageIndex();
+        return false;
+    }
+    return true;
+}
+
+void MessageIndex::save(const std::filesystem::path &file) const {
+    ofstream os(file, ios::out | ios::binary);
+    if (!os.is_open()) {
+        throw std::invalid_argument("failed to write " + file.string());
+    }
+    cereal::BinaryOutputArchive oarchive(os);
+    oarchive(*this);
+}
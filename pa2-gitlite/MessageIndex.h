@@ -0,0 +1,65 @@
+//
+// Index of commit messages. Maps each message to the commits that have it, and each trigram
+// (three consecutive bytes) to the commits whose message contains it, so find and find --grep
+// only look at the commits that can possibly match.
+//
+
+#ifndef COMP2012H_FA21_PA2_MESSAGEINDEX_H
+#define COMP2012H_FA21_PA2_MESSAGEINDEX_H
+
+#include <string>
+#include <vector>
+#include <regex>
+#include <cstdint>
+#include <unordered_map>
+#include <filesystem>
+
+class MessageIndex {
+public:
+    /**
+     * Add a commit to the index. Each commit should only be added once.
+     * @param commit_id id of the commit
+     * @param message message of the commit
+     */
+    void add(const std::string &commit_id, const std::string &message);
+
+    /**
+     * Find the commits with exactly the given message
+     * @param message the message to look for
+     * @return ids of the matching commits, in the order they were added
+     */
+    std::vector<std::string> find(const std::string &message) const;
+
+    /**
+     * Find the commits whose message contains a match of a regular expression (ECMAScript syntax)
+     * @param pattern the regular expression
+     * @return ids of the matching commits, in the order they were added
+     * @throw std::regex_error if the pattern is invalid
+     */
+    std::vector<std::string> grep(const std::string &pattern) const;
+
+    size_t size() const;
+
+    /**
+     * Load an index written by save
+     * @param file the persisted index
+     * @return false if the file is missing or cannot be read
+     */
+    bool load(const std::filesystem::path &file);
+    void save(const std::filesystem::path &file) const;
+
+    template <class Archive>
+    void serialize(Archive &archive) {
+        archive(commit_ids, messages, by_message, by_trigram);
+    }
+
+private:
+    std::vector<uint32_t> candidates(const std::string &pattern) const;
+
+    std::vector<std::string> commit_ids;    // commits in the order they were added
+    std::vector<std::string> messages;      // message of each commit, same order
+    std::unordered_map<std::string, std::vector<uint32_t>> by_message;  // message -> positions
+    std::unordered_map<uint32_t, std::vector<uint32_t>> by_trigram;     // trigram -> sorted positions
+};
+
+#endif //COMP2012H_FA21_PA2_MESSAGEINDEX_H
@@ -0,0 +1,62 @@
+#include <cstring>
+#include <stdexcept>
+
+#include "ObjectId.h"
+
+using namespace std;
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+ObjectId ObjectId::from_hex(std::string_view hex) {
+    ObjectId id;
+    if (hex.empty())
+        return id;
+    if (hex.size() != HEX_SIZE)
+        throw std::invalid_argument("invalid object id " + string(hex));
+    for (size_t i = 0; i < SIZE; ++i) {
+        int high = hex_value(hex[i * 2]), low = hex_value(hex[i * 2 + 1]);
+        if (high < 0 || low < 0)
+            throw std::invalid_argument("invalid object id " + string(hex));
+        id.data[i] = static_cast<uint8_t>(high << 4 | low);
+    }
+    return id;
+}
+
+ObjectId ObjectId::from_digest(const uint32_t digest[5]) {
+    ObjectId id;
+    for (size_t i = 0; i < SIZE; ++i) {
+        id.data[i] = static_cast<uint8_t>(digest[i / 4] >> (24 - i % 4 * 8));   // big-endian words
+    }
+    return id;
+}
+
+ObjectId ObjectId::from_bytes(const uint8_t *bytes) {
+    ObjectId id;
+    memcpy(id.data.data(), bytes, SIZE);
+    return id;
+}
+
+std::string ObjectId::to_hex() const {
+    if (is_null())
+        return string();
+    string hex(HEX_SIZE, '0');
+    for (size_t i = 0; i < SIZE; ++i) {
+        hex[i * 2] = HEX_DIGITS[data[i] >> 4];
+        hex[i * 2 + 1] = HEX_DIGITS[data[i] & 0xf];
+    }
+    return hex;
+}
+
+bool ObjectId::is_null() const {
+    return data == std::array<uint8_t, SIZE>{};
+}
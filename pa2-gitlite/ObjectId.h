@@ -0,0 +1,85 @@
+//
+// Fixed-size binary object id: the 20 bytes of a SHA1 digest. Persistent formats store ids this
+// way, half the size of the 40-character hex form, and read them back with a plain copy. Blobs and
+// commits hold ids in memory too; hex is only used at the boundary: file names in .gitlite, refs,
+// the text indexes, and what the user types and sees.
+//
+
+#ifndef COMP2012H_FA21_PA2_OBJECTID_H
+#define COMP2012H_FA21_PA2_OBJECTID_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <cereal/types/array.hpp>
+
+class ObjectId {
+public:
+    static constexpr size_t SIZE = 20;
+    static constexpr size_t HEX_SIZE = SIZE * 2;
+
+    ObjectId() = default;   // the null id, standing for an empty hex string
+
+    /**
+     * Convert from hex
+     * @param hex 40 hexadecimal digits, or an empty string for the null id
+     * @return the id
+     * @throw std::invalid_argument if hex is not a valid id
+     */
+    static ObjectId from_hex(std::string_view hex);
+
+    /**
+     * Convert a SHA1 digest as produced by TinySHA1
+     * @param digest the five 32-bit words of the digest
+     * @return the id
+     */
+    static ObjectId from_digest(const uint32_t digest[5]);
+
+    /**
+     * Copy an id stored as raw bytes
+     * @param bytes the 20 bytes of the id
+     * @return the id
+     */
+    static ObjectId from_bytes(const uint8_t *bytes);
+
+    /**
+     * Convert to hex
+     * @return 40 lowercase hexadecimal digits, or an empty string for the null id
+     */
+    std::string to_hex() const;
+
+    bool is_null() const;
+
+    const std::array<uint8_t, SIZE> &bytes() const { return data; }
+
+    friend bool operator==(const ObjectId &a, const ObjectId &b) { return a.data == b.data; }
+    friend bool operator!=(const ObjectId &a, const ObjectId &b) { return a.data != b.data; }
+    friend bool operator<(const ObjectId &a, const ObjectId &b) { return a.data < b.data; }
+
+    friend std::ostream &operator<<(std::ostream &os, const ObjectId &id) { return os << id.to_hex(); }
+
+    template <class Archive>
+    void serialize(Archive &archive) {
+        archive(data);      // stored as raw bytes by binary archives
+    }
+
+private:
+    std::array<uint8_t, SIZE> data{};
+};
+
+namespace std {
+    template <>
+    struct hash<ObjectId> {
+        size_t operator()(const ObjectId &id) const noexcept {
+            size_t hash;
+            memcpy(&hash, id.bytes().data(), sizeof(hash));     // already uniformly distributed
+            return hash;
+        }
+    };
+}
+
+#endif //COMP2012H_FA21_PA2_OBJECTID_H
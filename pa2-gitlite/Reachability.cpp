@@ -0,0 +1,246 @@
+#include <fstream>
+#include <queue>
+#include <unordered_set>
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/unordered_map.hpp>
+#include <cereal/types/vector.hpp>
+
+#include "Reachability.h"
+#include "Trace.h"
+
+using namespace std;
+
+static thread_local const ReachabilityIndex *registered_index = nullptr;
+
+static bool test_bit(const vector<uint64_t> &words, uint32_t position) {
+    return words[position / 64] >> position % 64 & 1;
+}
+
+// Set a bit, returning false if it was already set
+static bool set_bit(vector<uint64_t> &words, uint32_t position) {
+    uint64_t bit = uint64_t(1) << position % 64;
+    if (words[position / 64] & bit)
+        return false;
+    words[position / 64] |= bit;
+    return true;
+}
+
+bool ReachabilityIndex::update(const std::unordered_map<ObjectId, Commit *> &commits, const List *branches) {
+    TraceScope trace("update reachability", "merge");
+    bool changed = false;
+
+    // The saved commits go first, in position order, so the graph gives them the same positions
+    vector<const Commit *> ordered;
+    ordered.reserve(commits.size());
+    for (const ObjectId &id : ids) {
+        auto iter = commits.find(id);
+        if (iter == commits.end()) {
+            clear();
+            ordered.clear();
+            changed = true;
+            break;
+        }
+        ordered.push_back(iter->second);
+    }
+    size_t saved = ordered.size();
+    if (saved != commits.size()) {
+        unordered_set<const Commit *> known(ordered.begin(), ordered.end());
+        for (auto &entry : commits) {
+            if (known.count(entry.second) == 0)
+                ordered.push_back(entry.second);
+        }
+    }
+    graph = make_unique<CommitGraph>(ordered);
+    for (size_t i = 0; i < saved; ++i) {
+        if (graph->position(ordered[i]) != i) {
+            // Not saved in an order the graph keeps, start over
+            clear();
+            update(commits, branches);
+            return true;
+        }
+    }
+
+    size_t size = graph->size();
+    if (ids.size() != size) {
+        ids.clear();
+        ids.reserve(size);
+        for (uint32_t position = 0; position < size; ++position) {
+            ids.push_back(graph->commit(position)->commit_id);
+        }
+        changed = true;
+    }
+
+    // Select the branch tips and every CHECKPOINT_INTERVAL-th commit along the first parents
+    vector<bool> selected(size);
+    vector<uint32_t> depth(size);
+    for (uint32_t position = 0; position < size; ++position) {
+        const uint32_t *first_parent = graph->parents_begin(position);
+        depth[position] = first_parent != graph->parents_end(position) ? depth[*first_parent] + 1 : 0;
+        selected[position] = depth[position] % CHECKPOINT_INTERVAL == 0;
+    }
+    for (Blob *branch = branches->head->next; branch != branches->head; branch = branch->next) {
+        uint32_t position = graph->position(branch->commit);
+        if (position != CommitGraph::NONE)
+            selected[position] = true;
+    }
+
+    for (auto iter = bitmaps.begin(); iter != bitmaps.end();) {
+        if (iter->first >= size || !selected[iter->first]) {
+            iter = bitmaps.erase(iter);
+            changed = true;
+        } else {
+            ++iter;
+        }
+    }
+    // Parents come first, so every bitmap is built on the ones of its ancestors
+    for (uint32_t position = 0; position < size; ++position) {
+        if (selected[position] && bitmaps.count(position) == 0) {
+            bitmaps.emplace(position, EwahBitmap::compress(reachable(position)));
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool ReachabilityIndex::contains(const Commit *commit) const {
+    return graph != nullptr && graph->position(commit) != CommitGraph::NONE;
+}
+
+std::vector<uint64_t> ReachabilityIndex::reachable(uint32_t position) const {
+    vector<uint64_t> words((graph->size() + 63) / 64);
+    vector<uint32_t> stack{position};
+    set_bit(words, position);
+    while (!stack.empty()) {
+        uint32_t current = stack.back();
+        stack.pop_back();
+        auto bitmap = bitmaps.find(current);
+        if (bitmap != bitmaps.end()) {
+            // Its ancestors are all in the bitmap, no need to walk them
+            bitmap->second.or_into(words);
+            continue;
+        }
+        for (const uint32_t *parent = graph->parents_begin(current); parent != graph->parents_end(current); ++parent) {
+            if (set_bit(words, *parent))
+                stack.push_back(*parent);
+        }
+    }
+    return words;
+}
+
+bool ReachabilityIndex::is_ancestor(const Commit *ancestor, const Commit *descendant) const {
+    uint32_t target = graph->position(ancestor), start = graph->position(descendant);
+    if (target > start) {
+        return false;   // ancestors have smaller positions
+    }
+
+    vector<bool> visited(graph->size());
+    vector<uint32_t> stack{start};
+    visited[start] = true;
+    while (!stack.empty()) {
+        uint32_t current = stack.back();
+        stack.pop_back();
+        if (current == target)
+            return true;
+        auto bitmap = bitmaps.find(current);
+        if (bitmap != bitmaps.end()) {
+            if (bitmap->second.get(target))
+                return true;
+            continue;
+        }
+        for (const uint32_t *parent = graph->parents_begin(current); parent != graph->parents_end(current); ++parent) {
+            // Commits before the target cannot lead to it
+            if (*parent >= target && !visited[*parent]) {
+                visited[*parent] = true;
+                stack.push_back(*parent);
+            }
+        }
+    }
+    return false;
+}
+
+const Commit *ReachabilityIndex::merge_base(const Commit *c1, const Commit *c2) const {
+    vector<uint64_t> ancestors = reachable(graph->position(c1));
+
+    // Breadth-first search from c2, in the order of get_lca, the first ancestor of c1 reached is the closest
+    vector<bool> visited(graph->size());
+    queue<uint32_t> pending;
+    uint32_t start = graph->position(c2);
+    pending.push(start);
+    visited[start] = true;
+    while (!pending.empty()) {
+        uint32_t current = pending.front();
+        pending.pop();
+        if (test_bit(ancestors, current))
+            return graph->commit(current);
+        for (const uint32_t *parent = graph->parents_begin(current); parent != graph->parents_end(current); ++parent) {
+            if (!visited[*parent]) {
+                visited[*parent] = true;
+                pending.push(*parent);
+            }
+        }
+    }
+    return nullptr;
+}
+
+size_t ReachabilityIndex::bitmap_count() const {
+    return bitmaps.size();
+}
+
+bool ReachabilityIndex::load(const std::filesystem::path &file) {
+    ifstream is(file, ios::in | ios::binary);
+    if (!is.is_open()) {
+        return false;
+    }
+    try {
+        cereal::BinaryInputArchive iarchive(is);
+        iarchive(ids, bitmaps);
+    } catch (...) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+void ReachabilityIndex::save(const std::filesystem::path &file) const {
+    ofstream os(file, ios::out | ios::binary);
+    if (!os.is_open()) {
+        throw std::invalid_argument("failed to write " + file.string());
+    }
+    cereal::BinaryOutputArchive oarchive(os);
+    oarchive(ids, bitmaps);
+}
+
+void ReachabilityIndex::clear() {
+    ids.clear();
+    graph.reset();
+    bitmaps.clear();
+}
+
+bool is_ancestor(const Commit *ancestor, const Commit *descendant) {
+    if (registered_index != nullptr && registered_index->contains(ancestor) && registered_index->contains(descendant)) {
+        return registered_index->is_ancestor(ancestor, descendant);
+    }
+
+    unordered_set<const Commit *> visited;
+    vector<const Commit *> stack{descendant};
+    while (!stack.empty()) {
+        const Commit *commit = stack.back();
+        stack.pop_back();
+        if (commit == nullptr || !visited.insert(commit).second)
+            continue;
+        if (commit == ancestor)
+            return true;
+        stack.push_back(commit->parent);
+        stack.push_back(commit->second_parent);
+        stack.insert(stack.end(), commit->other_parents.begin(), commit->other_parents.end());
+    }
+    return false;
+}
+
+void set_reachability_index(const ReachabilityIndex *index) {
+    registered_index = index;
+}
+
+const ReachabilityIndex *reachability_index() {
+    return registered_index;
+}
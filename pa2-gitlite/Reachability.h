@@ -0,0 +1,97 @@
+//
+// Reachability bitmaps over the positions of a CommitGraph, persisted in .gitlite/bitmaps. Branch
+// tips and checkpoints (every CHECKPOINT_INTERVAL-th commit along each line of first parents) get
+// an EWAH bitmap of all their ancestors. A query walks from a commit only until it reaches commits
+// with bitmaps, so no walk goes much further back than one interval, and an ancestor check against
+// a commit with a bitmap is a lookup.
+// Positions are stable across runs: the index stores the commit ids in position order, and the
+// commits added since are given the positions after them.
+//
+
+#ifndef COMP2012H_FA21_PA2_REACHABILITY_H
+#define COMP2012H_FA21_PA2_REACHABILITY_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Commit.h"
+#include "CommitGraph.h"
+#include "Ewah.h"
+#include "ObjectId.h"
+
+class ReachabilityIndex {
+public:
+    static constexpr uint32_t CHECKPOINT_INTERVAL = 64;
+
+    ReachabilityIndex() = default;
+
+    /**
+     * Bring the index up to date with the commits: position the commits added since it was saved,
+     * compute the bitmaps that are missing and drop the ones no longer selected. Starts over if the
+     * saved index does not match the commits.
+     * @param commits all the commits of the repository
+     * @param branches the list of branches, whose tips get bitmaps
+     * @return true if the index changed and should be saved
+     */
+    bool update(const std::unordered_map<ObjectId, Commit *> &commits, const List *branches);
+
+    // Whether the commit is in the graph of the last update
+    bool contains(const Commit *commit) const;
+
+    /**
+     * Check whether a commit is reachable from another, e.g. a branch is contained in the current one
+     * @param ancestor a commit in the index
+     * @param descendant a commit in the index
+     * @return true if ancestor is descendant or one of its ancestors
+     */
+    bool is_ancestor(const Commit *ancestor, const Commit *descendant) const;
+
+    /**
+     * Find the latest common ancestor as get_lca does: the first ancestor of c2, in breadth-first
+     * order, that is also an ancestor of c1
+     * @param c1 a commit in the index
+     * @param c2 a commit in the index
+     * @return the common ancestor, or nullptr if there is none
+     */
+    const Commit *merge_base(const Commit *c1, const Commit *c2) const;
+
+    size_t bitmap_count() const;
+
+    /**
+     * Load an index written by save. It is only usable after update.
+     * @param file the persisted index
+     * @return false if the file is missing or cannot be read
+     */
+    bool load(const std::filesystem::path &file);
+    void save(const std::filesystem::path &file) const;
+
+private:
+    // Uncompressed bitmap of the ancestors of a position, including itself
+    std::vector<uint64_t> reachable(uint32_t position) const;
+
+    void clear();
+
+    std::vector<ObjectId> ids;      // commit ids by position
+    std::unique_ptr<CommitGraph> graph;
+    std::unordered_map<uint32_t, EwahBitmap> bitmaps;   // by position of the commit
+};
+
+/**
+ * Check whether a commit is reachable from another. Uses the index registered with
+ * set_reachability_index on the calling thread when it contains both commits, otherwise walks
+ * the history.
+ * @param ancestor the possible ancestor
+ * @param descendant the commit to start from
+ * @return true if ancestor is descendant or one of its ancestors
+ */
+bool is_ancestor(const Commit *ancestor, const Commit *descendant);
+
+void set_reachability_index(const ReachabilityIndex *index);
+
+const ReachabilityIndex *reachability_index();
+
+#endif //COMP2012H_FA21_PA2_REACHABILITY_H
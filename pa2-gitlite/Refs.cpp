@@ -0,0 +1,137 @@
+#include "Refs.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+using namespace std;
+using path = std::filesystem::path;
+
+static thread_local BranchTable *branch_table = nullptr;
+
+// Parse packed-refs into a map from branch name to commit id
+static map<string, string> read_packed_refs(const path &packed_refs) {
+    map<string, string> refs;
+    ifstream is(packed_refs, ios::in | ios::binary);
+    string line;
+    while (getline(is, line)) {
+        size_t space = line.find(' ');
+        if (space == string::npos) {
+            throw std::runtime_error("malformed line in " + packed_refs.string());
+        }
+        refs[line.substr(space + 1)] = line.substr(0, space);
+    }
+    return refs;
+}
+
+static void write_packed_refs(const path &packed_refs, const map<string, string> &refs) {
+    string content;
+    for (auto &ref : refs) {
+        content += ref.second + " " + ref.first + "\n";
+    }
+    // Write a new file and rename it, so a reader never sees a partly written packed-refs
+    path tmp = packed_refs;
+    tmp += ".lock";
+    write_content(tmp, content);
+    filesystem::rename(tmp, packed_refs);
+}
+
+vector<pair<string, string>> read_refs(const path &refs_dir, const path &packed_refs) {
+    map<string, string> refs = read_packed_refs(packed_refs);
+    for (auto &ref : filesystem::directory_iterator(refs_dir)) {
+        refs[ref.path().filename().string()] = read_content(ref.path());
+    }
+    return vector<pair<string, string>>(refs.begin(), refs.end());
+}
+
+bool delete_ref(const path &refs_dir, const path &packed_refs, const string &name) {
+    bool existed = filesystem::remove(refs_dir / path(name));
+    map<string, string> packed = read_packed_refs(packed_refs);
+    if (packed.erase(name) > 0) {
+        write_packed_refs(packed_refs, packed);
+        existed = true;
+    }
+    return existed;
+}
+
+size_t pack_refs(const path &refs_dir, const path &packed_refs) {
+    map<string, string> refs = read_packed_refs(packed_refs);
+    vector<path> loose;
+    for (auto &ref : filesystem::directory_iterator(refs_dir)) {
+        refs[ref.path().filename().string()] = read_content(ref.path());
+        loose.push_back(ref.path());
+    }
+    if (loose.empty()) {
+        return 0;
+    }
+    write_packed_refs(packed_refs, refs);
+    for (const path &ref : loose) {
+        filesystem::remove(ref);
+    }
+    return loose.size();
+}
+
+BranchTable::BranchTable(List *branches) : branches(branches) {
+    // The list is sorted, so every entry goes at the end of the map
+    for (Blob *blob = branches->head->next; blob != branches->head; blob = blob->next) {
+        table.emplace_hint(table.end(), blob->name, blob);
+    }
+}
+
+Blob *BranchTable::find(const string &name) const {
+    auto iter = table.find(name);
+    return iter == table.end() ? nullptr : iter->second;
+}
+
+Blob *BranchTable::insert(const string &name, Commit *commit) {
+    auto successor = table.lower_bound(name);
+    Blob *next = successor == table.end() ? branches->head : successor->second;
+    Blob *blob = new Blob;
+    blob->name = name;
+    blob->commit = commit;
+    blob->prev = next->prev;
+    blob->next = next;
+    next->prev->next = blob;
+    next->prev = blob;
+    table.emplace_hint(successor, name, blob);
+    return blob;
+}
+
+void BranchTable::remove(Blob *branch) {
+    table.erase(branch->name);
+    branch->prev->next = branch->next;
+    branch->next->prev = branch->prev;
+    delete branch;
+}
+
+static bool indexes(const BranchTable *table, const List *branches) {
+    return table != nullptr && table->list() == branches;
+}
+
+Blob *find_branch(const List *branches, const string &name) {
+    if (!indexes(branch_table, branches)) {
+        return list_find_name(branches, name);
+    }
+    return branch_table->find(name);
+}
+
+Blob *put_branch(List *branches, const string &name, Commit *commit) {
+    if (!indexes(branch_table, branches)) {
+        return list_put(branches, name, commit);
+    }
+    return branch_table->insert(name, commit);
+}
+
+void erase_branch(List *branches, Blob *branch) {
+    if (!indexes(branch_table, branches)) {
+        list_remove(branches, branch->name);
+    } else {
+        branch_table->remove(branch);
+    }
+}
+
+void set_branch_table(BranchTable *table) {
+    branch_table = table;
+}
@@ -0,0 +1,92 @@
+//
+// Storage of the branch references. Each update writes a loose ref, .gitlite/refs/<branch>, and
+// pack-refs moves all of them into the single file .gitlite/packed-refs, one "<commit id> <branch>"
+// per line, so repositories with many branches are loaded with one read. Loose refs take precedence.
+//
+
+#ifndef COMP2012H_FA21_PA2_REFS_H
+#define COMP2012H_FA21_PA2_REFS_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <filesystem>
+#include <map>
+
+#include "Commit.h"
+
+/**
+ * Read all the branch references
+ * @param refs_dir the directory of the loose refs
+ * @param packed_refs the packed-refs file, which may not exist
+ * @return pairs of branch name and commit id, sorted by branch name
+ */
+std::vector<std::pair<std::string, std::string>> read_refs(const std::filesystem::path &refs_dir,
+                                                           const std::filesystem::path &packed_refs);
+
+/**
+ * Delete a branch reference, both the loose ref and the line in packed-refs
+ * @param refs_dir the directory of the loose refs
+ * @param packed_refs the packed-refs file, which may not exist
+ * @param name the branch name
+ * @return true if the reference existed
+ */
+bool delete_ref(const std::filesystem::path &refs_dir, const std::filesystem::path &packed_refs,
+                const std::string &name);
+
+/**
+ * Move all the loose refs into packed-refs
+ * @param refs_dir the directory of the loose refs
+ * @param packed_refs the packed-refs file, which may not exist
+ * @return the number of loose refs that were packed
+ */
+size_t pack_refs(const std::filesystem::path &refs_dir, const std::filesystem::path &packed_refs);
+
+// Ordered index from branch name to the blob in the list of branches. The list stays sorted by
+// name: a new branch is linked in front of its successor in the index, so adding or removing a
+// branch takes a logarithmic lookup instead of a walk along the list.
+class BranchTable {
+public:
+    BranchTable() = default;
+    explicit BranchTable(List *branches);
+
+    const List *list() const { return branches; }
+
+    Blob *find(const std::string &name) const;
+    Blob *insert(const std::string &name, Commit *commit);
+    void remove(Blob *branch);
+
+private:
+    List *branches = nullptr;
+    std::map<std::string, Blob *> table;
+};
+
+/**
+ * Find a branch by name. Uses the table registered with set_branch_table on the calling thread
+ * when it indexes the given list, otherwise scans the list.
+ * @param branches the list of branches
+ * @param name the branch name
+ * @return the branch, or nullptr if there is no branch with that name
+ */
+Blob *find_branch(const List *branches, const std::string &name);
+
+/**
+ * Add a branch that does not exist yet, keeping the list sorted by name. Goes through the
+ * registered table like find_branch, otherwise falls back to list_put.
+ * @param branches the list of branches
+ * @param name the branch name
+ * @param commit the commit the branch points to
+ * @return the new branch
+ */
+Blob *put_branch(List *branches, const std::string &name, Commit *commit);
+
+/**
+ * Unlink and free a branch found in the list, through the registered table like find_branch
+ * @param branches the list of branches
+ * @param branch the branch to remove
+ */
+void erase_branch(List *branches, Blob *branch);
+
+void set_branch_table(BranchTable *table);
+
+#endif //COMP2012H_FA21_PA2_REFS_H
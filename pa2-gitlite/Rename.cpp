@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+#include "Rename.h"
+#include "Diff.h"
+
+using namespace std;
+
+// Content is cut into chunks at line ends, or every 64 bytes for long lines and binary files
+static const size_t MAX_CHUNK_SIZE = 64;
+
+namespace {
+
+// Multiset of chunk hashes of a file, with the number of bytes covered by each hash
+struct Fingerprint {
+    vector<pair<size_t, size_t>> chunks;    // (hash, bytes), sorted by hash
+    size_t size = 0;
+};
+
+Fingerprint fingerprint(const std::filesystem::path &file) {
+    MappedFile content(file);
+    string_view view = content.view();
+    unordered_map<size_t, size_t> chunks;
+    hash<string_view> hasher;
+
+    size_t start = 0;
+    while (start < view.size()) {
+        size_t end = min(view.size(), start + MAX_CHUNK_SIZE);
+        size_t newline = view.substr(start, end - start).find('\n');
+        if (newline != string_view::npos)
+            end = start + newline + 1;
+        chunks[hasher(view.substr(start, end - start))] += end - start;
+        start = end;
+    }
+
+    Fingerprint result;
+    result.chunks.assign(chunks.begin(), chunks.end());
+    sort(result.chunks.begin(), result.chunks.end());
+    result.size = view.size();
+    return result;
+}
+
+struct Match {
+    int score;
+    size_t source, target;
+
+    bool operator<(const Match &other) const {
+        if (score != other.score)
+            return score > other.score;
+        return make_pair(target, source) < make_pair(other.target, other.source);
+    }
+};
+
+} // namespace
+
+std::vector<RenamePair> detect_renames(const std::vector<RenameCandidate> &deleted,
+                                       const std::vector<RenameCandidate> &added,
+                                       const std::vector<RenameCandidate> &existing,
+                                       int min_similarity) {
+    // Sources are the deleted files followed by the existing ones
+    vector<const RenameCandidate *> sources;
+    for (auto &candidate : deleted)
+        sources.push_back(&candidate);
+    for (auto &candidate : existing)
+        sources.push_back(&candidate);
+
+    vector<Match> matches;
+    vector<char> paired(added.size(), 0);
+
+    // Exact matches by content hash
+    unordered_map<ObjectId, vector<size_t>> by_ref;
+    for (size_t s = 0; s < sources.size(); ++s) {
+        by_ref[sources[s]->ref].push_back(s);
+    }
+    for (size_t t = 0; t < added.size(); ++t) {
+        auto iter = by_ref.find(added[t].ref);
+        if (iter != by_ref.end()) {
+            for (size_t s : iter->second)
+                matches.push_back({100, s, t});
+            paired[t] = 1;
+        }
+    }
+
+    // Similarity of the rest through an inverted index: chunk hash -> (source, bytes)
+    bool any_unpaired = find(paired.begin(), paired.end(), 0) != paired.end();
+    if (any_unpaired) {
+        vector<Fingerprint> source_prints;
+        unordered_map<size_t, vector<pair<size_t, size_t>>> index;
+        for (size_t s = 0; s < sources.size(); ++s) {
+            source_prints.push_back(fingerprint(sources[s]->file));
+            for (auto &chunk : source_prints.back().chunks)
+                index[chunk.first].emplace_back(s, chunk.second);
+        }
+
+        vector<size_t> common(sources.size(), 0);
+        vector<size_t> touched;
+        for (size_t t = 0; t < added.size(); ++t) {
+            if (paired[t])
+                continue;
+            Fingerprint target = fingerprint(added[t].file);
+            for (auto &chunk : target.chunks) {
+                auto iter = index.find(chunk.first);
+                if (iter == index.end())
+                    continue;
+                for (auto &posting : iter->second) {
+                    if (common[posting.first] == 0)
+                        touched.push_back(posting.first);
+                    common[posting.first] += min(posting.second, chunk.second);
+                }
+            }
+            for (size_t s : touched) {
+                size_t max_size = max(source_prints[s].size, target.size);
+                int score = max_size == 0 ? 100 : static_cast<int>(common[s] * 100 / max_size);
+                if (score >= min_similarity)
+                    matches.push_back({score, s, t});
+                common[s] = 0;
+            }
+            touched.clear();
+        }
+    }
+
+    // Best pairs first; each added file takes one source, each deleted file is renamed only once
+    sort(matches.begin(), matches.end());
+    vector<char> target_taken(added.size(), 0), source_renamed(sources.size(), 0);
+    vector<RenamePair> result;
+    for (auto &match : matches) {
+        if (target_taken[match.target])
+            continue;
+        target_taken[match.target] = 1;
+        bool copy = match.source >= deleted.size() || source_renamed[match.source];
+        source_renamed[match.source] = 1;
+        result.push_back({sources[match.source]->name, added[match.target].name, match.score, copy});
+    }
+
+    sort(result.begin(), result.end(), [](const RenamePair &a, const RenamePair &b) {
+        return a.new_name < b.new_name;
+    });
+    return result;
+}
@@ -0,0 +1,45 @@
+//
+// Rename and copy detection. Pairs files that disappeared (or still exist) with files that
+// appeared, first by identical content and then by content similarity.
+//
+
+#ifndef COMP2012H_FA21_PA2_RENAME_H
+#define COMP2012H_FA21_PA2_RENAME_H
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "ObjectId.h"
+
+// A file taking part in rename detection
+struct RenameCandidate {
+    std::string name;
+    ObjectId ref;                   // SHA1 of the content, used for exact matches
+    std::filesystem::path file;     // where the content can be read
+};
+
+struct RenamePair {
+    std::string old_name;
+    std::string new_name;
+    int similarity;     // percentage of the content shared by both files
+    bool copy;          // the old file still exists (or was already taken by another rename)
+};
+
+/**
+ * Detect renames from deleted files and copies from existing files into added files.
+ * Exact matches by ref are found first; the remaining files are compared by chunk fingerprints
+ * through an inverted index, so only pairs sharing some content are ever scored.
+ * Every added file is paired at most once; every deleted file is the source of at most one rename.
+ * @param deleted files that no longer exist
+ * @param added files that did not exist before
+ * @param existing unchanged files that may have been copied, can be empty
+ * @param min_similarity minimum similarity in percent for a pair to be reported
+ * @return the detected pairs, sorted by the name of the added file
+ */
+std::vector<RenamePair> detect_renames(const std::vector<RenameCandidate> &deleted,
+                                       const std::vector<RenameCandidate> &added,
+                                       const std::vector<RenameCandidate> &existing = {},
+                                       int min_similarity = 50);
+
+#endif //COMP2012H_FA21_PA2_RENAME_H
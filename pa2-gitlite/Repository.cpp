@@ -2,119 +2,130 @@
 // You don't need to modify any part of this file.
 //
 
+#include <algorithm>
 #include <fstream>
+#include <map>
 #include <unordered_set>
 #include <regex>
 
 #include "Repository.h"
 #include "Utils.h"
 #include "gitlite.h"
+#include "Tree.h"
+#include "FsMonitor.h"
+#include "TimeIndex.h"
+#include "CommitGraph.h"
+#include "CommitFile.h"
+#include "CommitLoader.h"
+#include "Refs.h"
+#include "Trace.h"
 
 using namespace std;
 
 using path = std::filesystem::path;
-const path Repository::CWD = filesystem::current_path();
-const path Repository::GITLITE = Repository::CWD / path(".gitlite");
-const path Repository::REFS = Repository::GITLITE / path("refs");
-const path Repository::INDEX = Repository::GITLITE / path("index");
-const path Repository::COMMITS = Repository::GITLITE / path("commits");
-const path Repository::BLOBS = Repository::GITLITE / path("blobs");
-const path Repository::HEAD = Repository::GITLITE / path("HEAD");
-const path Repository::TREE = Repository::GITLITE / path("TREE");
-const path Repository::STAGE = Repository::GITLITE / path("STAGE");
-
-std::unordered_map<std::string, Commit *> Repository::commits;
-
-Commit *Repository::head_commit = nullptr;
-List *Repository::tracked_files = nullptr;
-List *Repository::branches = nullptr;
-List *Repository::staged_files = nullptr;
-Blob *Repository::current_branch = nullptr;
+
+Repository::Repository(const path &root)
+        : CWD(root),
+          GITLITE(CWD / path(".gitlite")),
+          REFS(GITLITE / path("refs")),
+          INDEX(GITLITE / path("index")),
+          COMMITS(GITLITE / path("commits")),
+          BLOBS(GITLITE / path("blobs")),
+          HEAD(GITLITE / path("HEAD")),
+          TREE(GITLITE / path("TREE")),
+          STAGE(GITLITE / path("STAGE")),
+          COMMIT_IDS(GITLITE / path("COMMIT_IDS")),
+          MESSAGES(GITLITE / path("MESSAGES")),
+          TIMES(GITLITE / path("TIMES")),
+          IGNORE(CWD / path(".gitliteignore")),
+          FSMONITOR(GITLITE / path("fsmonitor")),
+          PACKED_REFS(GITLITE / path("packed-refs")),
+          BITMAPS(GITLITE / path("bitmaps")),
+          TREES(GITLITE / path("trees")),
+          trees(TREES) {}
 
 void Repository::make_file_structure() {
     if (!filesystem::create_directories(GITLITE))
         throw std::runtime_error("failed to create .gitlite directory");
     if (!filesystem::create_directories(REFS) || !filesystem::create_directories(INDEX)
-        || !filesystem::create_directories(COMMITS) || !filesystem::create_directories(BLOBS))
+        || !filesystem::create_directories(COMMITS) || !filesystem::create_directories(BLOBS)
+        || !filesystem::create_directories(TREES))
         throw std::runtime_error("failed to create file structures for Gitlite");
 }
 
 void Repository::load_repository() {
+    TraceScope trace("load_repository", "load");
     // Load list of tracked files
-    ifstream is(TREE.string(), ios::in | ios::binary);
-    if (!is.is_open()) {
-        throw std::invalid_argument("failed to read .gitlite/TREE");
-    }
-    PersistentList tree;
-
     {
-        cereal::BinaryInputArchive iarchive(is);
-        iarchive(tree);
-    }   // ensure the deserialization will finish before closing the stream
-
-    tracked_files = tree.to_list();
-    is.close();
-
-    // Load staging record
-    is.open(STAGE.string(), ios::in | ios::binary);
-    if (!is.is_open()) {
-        throw std::invalid_argument("failed to read .gitlite/STAGE");
+        TraceScope read("read TREE", "load");
+        tracked_files = read_file_list(TREE);
     }
-    PersistentList stage;
 
+    // Load staging record
     {
-        cereal::BinaryInputArchive iarchive(is);
-        iarchive(stage);
+        TraceScope read("read STAGE", "load");
+        staged_files = read_file_list(STAGE);
     }
 
-    staged_files = stage.to_list();
-    is.close();
-
-    // Reconstruct the hashmap of commits
-    unordered_map<string, pair<string, string>> parent_refs;
-    for (auto &dir : filesystem::directory_iterator(COMMITS)) {
-        if (dir.is_directory()) {
-            for (auto &commitFile : filesystem::directory_iterator(dir.path())) {
-                PersistentCommit new_commit = PersistentCommit::from_path(commitFile.path());
-                commits.insert({new_commit.commit_id, new_commit.to_commit()});
-                parent_refs.insert({new_commit.commit_id, {new_commit.parent_ref, new_commit.second_parent_ref}});
-            }
-        }
-    }
+    // Reconstruct the hashmap of commits, decoding the commit files on all cores
+    vector<LoadedCommit> loaded = load_commit_files(COMMITS);
 
     // Reconstruct the DAG of commits used in tasks
-    for (auto &entry : commits) {
-        auto parent_ref = parent_refs.find(entry.first)->second;
-        if (!parent_ref.first.empty()) {
-            entry.second->parent = commits.find(parent_ref.first)->second;
+    link_commits(loaded, commits);
+
+    // Load the indexes of the commits, rebuild them if they are out of date
+    if (!commit_ids.load(COMMIT_IDS) || commit_ids.size() != commits.size()) {
+        vector<string> ids;
+        ids.reserve(commits.size());
+        for (auto &entry : commits) {
+            ids.push_back(entry.first.to_hex());
         }
-        if (!parent_ref.second.empty()) {
-            entry.second->second_parent = commits.find(parent_ref.second)->second;
+        commit_ids = CommitIdIndex(std::move(ids));
+        indexes_changed = true;
+    }
+    if (!message_index.load(MESSAGES) || message_index.size() != commits.size()) {
+        message_index = MessageIndex();
+        for (auto &entry : commits) {
+            message_index.add(entry.first.to_hex(), entry.second->message);
         }
+        indexes_changed = true;
     }
-
-    // Load head commit
-    string current_branch_name = read_content(HEAD);
-    path branch = REFS / path(current_branch_name);
-    auto entry = commits.find(read_content(branch));
-    if (entry == commits.end()) {
-        throw std::runtime_error("failed to find the commit corresponding to HEAD");
+    TimeIndex times(TIMES);
+    if (times.size() != commits.size()) {
+        vector<pair<time_t, string>> records;
+        records.reserve(commits.size());
+        for (auto &entry : commits) {
+            records.emplace_back(parse_time_string(entry.second->time), entry.first.to_hex());
+        }
+        times.rebuild(std::move(records));
     }
-    head_commit = entry->second;
+    set_abbreviation_index(&commit_ids);
 
-    // Reconstruct the list of branches
+    // Reconstruct the list of branches from packed-refs and the loose refs. They come sorted by name,
+    // so the list is built by appending instead of a sorted insert for every branch.
     branches = list_new();
-    for (auto &ref : filesystem::directory_iterator(REFS)) {
-        string commit_id = read_content(ref.path());
-        auto iter = commits.find(commit_id);
+    for (auto &ref : read_refs(REFS, PACKED_REFS)) {
+        auto iter = commits.find(ObjectId::from_hex(ref.second));
         if (iter == commits.end()) {
             throw std::runtime_error("failed to find the commit corresponding to the head of the branch");
         }
-        list_put(branches, ref.path().filename().string(), iter->second);
+        Blob *blob = new Blob;
+        blob->name = ref.first;
+        blob->commit = iter->second;
+        list_push_back(branches, blob);
     }
+    branch_table = BranchTable(branches);
+    set_branch_table(&branch_table);
+    set_tree_store(&trees);
 
-    // Load pointer to current branch
-    current_branch = list_find_name(branches, current_branch_name);
+    // Load pointer to current branch and head commit
+    current_branch = branch_table.find(read_content(HEAD));
+    if (current_branch == nullptr) {
+        throw std::runtime_error("failed to find the commit corresponding to HEAD");
+    }
+    head_commit = current_branch->commit;
+
+    ignore_rules = IgnoreMatcher::from_file(IGNORE);
 }
 
 bool Repository::init() {
@@ -131,10 +142,15 @@ bool Repository::init() {
     }
 
     ::init(current_branch, branches, staged_files, tracked_files, head_commit);
-    PersistentCommit(head_commit).commit();
+    branch_table = BranchTable(branches);
+    set_branch_table(&branch_table);
+    set_tree_store(&trees);
+    record_tree(head_commit);
+    PersistentCommit(head_commit).commit(COMMITS);
     write_content(HEAD, current_branch->name);
-    write_content(REFS / path(current_branch->name), current_branch->commit->commit_id);
-    commits.insert({head_commit->commit_id, head_commit});
+    write_content(REFS / path(current_branch->name.str()), current_branch->commit->commit_id.to_hex());
+    add_commit(head_commit);
+    set_abbreviation_index(&commit_ids);
     return true;
 }
 
@@ -161,10 +177,11 @@ bool Repository::add(const string &filename) {
 
 bool Repository::commit(const string &message) {
     if (::commit(message, current_branch, staged_files, tracked_files, head_commit)) {
+        record_tree(head_commit);
         PersistentCommit newCommit(head_commit);
-        newCommit.commit();
-        write_content(REFS / path(current_branch->name), newCommit.commit_id);
-        commits.insert({newCommit.commit_id, head_commit});
+        newCommit.commit(COMMITS);
+        write_content(REFS / path(current_branch->name.str()), head_commit->commit_id.to_hex());
+        add_commit(head_commit);
         flush_staged_changes();
         return true;
     }
@@ -181,34 +198,83 @@ bool Repository::remove(const string &filename) {
     return false;
 }
 
-void Repository::log() {
-    ::log(head_commit);
-}
+void Repository::log(const LogOptions &options) {
+    LogFormat format = !options.format.empty() ? LogFormat::compile(options.format + "\n")   // one line per commit
+                       : options.graph ? LogFormat::graph_entry() : LogFormat::log_entry();
+    if (!options.graph && !options.topo_order) {
+        ::log(head_commit, format);     // the first-parent history
+        return;
+    }
 
-void Repository::global_log() {
+    vector<const Commit *> all_commits;
+    all_commits.reserve(commits.size());
     for (auto &entry : commits) {
-        cout << "===" << endl;
-        commit_print(entry.second);
-        cout << endl << endl;
+        all_commits.push_back(entry.second);
+    }
+    CommitGraph graph(all_commits);
+    vector<uint32_t> order = graph.topo_order(graph.position(head_commit), options.first_parent);
+
+    OutputBuffer out(cout);
+    if (options.graph) {
+        print_graph(out, graph, order, format, options.first_parent);
+    } else {
+        for (uint32_t position : order) {
+            format.render(graph.commit(position), out.buffer());
+            out.maybe_flush();
+        }
     }
 }
 
-bool Repository::find(const string &message) {
-    bool found = false;
-    for (auto &entry : commits) {
-        if (entry.second->message == message) {
-            cout << entry.second->commit_id << endl;
-            found = true;
+// Print the commits from the newest to the oldest in the order of the time index, which is scanned
+// in constant memory; the commits themselves come from the history loaded by load_repository
+void Repository::global_log(size_t limit, std::time_t since, const LogFormat &format) {
+    OutputBuffer out(cout);
+    size_t printed = 0;
+    TimeIndex(TIMES).scan_newest_first([&](time_t time, const string &commit_id) {
+        if (printed == limit || time < since) {
+            return false;
         }
+        auto entry = commits.find(ObjectId::from_hex(commit_id));
+        if (entry != commits.end()) {
+            format.render(entry->second, out.buffer());
+            out.maybe_flush();
+            ++printed;
+        }
+        return true;
+    });
+}
+
+bool Repository::find(const string &message) {
+    vector<string> found = message_index.find(message);
+    for (auto &commit_id : found) {
+        cout << commit_id << endl;
+    }
+    if (found.empty()) {
+        cout << "Found no commit with that message." << endl;
+    }
+    return !found.empty();
+}
+
+bool Repository::find_grep(const string &pattern) {
+    vector<string> found;
+    try {
+        found = message_index.grep(pattern);
+    } catch (const std::regex_error &) {
+        cout << "Invalid pattern." << endl;
+        return false;
+    }
+    for (auto &commit_id : found) {
+        cout << commit_id << endl;
     }
-    if (!found) {
+    if (found.empty()) {
         cout << "Found no commit with that message." << endl;
     }
-    return found;
+    return !found.empty();
 }
 
 void Repository::status() {
     List *files = get_cwd_files();
+    hash_cwd_files(files);
     ::status(current_branch, branches, staged_files, tracked_files, files, head_commit);
     list_delete(files);
 }
@@ -218,8 +284,7 @@ bool Repository::checkout_file(const string &filename) {
 }
 
 bool Repository::checkout_file(const string &commit_id, const string &filename) {
-    string full_id = resolve_commit_id(commit_id);
-    auto commit = commits.find(full_id);
+    auto commit = commits.find(resolve_commit_id(commit_id));
     if (commit == commits.end()) {
         return ::checkout(filename, nullptr);
     } else {
@@ -241,8 +306,8 @@ bool Repository::checkout_branch(const string &branchName) {
 }
 
 bool Repository::branch(const string &branch_name) {
-    if (::branch(branch_name, branches, head_commit)) {
-        write_content(REFS / path(branch_name), head_commit->commit_id);
+    if (::branch(branch_name, branches, head_commit) != nullptr) {
+        write_content(REFS / path(branch_name), head_commit->commit_id.to_hex());
         return true;
     }
     return false;
@@ -250,17 +315,15 @@ bool Repository::branch(const string &branch_name) {
 
 bool Repository::remove_branch(const string &branch_name) {
     if (::remove_branch(branch_name, current_branch, branches)) {
-        path branch = REFS / path(branch_name);
-        filesystem::remove(branch);
+        delete_ref(REFS, PACKED_REFS, branch_name);
         return true;
     }
     return false;
 }
 
 bool Repository::reset(const std::string &commit_id) {
-    string full_id = resolve_commit_id(commit_id);
     List *filenames = get_cwd_files();
-    auto commit = commits.find(full_id);
+    auto commit = commits.find(resolve_commit_id(commit_id));
     if (commit == commits.end()) {
         ::reset(nullptr, current_branch, staged_files, tracked_files, filenames, head_commit);
         list_delete(filenames);
@@ -268,7 +331,7 @@ bool Repository::reset(const std::string &commit_id) {
     } else {
         if (::reset(commit->second, current_branch, staged_files, tracked_files, filenames, head_commit)) {
             clear_staging_area();
-            write_content(REFS / path(current_branch->name), head_commit->commit_id);
+            write_content(REFS / path(current_branch->name.str()), head_commit->commit_id.to_hex());
             flush_track_records();
             list_delete(filenames);
             return true;
@@ -279,19 +342,40 @@ bool Repository::reset(const std::string &commit_id) {
 }
 
 bool Repository::merge(const std::string &branch_name) {
+    return merge(vector<string>{branch_name});
+}
+
+bool Repository::merge(const std::vector<std::string> &branch_names) {
+    // Ancestor checks and merge bases come from the bitmaps, brought up to date with the commits
+    if (!reachability_loaded) {
+        reachability.load(BITMAPS);
+        reachability_loaded = true;
+    }
+    reachability_changed |= reachability.update(commits, branches);
+
     List *filenames = get_cwd_files();
     Commit *prev_head_commit = head_commit;
-    if (::merge(branch_name, current_branch, branches, staged_files, tracked_files, filenames, head_commit)) {
+    bool merged = branch_names.size() == 1
+                  ? ::merge(branch_names[0], current_branch, branches, staged_files, tracked_files, filenames, head_commit)
+                  : ::merge(branch_names, current_branch, branches, staged_files, tracked_files, filenames, head_commit);
+    if (merged) {
         write_content(HEAD, current_branch->name);
         flush_track_records();
         list_delete(filenames);
 
         if (prev_head_commit != head_commit) {
-            PersistentCommit new_commit(head_commit);
-            new_commit.commit();
-            write_content(REFS / path(current_branch->name), new_commit.commit_id);
-            commits.insert({new_commit.commit_id, head_commit});
-            flush_staged_changes();
+            path ref = REFS / path(current_branch->name.str());
+            if (commits.count(head_commit->commit_id) != 0) {
+                // A fast-forward lands on a commit that is already stored and indexed, only the ref moves
+                write_content(ref, head_commit->commit_id.to_hex());
+            } else {
+                record_tree(head_commit);
+                PersistentCommit new_commit(head_commit);
+                new_commit.commit(COMMITS);
+                write_content(ref, head_commit->commit_id.to_hex());
+                add_commit(head_commit);
+                flush_staged_changes();
+            }
         }
         return true;
     }
@@ -299,98 +383,322 @@ bool Repository::merge(const std::string &branch_name) {
     return false;
 }
 
-void Repository::flush_track_records() {
-    PersistentList tree(tracked_files);
-    ofstream os(TREE, ios::out | ios::binary);
+bool Repository::diff(const std::vector<std::string> &commit_ids, DiffAlgorithm algorithm) {
+    vector<Commit *> targets;
+    for (auto &commit_id : commit_ids) {
+        auto commit = commits.find(resolve_commit_id(commit_id));
+        if (commit == commits.end()) {
+            cout << "No commit with that id exists." << endl;
+            return false;
+        }
+        targets.push_back(commit->second);
+    }
+    if (targets.empty()) {
+        targets.push_back(head_commit);
+    }
 
-    {
-        cereal::BinaryOutputArchive oarchive(os);
-        oarchive(tree);
+    // filename -> (old version, new version), an empty path means the file does not exist on that side
+    map<string, pair<RenameCandidate, RenameCandidate>> files;
+    if (targets.size() == 2) {
+        // Commit against commit, only looking into the directories that changed
+        diff_trees(trees, trees.tree_of(targets[0]), trees.tree_of(targets[1]),
+                   [&files, this](const string &name, const ObjectId &old_ref, const ObjectId &new_ref) {
+                       if (!old_ref.is_null()) {
+                           files[name].first = {name, old_ref, BLOBS / path(old_ref.to_hex())};
+                       }
+                       if (!new_ref.is_null()) {
+                           files[name].second = {name, new_ref, BLOBS / path(new_ref.to_hex())};
+                       }
+                   });
+    } else {
+        const List *old_files = targets[0]->tracked_files;
+        for (Blob *blob = old_files->head->next; blob != old_files->head; blob = blob->next) {
+            files[blob->name].first = {blob->name, blob->ref, BLOBS / path(blob->ref.to_hex())};
+        }
+
+        // Commit against the working tree, covering files that are tracked now as well
+        for (Blob *blob = tracked_files->head->next; blob != tracked_files->head; blob = blob->next) {
+            files[blob->name];
+        }
+        for (auto &entry : files) {
+            path file = CWD / path(entry.first);
+            if (filesystem::is_regular_file(file)) {
+                entry.second.second = {entry.first, ObjectId(), file};
+            }
+        }
     }
 
-    os.close();
+    // Pair up deleted and added files by content. Modified files may be the source of copies.
+    vector<RenameCandidate> deleted, added, modified;
+    for (auto &entry : files) {
+        RenameCandidate &old_version = entry.second.first, &new_version = entry.second.second;
+        if (old_version.file.empty() && !new_version.file.empty()) {
+            if (new_version.ref.is_null()) {
+                new_version.ref = get_sha1(new_version.file);
+            }
+            added.push_back(new_version);
+        } else if (!old_version.file.empty() && new_version.file.empty()) {
+            deleted.push_back(old_version);
+        }
+    }
+    for (auto &entry : files) {
+        RenameCandidate &old_version = entry.second.first, &new_version = entry.second.second;
+        if (added.empty() || old_version.file.empty() || new_version.file.empty()) {
+            continue;
+        }
+        if (new_version.ref.is_null()) {
+            new_version.ref = get_sha1(new_version.file);
+        }
+        if (old_version.ref != new_version.ref) {
+            modified.push_back(old_version);
+        }
+    }
+    unordered_map<string, RenamePair> renamed_to;
+    unordered_set<string> renamed_from;
+    if (!added.empty() && (!deleted.empty() || !modified.empty())) {
+        for (auto &rename : detect_renames(deleted, added, modified)) {
+            if (!rename.copy) {
+                renamed_from.insert(rename.old_name);
+            }
+            renamed_to.insert({rename.new_name, rename});
+        }
+    }
+
+    for (auto &entry : files) {
+        const RenameCandidate &old_version = entry.second.first, &new_version = entry.second.second;
+        if (renamed_from.count(entry.first)) {
+            continue;
+        }
+        auto rename = renamed_to.find(entry.first);
+        if (rename != renamed_to.end()) {
+            diff_file(rename->second.old_name, entry.first, files[rename->second.old_name].first.file,
+                      new_version.file, algorithm, &rename->second);
+        } else if (old_version.ref != new_version.ref || old_version.ref.is_null()) {
+            diff_file(entry.first, entry.first, old_version.file, new_version.file, algorithm);
+        }
+    }
+    return true;
+}
+
+bool Repository::watch() {
+    return run_fsmonitor(CWD, FSMONITOR, IGNORE);
+}
+
+void Repository::pack_refs() {
+    ::pack_refs(REFS, PACKED_REFS);
 }
 
+void Repository::diff_file(const string &old_name, const string &new_name, const path &old_file,
+                           const path &new_file, DiffAlgorithm algorithm, const RenamePair *rename) {
+    if (old_file.empty() && new_file.empty()) {
+        return;
+    }
+
+    // An empty path stands for a file that does not exist on that side
+    MappedFile old_content, new_content;
+    if (!old_file.empty()) {
+        old_content = MappedFile(old_file);
+    }
+    if (!new_file.empty()) {
+        new_content = MappedFile(new_file);
+    }
+    if (rename == nullptr && !old_file.empty() && !new_file.empty() && old_content.view() == new_content.view()) {
+        return;
+    }
+
+    cout << "diff --gitlite a/" << old_name << " b/" << new_name << '\n';
+    if (rename != nullptr) {
+        const char *kind = rename->copy ? "copy" : "rename";
+        cout << "similarity index " << rename->similarity << "%\n";
+        cout << kind << " from " << old_name << '\n' << kind << " to " << new_name << '\n';
+    } else if (old_file.empty()) {
+        cout << "new file\n";
+    } else if (new_file.empty()) {
+        cout << "deleted file\n";
+    }
+    print_unified_diff(cout, old_file.empty() ? "/dev/null" : "a/" + old_name,
+                       new_file.empty() ? "/dev/null" : "b/" + new_name,
+                       old_content.view(), new_content.view(), algorithm);
+}
+
+void Repository::flush_track_records() {
+    write_file_list(TREE, tracked_files);
+}
+
+// The files in the working tree, sorted by name. The ref of a file is the hash of its content if it
+// is known from the fsmonitor snapshot, null otherwise.
 List *Repository::get_cwd_files() {
-    vector<string> filenames = regular_files_in_path(CWD);
+    vector<SnapshotFile> files;
+    snapshot_token.clear();
+    if (!get_cwd_files_from_monitor(files)) {
+        // Take the token before scanning, so changes made during the scan are seen next time
+        string token = fsmonitor_token(FSMONITOR);
+        for (auto &filename : regular_files_in_tree(CWD, &ignore_rules, string(), hidden_dirs)) {
+            files.push_back({std::move(filename), ObjectId()});
+        }
+        if (!token.empty()) {
+            save_fsmonitor_snapshot(FSMONITOR, token, files);
+            snapshot_token = token;
+        }
+    }
+
+    // Ignore patterns only apply to untracked files
+    for (Blob *blob = tracked_files->head->next; blob != tracked_files->head; blob = blob->next) {
+        if (ignore_rules.is_ignored(blob->name) && filesystem::is_regular_file(CWD / path(blob->name.str()))) {
+            files.push_back({blob->name, ObjectId()});
+        }
+    }
+
+    sort(files.begin(), files.end(), [](const SnapshotFile &a, const SnapshotFile &b) { return a.name < b.name; });
     List *tree = list_new();
-    for (auto &filename : filenames) {
-        ::list_put(tree, filename, string());
+    for (auto &file : files) {
+        Blob *blob = new Blob;
+        blob->name = file.name;
+        blob->ref = file.ref;
+        list_push_back(tree, blob);
     }
     return tree;
 }
 
-void Repository::clear_staging_area() {
-    for (auto &entry : filesystem::directory_iterator(INDEX)) {
-        if (entry.is_regular_file()) {
-            filesystem::remove(entry.path());
+// Hash the tracked files of the working tree whose hash the snapshot does not know, and keep the
+// hashes in the snapshot, so the next listing only has to hash the paths the watcher saw change
+void Repository::hash_cwd_files(List *cwd_files) {
+    bool hashed = false;
+    const Blob *tracked = tracked_files->head->next;
+    for (Blob *blob = cwd_files->head->next; blob != cwd_files->head; blob = blob->next) {
+        while (tracked != tracked_files->head && tracked->name < blob->name)
+            tracked = tracked->next;
+        if (tracked == tracked_files->head)
+            break;
+        if (tracked->name == blob->name && blob->ref.is_null()) {
+            blob->ref = get_sha1(CWD / path(blob->name.str()));
+            hashed = true;
         }
     }
-}
+    if (!hashed || snapshot_token.empty())
+        return;
 
-std::string Repository::resolve_commit_id(const string &commit_id) {
-    if (commit_id.size() < 2 || commit_id.size() > 40) {
-        return string();    // return empty string if no match
+    vector<SnapshotFile> snapshot;
+    for (Blob *blob = cwd_files->head->next; blob != cwd_files->head; blob = blob->next) {
+        if (!ignore_rules.is_ignored(blob->name))   // tracked files listed despite the patterns
+            snapshot.push_back({blob->name, blob->ref});
     }
+    save_fsmonitor_snapshot(FSMONITOR, snapshot_token, snapshot);
+}
 
-    string prefix = commit_id.substr(0, 2);
-    path dir = Repository::COMMITS / path(prefix);
-    if (!filesystem::is_directory(dir)) {
-        return string();
+// Update the snapshot of the last listing with the paths the watcher recorded since then,
+// so only those paths are looked at on disk and hashed again
+bool Repository::get_cwd_files_from_monitor(std::vector<SnapshotFile> &listing) {
+    string token, new_token;
+    vector<SnapshotFile> snapshot;
+    vector<string> changes;
+    if (!load_fsmonitor_snapshot(FSMONITOR, token, snapshot)
+        || !read_fsmonitor_changes(FSMONITOR, token, changes, new_token)) {
+        return false;
     }
-    auto candidates = regular_files_in_path(dir);
 
-    if (commit_id.size() == 2) {
-        return candidates.size() == 1 ? candidates[0] : string();
+    if (std::find(changes.begin(), changes.end(), IGNORE.filename().string()) != changes.end()) {
+        return false;   // the ignore patterns changed, every file has to be looked at again
     }
 
-    string result;
-    for (auto &candidate : candidates) {
-        auto res = mismatch(commit_id.begin(), commit_id.end(), candidate.begin());
-        if (res.first == commit_id.end()) {
-            if (!result.empty()) {
-                return string();    // multiple matches
+    // A changed path loses its hash, the others keep the one computed earlier
+    map<string, ObjectId> files;
+    for (auto &file : snapshot) {
+        files.emplace(std::move(file.name), file.ref);
+    }
+    sort(changes.begin(), changes.end());
+    changes.erase(unique(changes.begin(), changes.end()), changes.end());
+    for (auto &name : changes) {
+        // The path may have been a directory, drop everything that was below it
+        files.erase(name);
+        string prefix = name + "/";
+        files.erase(files.lower_bound(prefix), files.lower_bound(name + char('/' + 1)));
+
+        path file = CWD / path(name);
+        bool is_directory = filesystem::is_directory(file);
+        if (ignore_rules.is_ignored(name, is_directory)) {
+            continue;
+        }
+        if (is_directory) {
+            for (auto &filename : regular_files_in_tree(CWD, &ignore_rules, name, hidden_dirs)) {
+                files.emplace(filename, ObjectId());
             }
-            result = candidate;
+        } else if (filesystem::is_regular_file(file)) {
+            files.emplace(name, ObjectId());
         }
     }
-    return result;
+
+    listing.reserve(files.size());
+    for (auto &file : files) {
+        listing.push_back({file.first, file.second});
+    }
+    if (new_token != token) {
+        save_fsmonitor_snapshot(FSMONITOR, new_token, listing);
+    }
+    snapshot_token = new_token;
+    return true;
 }
 
-void Repository::close() {
-    if (!check_file_structure()) {
+void Repository::clear_staging_area() {
+    for (auto &entry : filesystem::directory_iterator(INDEX)) {
+        filesystem::remove_all(entry.path());
+    }
+}
+
+ObjectId Repository::resolve_commit_id(const string &commit_id) {
+    return ObjectId::from_hex(commit_ids.resolve(commit_id));   // the null id if no match
+}
+
+void Repository::add_commit(Commit *commit) {
+    // The indexes are append-only, so a commit must reach them only once
+    if (commits.count(commit->commit_id) != 0) {
         return;
     }
+    commits.insert({commit->commit_id, commit});
+    string hex = commit->commit_id.to_hex();
+    commit_ids.insert(hex);
+    message_index.add(hex, commit->message);
+    indexes_changed = true;
+    TimeIndex(TIMES).add(parse_time_string(commit->time), hex);
+}
 
-    // Store the list of tracked files
-    ofstream os(TREE.string(), ios::out | ios::binary);
-    if (!os.is_open()) {
-        throw std::invalid_argument("failed to write .gitlite/TREE");
+// Store the trees of a new commit and record its root, before the commit itself is written
+void Repository::record_tree(Commit *commit) {
+    commit->tree_id = trees.build(commit->tracked_files);
+    trees.save(commit->tree_id);
+}
+
+void Repository::close() {
+    if (!check_file_structure() || tracked_files == nullptr) {
+        return;
     }
-    PersistentList tree(tracked_files);
+    TraceScope trace("close", "close");
 
+    // Store the list of tracked files
     {
-        cereal::BinaryOutputArchive oarchive(os);
-        oarchive(tree);
+        TraceScope write("write TREE", "close");
+        write_file_list(TREE, tracked_files);
     }
 
-    os.close();
-
     // Store staging record
-    os.open(STAGE.string(), ios::out | ios::binary);
-    if (!os.is_open()) {
-        throw std::invalid_argument("failed to write .gitlite/STAGE");
-    }
-    PersistentList stage(staged_files);
-
     {
-        cereal::BinaryOutputArchive oarchive(os);
-        oarchive(stage);
+        TraceScope write("write STAGE", "close");
+        write_file_list(STAGE, staged_files);
     }
 
-    os.close();
+    if (indexes_changed) {
+        TraceScope save("save indexes", "close");
+        commit_ids.save(COMMIT_IDS);
+        message_index.save(MESSAGES);
+        indexes_changed = false;
+    }
+    if (reachability_changed) {
+        TraceScope save("save bitmaps", "close");
+        reachability.save(BITMAPS);
+    }
 
-    // Free all pointers
+    // Free all pointers, leaving the instance ready to load a repository again
+    TraceScope free_trace("free", "close");
     list_delete(tracked_files);
     list_delete(staged_files);
     list_delete(branches);
@@ -398,32 +706,45 @@ void Repository::close() {
         list_delete(entry.second->tracked_files);
         delete entry.second;
     }
+    head_commit = nullptr;
+    tracked_files = staged_files = branches = nullptr;
+    current_branch = nullptr;
+    branch_table = BranchTable();
+    set_branch_table(nullptr);
+    trees.clear();
+    set_tree_store(nullptr);
+    commits.clear();
+    commit_ids = CommitIdIndex();
+    set_abbreviation_index(nullptr);
+    message_index = MessageIndex();
+    reachability = ReachabilityIndex();
+    reachability_loaded = reachability_changed = false;
+    set_reachability_index(nullptr);
+    ignore_rules = IgnoreMatcher();
 }
 
-bool Repository::check_file_structure() {
+bool Repository::check_file_structure() const {
     return filesystem::is_directory(GITLITE);
 }
 
 void Repository::flush_staged_changes() {
-    for (auto &entry : filesystem::directory_iterator(INDEX)) {
+    for (auto &entry : filesystem::recursive_directory_iterator(INDEX)) {
         if (entry.is_regular_file()) {
-            string hash(get_sha1(entry.path()));
-            path file = BLOBS / path(hash);
+            path file = BLOBS / path(get_sha1(entry.path()).to_hex());
             copy_file_overwrite(entry.path(), file);
-            filesystem::remove(entry.path());
         }
     }
+    clear_staging_area();
 }
 
-// Reset all the in-memory states. Used for the tester when running multiple tests.
-void Repository::reset_states() {
-    head_commit = nullptr;
-    tracked_files = staged_files = branches = nullptr;
-    current_branch = nullptr;
-    commits.clear();
+WorkTreeScope Repository::activate() {
+    set_abbreviation_index(&commit_ids);
+    set_branch_table(&branch_table);
+    set_reachability_index(&reachability);
+    set_tree_store(&trees);
+    return WorkTreeScope(CWD);
 }
 
-
 PersistentBlob::PersistentBlob(Blob *blob) {
     // Make sure to catch wrong implementation from students
     if (blob == nullptr)
@@ -433,6 +754,8 @@ PersistentBlob::PersistentBlob(Blob *blob) {
     ref = blob->ref;
 }
 
+PersistentBlob::PersistentBlob(std::string name, const ObjectId &ref) : name(std::move(name)), ref(ref) {}
+
 Blob *PersistentBlob::to_blob() const {
     Blob *blob = new Blob;
     blob->name = name;
@@ -447,11 +770,14 @@ PersistentCommit::PersistentCommit(Commit *commit) {
     message = commit->message;
     time = commit->time;
     commit_id = commit->commit_id;
+    tree_id = commit->tree_id;
 
     if (commit->parent)
-        parent_ref = commit->parent->commit_id;
+        parent_refs.push_back(commit->parent->commit_id);
     if (commit->second_parent)
-        second_parent_ref = commit->second_parent->commit_id;
+        parent_refs.push_back(commit->second_parent->commit_id);
+    for (const Commit *other : commit->other_parents)
+        parent_refs.push_back(other->commit_id);
 
     tracked_files = PersistentList(commit->tracked_files);
 }
@@ -460,29 +786,32 @@ Commit *PersistentCommit::to_commit() const {
     auto *commit = new Commit;
     commit->message = message;
     commit->commit_id = commit_id;
+    commit->tree_id = tree_id;
     commit->time = time;
     commit->tracked_files = tracked_files.to_list();
     return commit;
 }
 
 PersistentCommit PersistentCommit::from_path(const path &path) {
-    ifstream is(path.string(), ios::in | ios::binary);
-    if (!is.is_open())
-        throw std::invalid_argument("failed to read the commit");
+    MappedFile file(path);
+    CommitView view(file.view());
     PersistentCommit commit;
-
-    {
-        cereal::BinaryInputArchive iarchive(is);
-        iarchive(commit);
-    }   // ensure the deserialization will finish before leaving the function
-
-    is.close();
+    commit.message = string(view.message());
+    commit.time = string(view.time());
+    commit.commit_id = view.commit_id();
+    commit.tree_id = view.tree_id();
+    for (size_t i = 0; i < view.parent_count(); ++i) {
+        commit.parent_refs.push_back(view.parent(i));
+    }
+    for (size_t i = 0; i < view.file_count(); ++i) {
+        commit.tracked_files.list.emplace_back(string(view.file_name(i)), view.file_ref(i));
+    }
     return commit;
 }
 
-PersistentCommit PersistentCommit::from_id(const string &commit_id) {
+PersistentCommit PersistentCommit::from_id(const path &commits_dir, const string &commit_id) {
     string prefix = commit_id.substr(0, 2);
-    path dir = Repository::COMMITS / path(prefix);
+    path dir = commits_dir / path(prefix);
     if (!filesystem::is_directory(dir))
         throw std::invalid_argument("commit " + commit_id + " does not exist in .gitlite/commits");
 
@@ -493,21 +822,24 @@ PersistentCommit PersistentCommit::from_id(const string &commit_id) {
     return from_path(file);
 }
 
-void PersistentCommit::commit() const {
-    path dir = Repository::COMMITS / path(commit_id.substr(0, 2));
+void PersistentCommit::commit(const path &commits_dir) const {
+    string hex = commit_id.to_hex();
+    path dir = commits_dir / path(hex.substr(0, 2));
     filesystem::create_directory(dir);
-    path file = dir / path(commit_id);
+    path file = dir / path(hex);
+
+    vector<pair<string_view, ObjectId>> files;
+    files.reserve(tracked_files.list.size());
+    for (const PersistentBlob &blob : tracked_files.list) {
+        files.emplace_back(blob.name, blob.ref);
+    }
+    string content = encode_commit(commit_id, tree_id, message, time, parent_refs, files);
 
     ofstream os(file, ios::out | ios::binary);
     if (!os.is_open()) {
         throw std::runtime_error("failed to open " + file.string());
     }
-
-    {
-        cereal::BinaryOutputArchive oarchive(os);
-        oarchive(*this);
-    }
-
+    os.write(content.data(), static_cast<streamsize>(content.size()));
     os.close();
 }
 
@@ -528,17 +860,103 @@ List *PersistentList::to_list() const {
     return tmp;
 }
 
+List *read_file_list(const path &file) {
+    MappedFile mapped(file);
+    FileListView view(mapped.view());
+    trace_count(TraceCounter::FILE_OPERATIONS);
+    trace_count(TraceCounter::BYTES_READ, mapped.view().size());
+
+    // Intern the names in one batch
+    vector<string_view> names;
+    names.reserve(view.file_count());
+    for (size_t i = 0; i < view.file_count(); ++i) {
+        names.push_back(view.file_name(i));
+    }
+    vector<InternedString> interned = InternedString::intern_all(names);
+
+    List *list = list_new();
+    for (size_t i = 0; i < view.file_count(); ++i) {
+        Blob *blob = new Blob;
+        blob->name = interned[i];
+        blob->ref = view.file_ref(i);
+        list_push_back(list, blob);
+    }
+    return list;
+}
+
+void write_file_list(const path &file, List *list) {
+    if (list == nullptr || list->head == nullptr)
+        throw std::runtime_error("tracked_files/tracked_files->head is nullptr");
+
+    vector<pair<string_view, ObjectId>> files;
+    for (Blob *blob = list->head->next; blob != list->head; blob = blob->next) {
+        files.emplace_back(blob->name.str(), blob->ref);
+    }
+    string content = encode_file_list(files);
+
+    ofstream os(file, ios::out | ios::binary);
+    if (!os.is_open()) {
+        throw std::invalid_argument("failed to write " + file.string());
+    }
+    os.write(content.data(), static_cast<streamsize>(content.size()));
+    os.close();
+}
+
 bool validate_args(const std::vector<std::string> &args) {
     std::string command = args[0];
-    if (command == "init" || command == "log" || command == "global-log" || command == "status") {
+    if (command == "init" || command == "status" || command == "watch" || command == "pack-refs") {
         if (args.size() != 1) {
             cout << "Incorrect operands." << endl;
             return false;
         }
         return true;
     }
-    if (command == "add" || command == "rm" || command == "find"|| command == "branch" || command == "rm-branch"
-        || command == "reset" || command == "merge") {
+    if (command == "merge") {
+        if (args.size() < 2) {
+            cout << "Incorrect operands." << endl;
+            return false;
+        }
+        return true;
+    }
+    if (command == "log") {
+        for (size_t i = 1; i < args.size(); ++i) {
+            if (args[i] == "--format" && i + 1 < args.size()) {
+                ++i;
+            } else if (args[i] != "--graph" && args[i] != "--topo-order" && args[i] != "--first-parent") {
+                cout << "Incorrect operands." << endl;
+                return false;
+            }
+        }
+        return true;
+    }
+    if (command == "global-log") {
+        // Options come in pairs: --limit <count>, --since <date> or --format <template>
+        for (size_t i = 1; i < args.size(); i += 2) {
+            bool valid = false;
+            if (i + 1 < args.size() && args[i] == "--format") {
+                valid = true;
+            } else if (i + 1 < args.size() && args[i] == "--limit") {
+                const string &count = args[i + 1];
+                valid = !count.empty() && count.size() <= 18 && count.find_first_not_of("0123456789") == string::npos;
+            } else if (i + 1 < args.size() && args[i] == "--since") {
+                valid = parse_date(args[i + 1]) != -1;
+            }
+            if (!valid) {
+                cout << "Incorrect operands." << endl;
+                return false;
+            }
+        }
+        return true;
+    }
+    if (command == "find") {
+        if (args.size() != 2 && (args.size() != 3 || args[1] != "--grep")) {
+            cout << "Incorrect operands." << endl;
+            return false;
+        }
+        return true;
+    }
+    if (command == "add" || command == "rm" || command == "branch" || command == "rm-branch"
+        || command == "reset") {
         if (args.size() != 2) {
             cout << "Incorrect operands." << endl;
             return false;
@@ -552,6 +970,13 @@ bool validate_args(const std::vector<std::string> &args) {
         }
         return true;
     }
+    if (command == "diff") {
+        if (args.size() > 4 || (args.size() == 4 && args[1] != "--histogram" && args[1] != "--myers")) {
+            cout << "Incorrect operands." << endl;
+            return false;
+        }
+        return true;
+    }
     if (command == "commit") {
         if (args.size() < 2) {
             cout << "Please enter a commit message." << endl;
@@ -574,70 +999,110 @@ bool validate_args(const std::vector<std::string> &args) {
     return false;
 }
 
-bool parse_args(const std::vector<std::string> &args) {
+bool parse_args(Repository &repository, const std::vector<std::string> &args) {
+    WorkTreeScope scope = repository.activate();
     std::string command = args[0];
+    TraceScope trace(command, "command");
     if (command == "init") {
-        return Repository::init();
+        return repository.init();
     } else {
-        if (!Repository::check_file_structure()) {
+        if (!repository.check_file_structure()) {
             std::cout << "Not in an initialized Gitlite directory." << std::endl;
             return false;
         }
         if (command == "add") {
-            return Repository::add(args[1]);
+            return repository.add(args[1]);
         }
         if (command == "commit") {
-            return Repository::commit(args[1]);
+            return repository.commit(args[1]);
         }
         if (command == "rm") {
-            return Repository::remove(args[1]);
+            return repository.remove(args[1]);
         }
         if (command == "log") {
-            Repository::log();
+            LogOptions options;
+            for (size_t i = 1; i < args.size(); ++i) {
+                if (args[i] == "--format") {
+                    options.format = args[++i];
+                } else {
+                    options.graph |= args[i] == "--graph";
+                    options.topo_order |= args[i] == "--topo-order";
+                    options.first_parent |= args[i] == "--first-parent";
+                }
+            }
+            repository.log(options);
             return true;
         }
         if (command == "global-log") {
-            Repository::global_log();
+            size_t limit = SIZE_MAX;
+            std::time_t since = std::numeric_limits<std::time_t>::min();
+            LogFormat format = LogFormat::log_entry();
+            for (size_t i = 1; i + 1 < args.size(); i += 2) {
+                if (args[i] == "--limit") {
+                    limit = std::stoull(args[i + 1]);
+                } else if (args[i] == "--since") {
+                    since = parse_date(args[i + 1]);
+                } else {
+                    format = LogFormat::compile(args[i + 1] + "\n");
+                }
+            }
+            repository.global_log(limit, since, format);
             return true;
         }
         if (command == "find") {
-            return Repository::find(args[1]);
+            return args.size() == 3 ? repository.find_grep(args[2]) : repository.find(args[1]);
         }
         if (command == "status") {
-            Repository::status();
+            repository.status();
             return true;
         }
         if (command == "checkout") {
             if (args.size() == 2) {
-                return Repository::checkout_branch(args[1]);
+                return repository.checkout_branch(args[1]);
             }
             if (args[1] == "--") {
-                return Repository::checkout_file(args[2]);
+                return repository.checkout_file(args[2]);
             }
             if (args[2] == "--") {
-                return Repository::checkout_file(args[1], args[3]);
+                return repository.checkout_file(args[1], args[3]);
             }
             std::cout << "Incorrect operands." << std::endl;
             return false;
         }
         if (command == "branch") {
-            return Repository::branch(args[1]);
+            return repository.branch(args[1]);
         }
         if (command == "rm-branch") {
-            return Repository::remove_branch(args[1]);
+            return repository.remove_branch(args[1]);
         }
         if (command == "reset") {
-            return Repository::reset(args[1]);
+            return repository.reset(args[1]);
         }
         if (command == "merge") {
-            return Repository::merge(args[1]);
+            return repository.merge(std::vector<std::string>(args.begin() + 1, args.end()));
+        }
+        if (command == "watch") {
+            return repository.watch();
+        }
+        if (command == "pack-refs") {
+            repository.pack_refs();
+            return true;
+        }
+        if (command == "diff") {
+            DiffAlgorithm algorithm = DiffAlgorithm::MYERS;
+            std::vector<std::string> commit_ids(args.begin() + 1, args.end());
+            if (!commit_ids.empty() && (commit_ids[0] == "--histogram" || commit_ids[0] == "--myers")) {
+                algorithm = commit_ids[0] == "--histogram" ? DiffAlgorithm::HISTOGRAM : DiffAlgorithm::MYERS;
+                commit_ids.erase(commit_ids.begin());
+            }
+            return repository.diff(commit_ids, algorithm);
         }
     }
     return false;
 }
 
 std::vector<std::string> split_args(std::string input) {
-    std::regex pattern(R"(("(?:\\.|[^"\\])*")|([^\s]+))");  // this captures escaped chars, but we do not actually escape them...
+    static const std::regex pattern(R"(("(?:\\.|[^"\\])*")|([^\s]+))");  // this captures escaped chars, but we do not actually escape them...
     std::vector<std::string> args;
     std::smatch match;
     while (std::regex_search(input, match, pattern)) {
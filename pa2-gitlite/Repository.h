@@ -6,13 +6,24 @@
 #define COMP2012H_FA21_PA2_REPOSITORY_H
 
 #include <string>
+#include <limits>
 #include <filesystem>
 #include <unordered_map>
-#include <cereal/archives/binary.hpp>
-#include <cereal/types/vector.hpp>
-#include <cereal/types/string.hpp>
+#include <vector>
 
 #include "Commit.h"
+#include "Diff.h"
+#include "FsMonitor.h"
+#include "Rename.h"
+#include "Ignore.h"
+#include "CommitIndex.h"
+#include "MessageIndex.h"
+#include "LogFormat.h"
+#include "ObjectId.h"
+#include "Reachability.h"
+#include "Refs.h"
+#include "Tree.h"
+#include "Utils.h"
 
 class PersistentBlob;
 class PersistentList;
@@ -20,90 +31,126 @@ class PersistentCommit;
 
 // This class works as a wrapper for all the tasks
 // It handles the persistence and part of the filesystem operations
+// Each instance is one repository, so a process can work on several of them, each from its own thread
 class Repository {
     using path = std::filesystem::path;
 
 public:
-    static const path CWD;          // current working directory
-    static const path GITLITE;      // CWD/.gitlite - main directory for Gitlite
-    static const path REFS;         // .gitlite/refs - stores branch references
-    static const path INDEX;        // .gitlite/index - stores staged files
-    static const path COMMITS;      // .gitlite/commits - stores persisted commits
-    static const path BLOBS;        // .gitlite/blobs - stores blobs from the commits
-    static const path HEAD;         // .gitlite/HEAD - stores the name of the current branch
-    static const path TREE;         // .gitlite/TREE - stores the persisted list of currently tracked files
-    static const path STAGE;        // .gitlite/STAGE - stores the persisted list of staged files, just for convenience
-
-    static void make_file_structure();
-    static void load_repository();
-    static void close();
-    static void reset_states();
-    static bool check_file_structure();
+    explicit Repository(const path &root = std::filesystem::current_path());
+
+    Repository(const Repository &) = delete;
+    Repository &operator=(const Repository &) = delete;
+
+    const path CWD;          // root of the working tree, the current working directory by default
+    const path GITLITE;      // CWD/.gitlite - main directory for Gitlite
+    const path REFS;         // .gitlite/refs - stores branch references
+    const path INDEX;        // .gitlite/index - stores staged files
+    const path COMMITS;      // .gitlite/commits - stores persisted commits
+    const path BLOBS;        // .gitlite/blobs - stores blobs from the commits
+    const path HEAD;         // .gitlite/HEAD - stores the name of the current branch
+    const path TREE;         // .gitlite/TREE - stores the persisted list of currently tracked files, see read_file_list
+    const path STAGE;        // .gitlite/STAGE - stores the persisted list of staged files, just for convenience
+    const path COMMIT_IDS;   // .gitlite/COMMIT_IDS - stores the sorted ids of all the commits
+    const path MESSAGES;     // .gitlite/MESSAGES - stores the index of commit messages
+    const path TIMES;        // .gitlite/TIMES - stores the commit ids sorted by commit time
+    const path IGNORE;       // CWD/.gitliteignore - patterns of untracked files to ignore
+    const path FSMONITOR;    // .gitlite/fsmonitor - journal of changed paths kept by the watcher
+    const path PACKED_REFS;  // .gitlite/packed-refs - branch references packed into one file
+    const path BITMAPS;      // .gitlite/bitmaps - reachability bitmaps of branch tips and checkpoints
+    const path TREES;        // .gitlite/trees - tree objects of the commits, see Tree.h
+
+    std::vector<path> hidden_dirs;   // directories left out of the working tree, e.g. the test fixtures
+
+    void make_file_structure();
+    void load_repository();
+    void close();
+    bool check_file_structure() const;
+
+    // Point the helper functions in Utils.h and the indexes used by log and merge, on the calling
+    // thread, to this repository until the returned scope ends. parse_args does this for every command.
+    WorkTreeScope activate();
 
     // Wrappers for all the tasks
-    static bool init();
-    static bool add(const std::string &filename);
-    static bool commit(const std::string &message);
-    static bool remove(const std::string &filename);
-    static void log();
-    static void global_log();        // implemented for you to facilitate debugging
-    static bool find(const std::string &message);   // implemented for you to facilitate debugging
-    static void status();
-    static bool checkout_file(const std::string &filename);
-    static bool checkout_file(const std::string &commit_id, const std::string &filename);
-    static bool checkout_branch(const std::string &branch_name);
-    static bool branch(const std::string &branch_name);
-    static bool remove_branch(const std::string &branch_name);
-    static bool reset(const std::string &commit_id);
-    static bool merge(const std::string &branch_name);
+    bool init();
+    bool add(const std::string &filename);
+    bool commit(const std::string &message);
+    bool remove(const std::string &filename);
+    void log(const LogOptions &options = LogOptions());
+    void global_log(size_t limit = SIZE_MAX, std::time_t since = std::numeric_limits<std::time_t>::min(),
+                    const LogFormat &format = LogFormat::log_entry());   // implemented for you to facilitate debugging
+    bool find(const std::string &message);   // implemented for you to facilitate debugging
+    bool find_grep(const std::string &pattern);
+    void status();
+    bool checkout_file(const std::string &filename);
+    bool checkout_file(const std::string &commit_id, const std::string &filename);
+    bool checkout_branch(const std::string &branch_name);
+    bool branch(const std::string &branch_name);
+    bool remove_branch(const std::string &branch_name);
+    bool reset(const std::string &commit_id);
+    bool merge(const std::string &branch_name);
+    bool merge(const std::vector<std::string> &branch_names);
+    bool diff(const std::vector<std::string> &commit_ids, DiffAlgorithm algorithm);
+    bool watch();
+    void pack_refs();
 
 private:
-    static void flush_track_records();
-    static void flush_staged_changes();
-    static void clear_staging_area();
-    static List *get_cwd_files();
-    static std::string resolve_commit_id(const std::string &commit_id);
-
-    static std::unordered_map<std::string, Commit *> commits;   // hashmap from commit id to pointers, used only internally
-
-    static Commit *head_commit;      // current head commit
-    static List *tracked_files;      // currently tracked files
-    static List *staged_files;       // a linked list recording the state of the staging area
-    static List *branches;           // a linked list of all the branches, the blobs has pointers to Commit
-    static Blob *current_branch;     // current branch we are on
+    void flush_track_records();
+    void flush_staged_changes();
+    void clear_staging_area();
+    List *get_cwd_files();
+    bool get_cwd_files_from_monitor(std::vector<SnapshotFile> &files);
+    void hash_cwd_files(List *cwd_files);
+    ObjectId resolve_commit_id(const std::string &commit_id);
+    void add_commit(Commit *commit);
+    void record_tree(Commit *commit);
+    void diff_file(const std::string &old_name, const std::string &new_name, const path &old_file,
+                   const path &new_file, DiffAlgorithm algorithm, const RenamePair *rename = nullptr);
+
+    std::unordered_map<ObjectId, Commit *> commits;   // hashmap from commit id to pointers, used only internally
+    CommitIdIndex commit_ids;     // sorted ids of the commits, for abbreviated ids
+    MessageIndex message_index;   // commit messages, for find
+    bool indexes_changed = false;   // commit_ids and message_index have to be written back on close
+    ReachabilityIndex reachability;     // ancestor queries of merge, loaded on the first merge
+    bool reachability_loaded = false;
+    bool reachability_changed = false;  // has to be written back on close
+
+    Commit *head_commit = nullptr;      // current head commit
+    List *tracked_files = nullptr;      // currently tracked files
+    List *staged_files = nullptr;       // a linked list recording the state of the staging area
+    List *branches = nullptr;           // a linked list of all the branches, the blobs has pointers to Commit
+    BranchTable branch_table;           // branches by name, for the lookups and updates of the branch commands
+    TreeStore trees;                    // tree objects, for comparing commits directory by directory
+    Blob *current_branch = nullptr;     // current branch we are on
+    IgnoreMatcher ignore_rules;         // compiled patterns from .gitliteignore
+    std::string snapshot_token;         // token of the fsmonitor snapshot behind the last listing, empty if none
 };
 
 // Persistent version of the Blob class
 class PersistentBlob {
+    friend class PersistentCommit;
+
 public:
     PersistentBlob() = default;
     explicit PersistentBlob(Blob *blob);
+    PersistentBlob(std::string name, const ObjectId &ref);
 
     Blob *to_blob() const;
 
-    template <class Archive>
-    void serialize(Archive &archive) {
-        archive(name, ref);
-    }
-
 private:
     std::string name;
-    std::string ref;
+    ObjectId ref;
 };
 
 // Persistent version of class List
 class PersistentList {
+    friend class PersistentCommit;
+
 public:
     PersistentList() = default;
     explicit PersistentList(List *list);
 
     List *to_list() const;
 
-    template <class Archive>
-    void serialize(Archive &archive) {
-        archive(list);
-    }
-
 private:
     std::vector<PersistentBlob> list;
 };
@@ -118,27 +165,39 @@ public:
 
     Commit *to_commit() const;
 
-    void commit() const;
-
-    template <class Archive>
-    void serialize(Archive &archive) {
-        archive(message, time, commit_id, parent_ref, second_parent_ref, tracked_files);
-    }
+    void commit(const std::filesystem::path &commits_dir) const;
 
+    // Commit files are written in the layout of CommitFile.h
     static PersistentCommit from_path(const std::filesystem::path &path);
-    static PersistentCommit from_id(const std::string &commit_id);
+    static PersistentCommit from_id(const std::filesystem::path &commits_dir, const std::string &commit_id);
 
 private:
     std::string message;
     std::string time;
-    std::string commit_id;
-    std::string parent_ref, second_parent_ref;
+    ObjectId commit_id;
+    ObjectId tree_id;
+    std::vector<ObjectId> parent_refs;      // parent, second_parent, then the other parents of an octopus merge
     PersistentList tracked_files;
 };
 
+/**
+ * Read .gitlite/TREE or .gitlite/STAGE, in the layout of CommitFile.h
+ * @param file path of the file list
+ * @return the files, in the order they were written
+ * @throw std::invalid_argument if the file cannot be read, std::runtime_error if it is corrupted
+ */
+List *read_file_list(const std::filesystem::path &file);
+
+/**
+ * Write .gitlite/TREE or .gitlite/STAGE, in the layout of CommitFile.h
+ * @param file path of the file list
+ * @param list the files to write
+ */
+void write_file_list(const std::filesystem::path &file, List *list);
+
 bool validate_args(const std::vector<std::string> &args);
 
-bool parse_args(const std::vector<std::string> &args);
+bool parse_args(Repository &repository, const std::vector<std::string> &args);
 
 std::vector<std::string> split_args(std::string input);
 
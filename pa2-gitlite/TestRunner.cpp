@@ -0,0 +1,222 @@
+#include "TestRunner.h"
+#include "Repository.h"
+#include "Tester.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using path = std::filesystem::path;
+using Clock = std::chrono::steady_clock;
+
+// Clean the testing directory for further testing
+static void clean_environment(const path &root) {
+    for (auto &entry : filesystem::directory_iterator(root)) {
+        if (entry.is_regular_file()) {
+            if (entry.path().filename() != "gitlite" && entry.path().filename() != "gitlite.exe") {
+                // Remove all the files other than the program itself
+                filesystem::remove(entry.path());
+            }
+        } else if (entry.is_directory() && entry.path().filename() == ".gitlite") {
+            // Remove the whole .gitlite directory recursively
+            filesystem::remove_all(entry.path());
+        }
+    }
+}
+
+bool run_test_file(const string &filename, bool verbose) {
+    Repository repository;
+    // A script run in place sits next to its fixtures, which must not show up in the working tree
+    repository.hidden_dirs = {repository.CWD / path("src"), (repository.CWD / path(filename)).parent_path()};
+    bool passed = true;
+    try {
+        Tester tester(filename, repository, verbose);
+        clean_environment(repository.CWD);
+        if (!tester.run()) {
+            cout << "Test FAILED" << endl;
+            passed = false;
+        }
+        repository.close();
+    } catch (const std::exception &e) {
+        cout << e.what() << endl << "Test FAILED" << endl;
+        passed = false;
+    }
+    return passed;
+}
+
+namespace {
+
+struct TestCase {
+    string name;        // the script relative to the current directory, for the report
+    path script;
+    path sandbox;       // the working directory of the test
+    path log;           // everything the test printed
+    bool passed = false;
+    string failure;     // why the test ended abnormally, e.g. the signal that killed it
+    Clock::time_point start;
+    double ms = 0;
+};
+
+}
+
+#ifndef _WIN32
+// Run the test in a child process inside its sandbox, printing to its log
+static pid_t start_test(const TestCase &test, bool verbose) {
+    cout.flush();
+    pid_t pid = fork();
+    if (pid != 0) {
+        return pid;
+    }
+
+    // The child must never return into the runner's loop, so anything it throws ends it too
+    try {
+        int fd = open(test.log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            _exit(2);
+        }
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        ::close(fd);
+        filesystem::current_path(test.sandbox);
+        bool passed = run_test_file(test.script.string(), verbose);
+        cout.flush();
+        _exit(passed ? 0 : 1);
+    } catch (...) {
+        _exit(2);
+    }
+}
+#else
+// No fork() here, so the tests take turns changing into their sandboxes
+static void run_in_process(TestCase &test, bool verbose) {
+    path original = filesystem::current_path();
+    ofstream log(test.log);
+    streambuf *original_output_buffer = cout.rdbuf(log.rdbuf());
+    filesystem::current_path(test.sandbox);
+    test.passed = run_test_file(test.script.string(), verbose);
+    filesystem::current_path(original);
+    cout.rdbuf(original_output_buffer);
+}
+#endif
+
+static void report(const TestCase &test, bool verbose) {
+    if (!test.passed || verbose) {
+        cout << read_content(test.log);
+    }
+    if (!test.failure.empty()) {
+        cout << test.failure << endl << "Test FAILED" << endl;
+    }
+    cout << (test.passed ? "PASSED " : "FAILED ") << test.name << " (" << fixed << setprecision(1) << test.ms
+         << " ms)" << endl;
+}
+
+bool run_test_dir(const path &dir, bool verbose, unsigned jobs, chrono::milliseconds timeout) {
+    vector<path> scripts;
+    for (auto &entry : filesystem::directory_iterator(dir)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".in") {
+            scripts.push_back(entry.path());
+        }
+    }
+    sort(scripts.begin(), scripts.end());
+
+    path root = filesystem::temp_directory_path()
+                / path("gitlite-tests-" + to_string(Clock::now().time_since_epoch().count()));
+    vector<TestCase> tests(scripts.size());
+    for (size_t i = 0; i < scripts.size(); ++i) {
+        tests[i].name = filesystem::relative(scripts[i]).string();
+        tests[i].script = filesystem::absolute(scripts[i]);
+        tests[i].sandbox = root / path(to_string(i));
+        tests[i].log = root / path(to_string(i) + ".log");
+        filesystem::create_directories(tests[i].sandbox);
+    }
+    if (jobs == 0) {
+        jobs = max(1u, thread::hardware_concurrency());
+    }
+
+    Clock::time_point start = Clock::now();
+#ifndef _WIN32
+    unordered_map<pid_t, size_t> running;
+    size_t next = 0;
+    while (next < tests.size() || !running.empty()) {
+        while (running.size() < jobs && next < tests.size()) {
+            tests[next].start = Clock::now();
+            pid_t pid = start_test(tests[next], verbose);
+            if (pid < 0) {
+                throw std::runtime_error("failed to start a process for " + tests[next].name);
+            }
+            running[pid] = next++;
+        }
+
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error("failed to wait for the tests");
+        }
+        if (pid == 0) {
+            // Nothing finished yet, kill the tests that ran out of time. They are reaped like the others.
+            for (auto &entry : running) {
+                TestCase &test = tests[entry.second];
+                if (test.failure.empty() && Clock::now() - test.start > timeout) {
+                    kill(entry.first, SIGKILL);
+                    test.failure = "Timed out after " + to_string(timeout.count()) + " ms";
+                }
+            }
+            this_thread::sleep_for(chrono::milliseconds(5));
+            continue;
+        }
+        auto iter = running.find(pid);
+        if (iter == running.end()) {
+            continue;
+        }
+        TestCase &test = tests[iter->second];
+        running.erase(iter);
+        test.ms = chrono::duration<double, milli>(Clock::now() - test.start).count();
+        test.passed = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if (WIFSIGNALED(status) && test.failure.empty()) {
+            test.failure = "Crashed with signal " + to_string(WTERMSIG(status));
+        } else if (WIFEXITED(status) && WEXITSTATUS(status) == 2 && test.failure.empty()) {
+            test.failure = "Aborted by an error outside the test";
+        }
+        report(test, verbose);
+    }
+#else
+    for (TestCase &test : tests) {
+        test.start = Clock::now();
+        run_in_process(test, verbose);
+        test.ms = chrono::duration<double, milli>(Clock::now() - test.start).count();
+        report(test, verbose);
+    }
+#endif
+    double total_ms = chrono::duration<double, milli>(Clock::now() - start).count();
+    filesystem::remove_all(root);
+
+    size_t passed = count_if(tests.begin(), tests.end(), [](const TestCase &test) { return test.passed; });
+    cout << endl << passed << " of " << tests.size() << " tests passed in " << fixed << setprecision(1) << total_ms
+         << " ms with " << jobs << " jobs" << endl;
+    for (const TestCase &test : tests) {
+        if (!test.passed) {
+            cout << "  FAILED " << test.name << endl;
+        }
+    }
+    if (passed == tests.size()) {
+        cout << "All tests PASSED" << endl;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,37 @@
+//
+// Runs the .in scripts of the Tester. A directory of scripts is run on a pool of worker processes,
+// each script in its own temporary directory, so tests neither share a working tree nor wipe the
+// current directory, and a test that crashes or hangs is reported as failed instead of ending the run.
+//
+
+#ifndef COMP2012H_FA21_PA2_TESTRUNNER_H
+#define COMP2012H_FA21_PA2_TESTRUNNER_H
+
+#include <chrono>
+#include <string>
+#include <filesystem>
+
+/**
+ * Run one test script in the current directory, on a fresh repository. The files left in
+ * the current directory by a previous run are removed first.
+ * @param filename the path of the script
+ * @param verbose whether to print every line of the script
+ * @return true if the test passed
+ */
+bool run_test_file(const std::string &filename, bool verbose);
+
+/**
+ * Run all the .in scripts in a directory, each in a temporary directory of its own, and print
+ * the outcome and the time of every test followed by a summary. All the tests are run even if
+ * some of them fail.
+ * @param dir the directory of the scripts
+ * @param verbose whether to print the output of the tests that passed as well
+ * @param jobs the number of tests run at once, 0 to use one per core
+ * @param timeout a test still running after this long is killed and fails (not on Windows, where
+ *                the tests run in this process)
+ * @return true if all the tests passed
+ */
+bool run_test_dir(const std::filesystem::path &dir, bool verbose, unsigned jobs = 0,
+                  std::chrono::milliseconds timeout = std::chrono::seconds(60));
+
+#endif //COMP2012H_FA21_PA2_TESTRUNNER_H
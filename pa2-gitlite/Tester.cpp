@@ -7,19 +7,18 @@
 #include <filesystem>
 #include <algorithm>
 #include <iterator>
-#include <unordered_set>
+#include <sstream>
 
 using namespace std;
 using path = std::filesystem::path;
 
-const path Tester::SRC = filesystem::current_path() / path("src");
+const path Tester::BASE = filesystem::current_path();
+const path Tester::SRC = Tester::BASE / path("src");
 
 const regex Tester::DEF_PATTERN(R"#(^D\s*([a-zA-Z_][a-zA-Z_0-9]*)\s*"(.*)"\s*$)#");
 const regex Tester::ADD_PATTERN(R"(\+\s*(\S+)\s+(\S+))");
 const regex Tester::RM_PATTERN(R"(-\s*(\S+))");
-const regex Tester::VAR_PATTERN(R"((\$\{.*?\}))");
 const regex Tester::CMD_PATTERN(R"(>\s*(.*))");
-const regex Tester::END_PATTERN(R"(<<<)");
 const regex Tester::EXIST_PATTERN(R"(E\s*(\S+))");
 const regex Tester::NE_PATTERN(R"(\*\s*(\S+))");
 const regex Tester::INC_PATTERN(R"(I\s+(\S+))");
@@ -29,31 +28,96 @@ static inline void trim(std::string &s);
 static inline std::string trim_copy(std::string s);
 static inline std::string rtrim_copy(std::string s);
 
-Tester::Tester(const std::string &filename, bool verbose) : verbose(verbose) {
+// Remove the spaces and tabs at the end of each line
+static void strip_trailing_blanks(string &text) {
+    string result;
+    result.reserve(text.size());
+    for (char ch : text) {
+        if (ch == '\n') {
+            while (!result.empty() && (result.back() == ' ' || result.back() == '\t'))
+                result.pop_back();
+        }
+        result += ch;
+    }
+    text = std::move(result);
+}
+
+// Whether the expected output has no regex syntax at all, so it can be compared as plain text
+static bool is_literal(const string &pattern) {
+    return pattern.find_first_of(R"(\^$.|?*+()[]{})") == string::npos;
+}
+
+Tester::Tester(const std::string &filename, Repository &repository, bool verbose)
+        : repository(repository), verbose(verbose) {
     ifstream is(filename);
     if (!is.is_open()) {
         throw std::runtime_error("failed to open the given test case");
     }
 
     cout << "Running test: " << filename << endl;
-    copy(istreambuf_iterator<char>(is), istreambuf_iterator<char>(), ostreambuf_iterator<char>(script));
+    program = compile(is);
     is.close();
 }
 
-bool Tester::run() {
+Tester::Template Tester::Template::parse(const std::string &line) {
+    Template result;
+    size_t position = 0;
+    while (position < line.size()) {
+        size_t start = line.find("${", position);
+        size_t end = start == string::npos ? string::npos : line.find('}', start + 2);
+        if (end == string::npos) {
+            result.pieces.push_back({false, line.substr(position)});
+            break;
+        }
+        if (start > position) {
+            result.pieces.push_back({false, line.substr(position, start - position)});
+        }
+        result.pieces.push_back({true, line.substr(start + 2, end - start - 2)});
+        position = end + 1;
+    }
+    return result;
+}
+
+// Split the script into instructions once, so running it only has to substitute the variables
+std::vector<Tester::Instruction> Tester::compile(std::istream &is) {
+    vector<Instruction> program;
     string line;
-    while (getline(script, line)) {
+    while (getline(is, line)) {
         canonicalize(line);
-        if (verbose) {
-            cout << line << endl;
-        }
         if (trim_copy(line).empty()) {
             continue;
         }
-        line = substitute(line);
-        switch (line[0]) {
+
+        Instruction instruction{line[0], line + "\n", Template::parse(line), {}};
+        if (instruction.kind == '>') {
+            while (true) {
+                string expected;
+                if (!getline(is, expected)) {
+                    throw std::runtime_error("non-terminated command (missing <<<) : " + line);
+                }
+                canonicalize(expected);
+                instruction.source += expected + "\n";
+                if (expected == "<<<") {
+                    break;
+                }
+                instruction.expected.push_back(Template::parse(expected));
+            }
+        }
+        program.push_back(std::move(instruction));
+    }
+    return program;
+}
+
+bool Tester::run() {
+    // Includes are spliced into the program as they are reached, so index rather than iterate
+    for (size_t position = 0; position < program.size(); ++position) {
+        if (verbose) {
+            cout << program[position].source;
+        }
+        string line = substitute(program[position].line);
+        switch (program[position].kind) {
             case 'I':
-                include_file(line);
+                include_file(line, position + 1);
                 break;
             case 'D':
                 add_definition(line);
@@ -73,7 +137,7 @@ bool Tester::run() {
                     return false;
                 break;
             case '>':
-                if (!run_and_check_command(line))
+                if (!run_and_check_command(program[position], line))
                     return false;
                 break;
             case '=':
@@ -88,7 +152,7 @@ bool Tester::run() {
     return true;
 }
 
-bool Tester::run_and_check_command(const std::string &input) {
+bool Tester::run_and_check_command(const Instruction &instruction, const std::string &input) {
     // Parse
     smatch match;
     if (!regex_match(input, match, CMD_PATTERN)) {
@@ -96,21 +160,12 @@ bool Tester::run_and_check_command(const std::string &input) {
     }
 
     string current_command = match[1];
-    vector<string> expected;
-    string line;
-    while (true) {
-        if (!getline(script, line)) {
-            throw std::runtime_error("non-terminated command (missing <<<) : " + input);
-        }
-        canonicalize(line);
-        if (verbose) {
-            cout << line << endl;
-        }
-        line = substitute(line);
-        if (regex_match(line, END_PATTERN)) {
-            break;
+    string expected_output;
+    for (size_t i = 0; i < instruction.expected.size(); i++) {
+        substitute(instruction.expected[i], expected_output);
+        if (i != instruction.expected.size() - 1) {
+            expected_output.append("\n");
         }
-        expected.push_back(line);
     }
 
     // Run
@@ -119,47 +174,54 @@ bool Tester::run_and_check_command(const std::string &input) {
     cout.rdbuf(output.rdbuf());
     auto args = split_args(current_command);
     if (validate_args(args)) {
-        parse_args(args);
+        parse_args(repository, args);
     }
     cout.rdbuf(original_output_buffer);
 
     // Check
     last_group.clear();
-    string expected_output;
     string actual(std::istreambuf_iterator<char>(output), {});
 
     // Remove extra whitespaces at the end of each line
     canonicalize(actual);
-    actual = regex_replace(actual, regex(R"([ \t]+\n)"), "\n");
+    strip_trailing_blanks(actual);
+    strip_trailing_blanks(expected_output);
 
-    for (unsigned int i = 0; i < expected.size(); i++) {
-        expected_output.append(expected[i]);
-        if (i != expected.size() - 1) {
-            expected_output.append("\n");
-        }
+    if (!match_output(actual, expected_output)) {
+        cout << "Wrong output for command: " << current_command << endl;
+        cout << "Expected: " << endl << expected_output << endl << endl;
+        cout << "Actual: " << endl << actual << endl;
+        return false;
     }
+    return true;
+}
 
-    canonicalize(expected_output);
-    expected_output = regex_replace(expected_output, regex(R"([ \t]+\n)"), "\n");
+// Match the whole output, or failing that the output without the blank lines at the end, and keep
+// the groups captured by the expected output. Expected outputs without any regex syntax are compared
+// as text, the others are compiled only once.
+bool Tester::match_output(const std::string &actual, const std::string &expected) {
+    if (is_literal(expected)) {
+        return actual == expected || rtrim_copy(actual) == rtrim_copy(expected);
+    }
 
-    if (regex_match(actual, match, regex(expected_output))) {
-        for (unsigned int i = 1; i < match.size(); i++) {
-            last_group.insert({to_string(i), match[i].str()});
+    auto compiled = [this](const string &pattern) -> const regex & {
+        auto iter = patterns.find(pattern);
+        if (iter == patterns.end()) {
+            iter = patterns.emplace(pattern, regex(pattern)).first;
         }
-    } else {
-        string trimmed_actual(rtrim_copy(actual));
-        string trimmed_expected(rtrim_copy(expected_output));
-        if (regex_match(trimmed_actual, match, regex(trimmed_expected))) {
-            for (unsigned int i = 1; i < match.size(); i++) {
-                last_group.insert({to_string(i), match[i].str()});
-            }
-        } else {
-            cout << "Wrong output for command: " << current_command << endl;
-            cout << "Expected: " << endl << expected_output << endl << endl;
-            cout << "Actual: " << endl << actual << endl;
+        return iter->second;
+    };
+    smatch match;
+    string trimmed_actual;
+    if (!regex_match(actual, match, compiled(expected))) {
+        trimmed_actual = rtrim_copy(actual);
+        if (!regex_match(trimmed_actual, match, compiled(rtrim_copy(expected)))) {
             return false;
         }
     }
+    for (unsigned int i = 1; i < match.size(); i++) {
+        last_group.insert({to_string(i), Template::parse(match[i].str())});
+    }
     return true;
 }
 
@@ -168,32 +230,32 @@ void Tester::add_definition(const std::string &input) {
     if (!regex_match(input, results, DEF_PATTERN)) {
         throw std::runtime_error("bad format: " + input);
     }
-    defs.insert({results[1], results[2]});
+    defs.insert({results[1], Template::parse(results[2])});
 }
 
-std::string Tester::substitute_once(const std::string &raw) {
-    unordered_set<std::string> variables;
-    // Find all the variables
-    for (auto iter = sregex_iterator(raw.begin(), raw.end(), VAR_PATTERN); iter != sregex_iterator(); ++iter) {
-        variables.insert((*iter)[1].str());
-    }
-
-    string substituted(raw);
-    for (auto &var : variables) {
-        // Replace each variable with corresponding definition
-        string varname = var.substr(2, var.length() - 3);
-        string result;
-        auto iter = last_group.find(varname);
+void Tester::substitute(const Template &line, std::string &result, int depth) const {
+    for (const Template::Piece &piece : line.pieces) {
+        if (!piece.variable) {
+            result += piece.text;
+            continue;
+        }
+        // The groups captured by the last command take precedence over the definitions
+        auto iter = last_group.find(piece.text);
         if (iter == last_group.end()) {
-            iter = defs.find(varname);
-            if (iter == defs.end()) {
-                continue;
-            }
+            iter = defs.find(piece.text);
+        }
+        if (iter == defs.end() || depth == MAX_SUBSTITUTION_DEPTH) {
+            result += "${" + piece.text + "}";
+        } else {
+            substitute(iter->second, result, depth + 1);
         }
-        regex pattern(R"(\$\{)" + varname + R"(\})");
-        substituted = regex_replace(substituted, pattern, iter->second);
     }
-    return substituted;
+}
+
+std::string Tester::substitute(const Template &line) const {
+    string result;
+    substitute(line, result);
+    return result;
 }
 
 // Check the result of command with the expected string from the given test case
@@ -248,39 +310,22 @@ bool Tester::check_path_absent(const string &input) {
     return true;
 }
 
-std::string Tester::substitute(const string &raw) {
-    string result = substitute_once(raw), tmp;
-    if (result == raw) {
-        return raw;
-    }
-
-    int depth = 0;
-    while ((tmp = substitute_once(result)) != result && depth < 3) {
-        result = tmp;
-        ++depth;
-    }
-    return result;
-}
-
-void Tester::include_file(const string &input) {
+void Tester::include_file(const string &input, size_t position) {
     smatch match;
     if (!regex_match(input, match, INC_PATTERN)) {
         throw std::runtime_error("bad format: " + input);
     }
 
-    ifstream is(match[1].str());
+    // Included files are relative to where the tests are started, not to the sandbox of the test
+    ifstream is(BASE / path(match[1].str()));
     if (!is.is_open()) {
         throw std::runtime_error("failed to include the given file: " + match[1].str());
     }
 
-    stringstream temp_stream;
-    copy(istreambuf_iterator<char>(is), istreambuf_iterator<char>(), ostreambuf_iterator<char>(temp_stream));
+    vector<Instruction> included = compile(is);
     is.close();
-
-    string remaining(script.str().substr(script.tellg()));
-    temp_stream << remaining;
-    script.str(temp_stream.str());
-    script.clear();
+    program.insert(program.begin() + static_cast<ptrdiff_t>(position),
+                   make_move_iterator(included.begin()), make_move_iterator(included.end()));
 }
 
 bool Tester::compare_files(const string &input) {
@@ -324,7 +369,7 @@ bool Tester::compare_files(const string &input) {
 }
 
 void Tester::canonicalize(string &input) {
-    input = regex_replace(input, regex(R"(\r)"), "");
+    input.erase(remove(input.begin(), input.end(), '\r'), input.end());
 }
 
 
@@ -9,18 +9,43 @@
 #define COMP2012H_FA21_PA2_TESTER_H
 
 #include <string>
-#include <sstream>
 #include <unordered_map>
 #include <filesystem>
 #include <regex>
+#include <vector>
+#include <istream>
+
+class Repository;
 
 class Tester {
 public:
-    explicit Tester(const std::string &filename, bool verbose = false);
+    Tester(const std::string &filename, Repository &repository, bool verbose = false);
 
     bool run();
 
 private:
+    // A line of the script split into literal text and ${name} references, so that
+    // the variables are substituted without building a regex for each of them
+    struct Template {
+        struct Piece {
+            bool variable;
+            std::string text;   // the literal text, or the name of the variable
+        };
+        std::vector<Piece> pieces;
+
+        static Template parse(const std::string &line);
+    };
+
+    // A line of the script, with the expected output up to <<< for a command
+    struct Instruction {
+        char kind;
+        std::string source;     // the lines of the script, printed in verbose mode
+        Template line;
+        std::vector<Template> expected;
+    };
+
+    static std::vector<Instruction> compile(std::istream &is);
+
     static void copy_source(const std::string &input);
     static void remove_file(const std::string &input);
     static bool check_path_exists(const std::string &input);
@@ -28,29 +53,32 @@ private:
     static bool compare_files(const std::string &input);
     static void canonicalize(std::string &input);
 
-    std::string substitute_once(const std::string &raw);
-    std::string substitute(const std::string &raw);
-    bool run_and_check_command(const std::string &input);
+    void substitute(const Template &line, std::string &result, int depth = 0) const;
+    std::string substitute(const Template &line) const;
+    bool run_and_check_command(const Instruction &instruction, const std::string &input);
+    bool match_output(const std::string &actual, const std::string &expected);
     void add_definition(const std::string &input);
-    void include_file(const std::string &input);
+    void include_file(const std::string &input, size_t position);
 
     static const std::regex DEF_PATTERN;
     static const std::regex ADD_PATTERN;
     static const std::regex RM_PATTERN;
-    static const std::regex VAR_PATTERN;
     static const std::regex CMD_PATTERN;
-    static const std::regex END_PATTERN;
     static const std::regex EXIST_PATTERN;
     static const std::regex NE_PATTERN;
     static const std::regex INC_PATTERN;
     static const std::regex CMP_PATTERN;
 
+    static const std::filesystem::path BASE;    // the directory the tests are started from
     static const std::filesystem::path SRC;
+    static constexpr int MAX_SUBSTITUTION_DEPTH = 4;    // variables in the values of variables, and so on
 
+    Repository &repository;     // the repository the commands of the test run on
     bool verbose = false;
-    std::stringstream script;
-    std::unordered_map<std::string, std::string> defs;
-    std::unordered_map<std::string, std::string> last_group;
+    std::vector<Instruction> program;
+    std::unordered_map<std::string, Template> defs;
+    std::unordered_map<std::string, Template> last_group;
+    std::unordered_map<std::string, std::regex> patterns;   // compiled expected outputs
 };
 
 #endif //COMP2012H_FA21_PA2_TESTER_H
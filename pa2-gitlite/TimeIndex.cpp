@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "TimeIndex.h"
+
+using namespace std;
+
+// Each record is the time as a 64-bit integer followed by the 40 characters of the commit id
+static constexpr size_t ID_SIZE = 40;
+static constexpr size_t RECORD_SIZE = sizeof(int64_t) + ID_SIZE;
+static constexpr size_t RECORDS_PER_CHUNK = 1024;
+
+static void encode(char *record, std::time_t time, const string &commit_id) {
+    int64_t value = time;
+    memcpy(record, &value, sizeof(value));
+    memset(record + sizeof(value), 0, ID_SIZE);
+    memcpy(record + sizeof(value), commit_id.data(), min(commit_id.size(), ID_SIZE));
+}
+
+static std::time_t decode_time(const char *record) {
+    int64_t value;
+    memcpy(&value, record, sizeof(value));
+    return static_cast<std::time_t>(value);
+}
+
+static string decode_id(const char *record) {
+    const char *id = record + sizeof(int64_t);
+    return string(id, strnlen(id, ID_SIZE));
+}
+
+TimeIndex::TimeIndex(std::filesystem::path file) : file(std::move(file)) {}
+
+size_t TimeIndex::size() const {
+    error_code ec;
+    uintmax_t bytes = filesystem::file_size(file, ec);
+    return ec ? 0 : bytes / RECORD_SIZE;
+}
+
+void TimeIndex::add(std::time_t time, const std::string &commit_id) {
+    char record[RECORD_SIZE];
+    size_t count = size();
+    if (count > 0) {
+        ifstream is(file, ios::in | ios::binary);
+        is.seekg(static_cast<streamoff>((count - 1) * RECORD_SIZE));
+        is.read(record, RECORD_SIZE);
+        if (is && decode_time(record) > time) {
+            // The clock went backwards, put the commit in its place
+            vector<pair<std::time_t, string>> records;
+            scan_newest_first([&](std::time_t t, const string &id) {
+                records.emplace_back(t, id);
+                return true;
+            });
+            reverse(records.begin(), records.end());
+            auto position = upper_bound(records.begin(), records.end(), time,
+                                        [](std::time_t t, const auto &r) { return t < r.first; });
+            records.emplace(position, time, commit_id);
+            rebuild(std::move(records));
+            return;
+        }
+    }
+
+    ofstream os(file, ios::out | ios::binary | ios::app);
+    if (!os.is_open()) {
+        throw std::invalid_argument("failed to write " + file.string());
+    }
+    encode(record, time, commit_id);
+    os.write(record, RECORD_SIZE);
+}
+
+void TimeIndex::rebuild(std::vector<std::pair<std::time_t, std::string>> records) const {
+    stable_sort(records.begin(), records.end(),
+                [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    ofstream os(file, ios::out | ios::binary | ios::trunc);
+    if (!os.is_open()) {
+        throw std::invalid_argument("failed to write " + file.string());
+    }
+    char record[RECORD_SIZE];
+    for (auto &entry : records) {
+        encode(record, entry.first, entry.second);
+        os.write(record, RECORD_SIZE);
+    }
+}
+
+void TimeIndex::scan_newest_first(const std::function<bool(std::time_t, const std::string &)> &visit) const {
+    ifstream is(file, ios::in | ios::binary);
+    if (!is.is_open()) {
+        return;
+    }
+
+    vector<char> chunk(RECORDS_PER_CHUNK * RECORD_SIZE);
+    for (size_t end = size(); end > 0;) {
+        size_t begin = end > RECORDS_PER_CHUNK ? end - RECORDS_PER_CHUNK : 0;
+        is.seekg(static_cast<streamoff>(begin * RECORD_SIZE));
+        is.read(chunk.data(), static_cast<streamsize>((end - begin) * RECORD_SIZE));
+        if (!is) {
+            return;
+        }
+        for (size_t i = end - begin; i > 0; --i) {
+            const char *record = chunk.data() + (i - 1) * RECORD_SIZE;
+            if (!visit(decode_time(record), decode_id(record))) {
+                return;
+            }
+        }
+        end = begin;
+    }
+}
@@ -0,0 +1,49 @@
+//
+// Commit ids sorted by commit time, stored as fixed-size records in a file. The file can be read
+// from the end in chunks, so the newest commits are listed without reading or sorting every record.
+//
+
+#ifndef COMP2012H_FA21_PA2_TIMEINDEX_H
+#define COMP2012H_FA21_PA2_TIMEINDEX_H
+
+#include <ctime>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <filesystem>
+
+class TimeIndex {
+public:
+    explicit TimeIndex(std::filesystem::path file);
+
+    /**
+     * Get the number of commits in the index
+     * @return the number of records, 0 if the file does not exist
+     */
+    size_t size() const;
+
+    /**
+     * Add a commit. Commits are usually added in time order, so this is an append.
+     * @param time time of the commit
+     * @param commit_id id of the commit
+     */
+    void add(std::time_t time, const std::string &commit_id);
+
+    /**
+     * Replace the contents of the index
+     * @param records time and id of every commit, in any order
+     */
+    void rebuild(std::vector<std::pair<std::time_t, std::string>> records) const;
+
+    /**
+     * Visit the commits from the newest to the oldest, reading the file a chunk at a time
+     * @param visit called with the time and id of each commit, returns false to stop
+     */
+    void scan_newest_first(const std::function<bool(std::time_t, const std::string &)> &visit) const;
+
+private:
+    std::filesystem::path file;
+};
+
+#endif //COMP2012H_FA21_PA2_TIMEINDEX_H
@@ -0,0 +1,185 @@
+#include "Trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#include <cereal/external/rapidjson/ostreamwrapper.h>
+#include <cereal/external/rapidjson/writer.h>
+
+using namespace std;
+using path = std::filesystem::path;
+
+namespace {
+
+constexpr size_t COUNTERS = static_cast<size_t>(TraceCounter::COUNT);
+const char *const COUNTER_NAMES[COUNTERS] = {"files_hashed", "bytes_read", "bytes_written", "allocations", "file_ops"};
+
+struct TraceEvent {
+    string name;
+    const char *category;
+    unsigned thread;
+    int64_t start_us;
+    int64_t duration_us;
+    array<uint64_t, COUNTERS> counters;     // the change of every counter during the event
+};
+
+// Counters are process-wide and updated from every thread, events are appended under a mutex
+atomic<bool> enabled{false};
+atomic<uint64_t> counters[COUNTERS];
+atomic<unsigned> next_thread{0};
+mutex events_mutex;
+vector<TraceEvent> events;
+path output_file;
+chrono::steady_clock::time_point origin;
+
+int64_t now_us() {
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - origin).count();
+}
+
+// Small thread ids in the order the threads first record an event, so the viewer shows them in order
+unsigned thread_number() {
+    static thread_local unsigned number = next_thread++;
+    return number;
+}
+
+array<uint64_t, COUNTERS> read_counters() {
+    array<uint64_t, COUNTERS> values{};
+    for (size_t i = 0; i < COUNTERS; ++i) {
+        values[i] = counters[i].load(memory_order_relaxed);
+    }
+    return values;
+}
+
+}
+
+void trace_start(const path &output) {
+    lock_guard<mutex> lock(events_mutex);
+    events.clear();
+    output_file = output;
+    origin = chrono::steady_clock::now();
+    for (auto &counter : counters) {
+        counter.store(0, memory_order_relaxed);
+    }
+    enabled.store(true, memory_order_release);
+}
+
+bool trace_stop() {
+    if (!enabled.exchange(false)) {
+        return false;
+    }
+    array<uint64_t, COUNTERS> totals = read_counters();
+    int64_t end_us = now_us();
+    lock_guard<mutex> lock(events_mutex);
+    ofstream os(output_file);
+    if (!os.is_open()) {
+        return false;
+    }
+
+    rapidjson::OStreamWrapper stream(os);
+    rapidjson::Writer<rapidjson::OStreamWrapper> writer(stream);
+    writer.StartObject();
+    writer.Key("traceEvents");
+    writer.StartArray();
+    writer.StartObject();
+    writer.Key("name");
+    writer.String("process_name");
+    writer.Key("ph");
+    writer.String("M");
+    writer.Key("pid");
+    writer.Uint(0);
+    writer.Key("args");
+    writer.StartObject();
+    writer.Key("name");
+    writer.String("gitlite");
+    writer.EndObject();
+    writer.EndObject();
+
+    for (const TraceEvent &event : events) {
+        writer.StartObject();
+        writer.Key("name");
+        writer.String(event.name.c_str(), static_cast<rapidjson::SizeType>(event.name.size()));
+        writer.Key("cat");
+        writer.String(event.category);
+        writer.Key("ph");
+        writer.String("X");
+        writer.Key("pid");
+        writer.Uint(0);
+        writer.Key("tid");
+        writer.Uint(event.thread);
+        writer.Key("ts");
+        writer.Int64(event.start_us);
+        writer.Key("dur");
+        writer.Int64(event.duration_us);
+        writer.Key("args");
+        writer.StartObject();
+        for (size_t i = 0; i < COUNTERS; ++i) {
+            if (event.counters[i] != 0) {
+                writer.Key(COUNTER_NAMES[i]);
+                writer.Uint64(event.counters[i]);
+            }
+        }
+        writer.EndObject();
+        writer.EndObject();
+    }
+
+    // The totals of the whole run as one sample of a counter track
+    writer.StartObject();
+    writer.Key("name");
+    writer.String("totals");
+    writer.Key("ph");
+    writer.String("C");
+    writer.Key("pid");
+    writer.Uint(0);
+    writer.Key("ts");
+    writer.Int64(end_us);
+    writer.Key("args");
+    writer.StartObject();
+    for (size_t i = 0; i < COUNTERS; ++i) {
+        writer.Key(COUNTER_NAMES[i]);
+        writer.Uint64(totals[i]);
+    }
+    writer.EndObject();
+    writer.EndObject();
+
+    writer.EndArray();
+    writer.Key("displayTimeUnit");
+    writer.String("ms");
+    writer.EndObject();
+    os << '\n';
+    events.clear();
+    return os.good();
+}
+
+bool trace_enabled() {
+    return enabled.load(memory_order_relaxed);
+}
+
+void trace_count(TraceCounter counter, uint64_t amount) {
+    if (enabled.load(memory_order_relaxed)) {
+        counters[static_cast<size_t>(counter)].fetch_add(amount, memory_order_relaxed);
+    }
+}
+
+TraceScope::TraceScope(std::string name, const char *category)
+        : active(trace_enabled()), category(category) {
+    if (active) {
+        this->name = std::move(name);
+        counters_at_start = read_counters();
+        start_us = now_us();
+    }
+}
+
+TraceScope::~TraceScope() {
+    if (!active || !trace_enabled()) {
+        return;
+    }
+    TraceEvent event{std::move(name), category, thread_number(), start_us, now_us() - start_us, read_counters()};
+    for (size_t i = 0; i < COUNTERS; ++i) {
+        event.counters[i] -= counters_at_start[i];
+    }
+    lock_guard<mutex> lock(events_mutex);
+    events.push_back(std::move(event));
+}
@@ -0,0 +1,60 @@
+//
+// Opt-in tracing of where a command spends its time. A TraceScope records a complete event with
+// its thread and the counters (files hashed, bytes read and written, allocations, file operations)
+// that changed while it was open. The events are written as a Chrome trace-event file, viewable in
+// chrome://tracing or Perfetto, with the rapidjson writer that comes with cereal.
+// Tracing is off unless GITLITE_TRACE names the output file or gitlite is run with --trace; when
+// off, nothing is recorded and a scope or a counter costs little more than a check of one flag.
+//
+
+#ifndef COMP2012H_FA21_PA2_TRACE_H
+#define COMP2012H_FA21_PA2_TRACE_H
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+enum class TraceCounter {
+    FILES_HASHED,
+    BYTES_READ,
+    BYTES_WRITTEN,
+    ALLOCATIONS,        // calls to operator new, only counted when gitlite is built with TRACE_ALLOC=1
+    FILE_OPERATIONS,    // files opened, copied or removed, the closest portable measure of syscalls
+    COUNT
+};
+
+/**
+ * Start recording. Events recorded before are discarded.
+ * @param output the trace file written by trace_stop
+ */
+void trace_start(const std::filesystem::path &output);
+
+/**
+ * Stop recording and write the trace file
+ * @return true if the file was written, false if tracing was not started or the file cannot be written
+ */
+bool trace_stop();
+
+bool trace_enabled();
+
+void trace_count(TraceCounter counter, uint64_t amount = 1);
+
+// Records the time from its construction to its destruction as one event
+class TraceScope {
+public:
+    explicit TraceScope(std::string name, const char *category = "gitlite");
+    ~TraceScope();
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    bool active;
+    std::string name;
+    const char *category;
+    int64_t start_us = 0;
+    std::array<uint64_t, static_cast<size_t>(TraceCounter::COUNT)> counters_at_start{};
+};
+
+#endif //COMP2012H_FA21_PA2_TRACE_H
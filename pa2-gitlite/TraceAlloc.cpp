@@ -0,0 +1,106 @@
+//
+// Counts allocations for the trace by replacing the global operator new. Replacing it affects every
+// allocation of the program, so this file is not part of the library objects: it is only linked into
+// gitlite when built with 'make TRACE_ALLOC=1'. Every form of operator new and delete is replaced,
+// so memory is always released by the counterpart of the function that allocated it.
+//
+
+#include "Trace.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+using namespace std;
+
+static void *allocate(size_t size, size_t alignment) {
+    trace_count(TraceCounter::ALLOCATIONS);
+    if (size == 0) {
+        size = 1;
+    }
+    while (true) {
+        void *memory = nullptr;
+        if (alignment <= alignof(max_align_t)) {
+            memory = malloc(size);
+        } else {
+#ifndef _WIN32
+            if (posix_memalign(&memory, alignment, size) != 0)
+                memory = nullptr;
+#else
+            memory = _aligned_malloc(size, alignment);
+#endif
+        }
+        if (memory != nullptr) {
+            return memory;
+        }
+        new_handler handler = get_new_handler();
+        if (handler == nullptr) {
+            throw bad_alloc();
+        }
+        handler();
+    }
+}
+
+static void *allocate_nothrow(size_t size, size_t alignment) noexcept {
+    try {
+        return allocate(size, alignment);
+    } catch (const bad_alloc &) {
+        return nullptr;
+    }
+}
+
+static void release(void *memory, size_t alignment) noexcept {
+#ifdef _WIN32
+    if (alignment > alignof(max_align_t)) {
+        _aligned_free(memory);
+        return;
+    }
+#else
+    (void) alignment;
+#endif
+    free(memory);
+}
+
+static constexpr size_t DEFAULT_ALIGNMENT = alignof(max_align_t);
+
+void *operator new(size_t size) { return allocate(size, DEFAULT_ALIGNMENT); }
+void *operator new[](size_t size) { return allocate(size, DEFAULT_ALIGNMENT); }
+void *operator new(size_t size, const nothrow_t &) noexcept { return allocate_nothrow(size, DEFAULT_ALIGNMENT); }
+void *operator new[](size_t size, const nothrow_t &) noexcept { return allocate_nothrow(size, DEFAULT_ALIGNMENT); }
+void *operator new(size_t size, align_val_t alignment) { return allocate(size, static_cast<size_t>(alignment)); }
+void *operator new[](size_t size, align_val_t alignment) { return allocate(size, static_cast<size_t>(alignment)); }
+void *operator new(size_t size, align_val_t alignment, const nothrow_t &) noexcept {
+    return allocate_nothrow(size, static_cast<size_t>(alignment));
+}
+void *operator new[](size_t size, align_val_t alignment, const nothrow_t &) noexcept {
+    return allocate_nothrow(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *memory) noexcept { release(memory, DEFAULT_ALIGNMENT); }
+void operator delete[](void *memory) noexcept { release(memory, DEFAULT_ALIGNMENT); }
+void operator delete(void *memory, size_t) noexcept { release(memory, DEFAULT_ALIGNMENT); }
+void operator delete[](void *memory, size_t) noexcept { release(memory, DEFAULT_ALIGNMENT); }
+void operator delete(void *memory, const nothrow_t &) noexcept { release(memory, DEFAULT_ALIGNMENT); }
+void operator delete[](void *memory, const nothrow_t &) noexcept { release(memory, DEFAULT_ALIGNMENT); }
+void operator delete(void *memory, align_val_t alignment) noexcept {
+    release(memory, static_cast<size_t>(alignment));
+}
+void operator delete[](void *memory, align_val_t alignment) noexcept {
+    release(memory, static_cast<size_t>(alignment));
+}
+void operator delete(void *memory, size_t, align_val_t alignment) noexcept {
+    release(memory, static_cast<size_t>(alignment));
+}
+void operator delete[](void *memory, size_t, align_val_t alignment) noexcept {
+    release(memory, static_cast<size_t>(alignment));
+}
+void operator delete(void *memory, align_val_t alignment, const nothrow_t &) noexcept {
+    release(memory, static_cast<size_t>(alignment));
+}
+void operator delete[](void *memory, align_val_t alignment, const nothrow_t &) noexcept {
+    release(memory, static_cast<size_t>(alignment));
+}
@@ -0,0 +1,225 @@
+#include <fstream>
+#include <stdexcept>
+
+#include "Tree.h"
+#include "Diff.h"
+#include "Utils.h"
+#include "Trace.h"
+
+using namespace std;
+using path = std::filesystem::path;
+
+static thread_local TreeStore *registered_store = nullptr;
+
+static const vector<TreeEntry> EMPTY_TREE;
+
+// Compare two entries as the full paths they stand for: a subdirectory sorts as its name followed by '/'
+static int compare_entries(const TreeEntry &a, const TreeEntry &b) {
+    size_t common = min(a.name.size(), b.name.size());
+    int result = a.name.compare(0, common, b.name, 0, common);
+    if (result != 0)
+        return result;
+    auto next = [common](const TreeEntry &entry) -> int {
+        if (common < entry.name.size())
+            return static_cast<unsigned char>(entry.name[common]);
+        return entry.is_tree ? '/' : -1;
+    };
+    return next(a) - next(b);
+}
+
+static string encode_tree(const vector<TreeEntry> &entries) {
+    string out;
+    for (const TreeEntry &entry : entries) {
+        out += entry.is_tree ? 't' : 'b';
+        out += entry.name;
+        out += '\0';
+        out.append(reinterpret_cast<const char *>(entry.id.bytes().data()), ObjectId::SIZE);
+    }
+    return out;
+}
+
+static vector<TreeEntry> decode_tree(string_view data) {
+    vector<TreeEntry> entries;
+    size_t position = 0;
+    while (position < data.size()) {
+        size_t end = data.find('\0', position);
+        if (end == string_view::npos || end + 1 + ObjectId::SIZE > data.size()
+            || (data[position] != 't' && data[position] != 'b'))
+            throw std::runtime_error("corrupted tree object");
+        TreeEntry entry;
+        entry.is_tree = data[position] == 't';
+        entry.name = string(data.substr(position + 1, end - position - 1));
+        entry.id = ObjectId::from_bytes(reinterpret_cast<const uint8_t *>(data.data() + end + 1));
+        entries.push_back(std::move(entry));
+        position = end + 1 + ObjectId::SIZE;
+    }
+    return entries;
+}
+
+TreeStore::TreeStore(std::filesystem::path dir) : dir(std::move(dir)) {}
+
+// Build the directory for blobs[begin, end), whose names all start with the first offset characters.
+// The blobs are sorted, so all the paths under the same subdirectory are next to each other.
+static ObjectId build_directory(unordered_map<ObjectId, vector<TreeEntry>> &trees, const vector<const Blob *> &blobs,
+                                size_t begin, size_t end, size_t offset) {
+    vector<TreeEntry> entries;
+    for (size_t i = begin; i < end;) {
+        const string &name = blobs[i]->name;
+        size_t slash = name.find('/', offset);
+        if (slash == string::npos) {
+            entries.push_back({name.substr(offset), blobs[i++]->ref, false});
+            continue;
+        }
+
+        size_t length = slash + 1;
+        size_t last = i + 1;
+        while (last < end && blobs[last]->name.str().compare(0, length, name, 0, length) == 0) {
+            ++last;
+        }
+        ObjectId subtree = build_directory(trees, blobs, i, last, length);
+        entries.push_back({name.substr(offset, slash - offset), subtree, true});
+        i = last;
+    }
+
+    ObjectId id = get_string_id(encode_tree(entries));
+    trees.emplace(id, std::move(entries));
+    return id;
+}
+
+ObjectId TreeStore::build(const List *files) {
+    TraceScope trace("build trees", "tree");
+    vector<const Blob *> blobs;
+    for (Blob *blob = files->head->next; blob != files->head; blob = blob->next) {
+        blobs.push_back(blob);
+    }
+    return build_directory(trees, blobs, 0, blobs.size(), 0);
+}
+
+ObjectId TreeStore::tree_of(const Commit *commit) {
+    // A recorded tree can only be used if it can be read back
+    if (!commit->tree_id.is_null() && (!dir.empty() || trees.count(commit->tree_id) != 0))
+        return commit->tree_id;
+    return build(commit->tracked_files);
+}
+
+void TreeStore::save(const ObjectId &root) {
+    if (dir.empty())
+        return;
+    path file = dir / path(root.to_hex());
+    if (filesystem::is_regular_file(file))
+        return;     // stored with all its subtrees, which are always written first
+
+    const vector<TreeEntry> &tree = entries(root);
+    for (const TreeEntry &entry : tree) {
+        if (entry.is_tree)
+            save(entry.id);
+    }
+    filesystem::create_directories(dir);
+    string content = encode_tree(tree);
+    ofstream os(file, ios::out | ios::binary);
+    if (!os.is_open())
+        throw std::runtime_error("failed to write " + file.string());
+    os.write(content.data(), static_cast<streamsize>(content.size()));
+    trace_count(TraceCounter::FILE_OPERATIONS);
+    trace_count(TraceCounter::BYTES_WRITTEN, content.size());
+}
+
+const std::vector<TreeEntry> &TreeStore::entries(const ObjectId &id) {
+    auto iter = trees.find(id);
+    if (iter != trees.end())
+        return iter->second;
+
+    path file = dir / path(id.to_hex());
+    if (dir.empty() || !filesystem::is_regular_file(file))
+        throw std::runtime_error("tree " + id.to_hex() + " does not exist");
+    MappedFile mapped(file);
+    trace_count(TraceCounter::FILE_OPERATIONS);
+    trace_count(TraceCounter::BYTES_READ, mapped.view().size());
+    return trees.emplace(id, decode_tree(mapped.view())).first->second;
+}
+
+void TreeStore::clear() {
+    trees.clear();
+}
+
+static const vector<TreeEntry> &entries_or_empty(TreeStore &store, const ObjectId &id) {
+    return id.is_null() ? EMPTY_TREE : store.entries(id);
+}
+
+static void diff_directories(TreeStore &store, const ObjectId &old_tree, const ObjectId &new_tree, const string &prefix,
+                             const function<void(const string &, const ObjectId &, const ObjectId &)> &visit) {
+    if (old_tree == new_tree)
+        return;
+
+    const vector<TreeEntry> &a = entries_or_empty(store, old_tree), &b = entries_or_empty(store, new_tree);
+    size_t i = 0, j = 0;
+    while (i < a.size() || j < b.size()) {
+        int order = i == a.size() ? 1 : j == b.size() ? -1 : compare_entries(a[i], b[j]);
+        const TreeEntry *old_entry = order <= 0 ? &a[i++] : nullptr;
+        const TreeEntry *new_entry = order >= 0 ? &b[j++] : nullptr;
+        const TreeEntry &entry = old_entry ? *old_entry : *new_entry;
+        ObjectId old_id = old_entry ? old_entry->id : ObjectId(), new_id = new_entry ? new_entry->id : ObjectId();
+        if (entry.is_tree) {
+            diff_directories(store, old_id, new_id, prefix + entry.name + "/", visit);
+        } else if (old_id != new_id) {
+            visit(prefix + entry.name, old_id, new_id);
+        }
+    }
+}
+
+void diff_trees(TreeStore &store, const ObjectId &old_tree, const ObjectId &new_tree,
+                const std::function<void(const std::string &, const ObjectId &, const ObjectId &)> &visit) {
+    diff_directories(store, old_tree, new_tree, string(), visit);
+}
+
+static void walk_merge_directories(TreeStore &store, const ObjectId (&trees)[3], const string &prefix,
+                                   const function<void(const string &, const ObjectId &, const ObjectId &,
+                                                       const ObjectId &)> &visit) {
+    if (trees[1] == trees[2])
+        return;     // the same in the current and the given commit
+
+    const vector<TreeEntry> *sides[3];
+    size_t positions[3] = {0, 0, 0};
+    for (int k = 0; k < 3; ++k) {
+        sides[k] = &entries_or_empty(store, trees[k]);
+    }
+    while (true) {
+        // The smallest entry among the three cursors
+        const TreeEntry *smallest = nullptr;
+        for (int k = 0; k < 3; ++k) {
+            if (positions[k] < sides[k]->size()
+                && (smallest == nullptr || compare_entries((*sides[k])[positions[k]], *smallest) < 0))
+                smallest = &(*sides[k])[positions[k]];
+        }
+        if (smallest == nullptr)
+            break;
+
+        ObjectId ids[3];
+        TreeEntry entry = *smallest;
+        for (int k = 0; k < 3; ++k) {
+            if (positions[k] < sides[k]->size() && compare_entries((*sides[k])[positions[k]], entry) == 0)
+                ids[k] = (*sides[k])[positions[k]++].id;
+        }
+        if (entry.is_tree) {
+            walk_merge_directories(store, ids, prefix + entry.name + "/", visit);
+        } else if (ids[1] != ids[2]) {
+            visit(prefix + entry.name, ids[0], ids[1], ids[2]);
+        }
+    }
+}
+
+void walk_merge_trees(TreeStore &store, const ObjectId &split, const ObjectId &current, const ObjectId &given,
+                      const std::function<void(const std::string &, const ObjectId &, const ObjectId &,
+                                               const ObjectId &)> &visit) {
+    const ObjectId trees[3] = {split, current, given};
+    walk_merge_directories(store, trees, string(), visit);
+}
+
+TreeStore &tree_store() {
+    static thread_local TreeStore memory;
+    return registered_store != nullptr ? *registered_store : memory;
+}
+
+void set_tree_store(TreeStore *store) {
+    registered_store = store;
+}
@@ -0,0 +1,102 @@
+//
+// Tree objects: the directory hierarchy of a list of tracked files. Every directory is identified
+// by the SHA1 of its entries and stored once under .gitlite/trees, and every commit records the id
+// of its root tree, so equal ids mean identical subtrees. Two commits are compared by walking down
+// only the directories whose ids differ.
+//
+// A tree object is the list of its entries, each one a type byte ('b' for a file, 't' for a
+// subdirectory), the name within the directory, a '\0' and the 20-byte id. Entries are sorted as
+// full paths are, i.e. a subdirectory by its name followed by '/', so walking a tree visits the
+// files in the same order as a list of tracked files sorted by name.
+//
+
+#ifndef COMP2012H_FA21_PA2_TREE_H
+#define COMP2012H_FA21_PA2_TREE_H
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <functional>
+#include <unordered_map>
+
+#include "Commit.h"
+#include "ObjectId.h"
+
+struct TreeEntry {
+    std::string name;   // name within the directory
+    ObjectId id;        // ref of the file, or id of the subtree
+    bool is_tree = false;
+};
+
+// Tree objects by id, computed in memory or read from the directory of the store on first use
+class TreeStore {
+public:
+    TreeStore() = default;      // keeps the trees in memory only
+    explicit TreeStore(std::filesystem::path dir);
+
+    /**
+     * Compute the trees of a list of files. They are kept in memory until save is called.
+     * @param files the files, sorted by name as list_put keeps them
+     * @return the id of the root tree
+     */
+    ObjectId build(const List *files);
+
+    /**
+     * Get the root tree of a commit, the recorded one if there is one, otherwise built from its files
+     * @param commit the commit
+     * @return the id of the root tree
+     */
+    ObjectId tree_of(const Commit *commit);
+
+    /**
+     * Store a tree and all its subtrees in the directory, skipping those already stored
+     * @param root id of a tree returned by build
+     */
+    void save(const ObjectId &root);
+
+    /**
+     * Get the entries of a tree
+     * @param id id of the tree
+     * @return the entries, sorted
+     * @throw std::runtime_error if the tree is neither in memory nor stored
+     */
+    const std::vector<TreeEntry> &entries(const ObjectId &id);
+
+    void clear();
+
+private:
+    std::filesystem::path dir;
+    std::unordered_map<ObjectId, std::vector<TreeEntry>> trees;
+};
+
+/**
+ * Compare two trees, skipping every subtree that has the same id on both sides
+ * @param store the store holding both trees
+ * @param old_tree id of the old tree, the null id for an empty tree
+ * @param new_tree id of the new tree, the null id for an empty tree
+ * @param visit called with the path, the old and the new ref of each file that differs, sorted by path;
+ *              a ref is null if the file does not exist on that side
+ */
+void diff_trees(TreeStore &store, const ObjectId &old_tree, const ObjectId &new_tree,
+                const std::function<void(const std::string &, const ObjectId &, const ObjectId &)> &visit);
+
+/**
+ * Walk the trees of a merge: the split point, the current and the given commit. Every subtree
+ * with the same id in the current and the given commit is skipped, as there is nothing to merge in it.
+ * @param store the store holding the trees
+ * @param visit called with the path and the three refs of every other file, sorted by path;
+ *              a ref is null if the file does not exist in that commit
+ */
+void walk_merge_trees(TreeStore &store, const ObjectId &split, const ObjectId &current, const ObjectId &given,
+                      const std::function<void(const std::string &, const ObjectId &, const ObjectId &,
+                                               const ObjectId &)> &visit);
+
+/**
+ * Get the store used by the calling thread, the one registered with set_tree_store, otherwise
+ * one kept in memory
+ */
+TreeStore &tree_store();
+
+void set_tree_store(TreeStore *store);
+
+#endif //COMP2012H_FA21_PA2_TREE_H
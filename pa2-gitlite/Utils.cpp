@@ -3,22 +3,32 @@
 //
 
 #include <TinySHA1.hpp>
+#include <algorithm>
 #include <string>
 #include <filesystem>
 #include <fstream>
+#include <sstream>
+#include <iomanip>
 #include <ctime>
+#include <utility>
 
 #include "Utils.h"
+#include "Diff.h"
+#include "Ignore.h"
+#include "ObjectId.h"
+#include "Trace.h"
 
 using namespace std;
 using path = std::filesystem::path;
 
-std::string get_sha1(const std::string &message, const std::string &time) {
-    return get_string_sha1(message + time);
+static thread_local path current_work_tree;     // empty when no WorkTreeScope is active
+
+ObjectId get_sha1(const std::string &message, const std::string &time) {
+    return get_string_id(message + time);
 }
 
-std::string get_sha1(const std::string &filename) {
-    path file = filesystem::current_path() / path(filename);
+ObjectId get_sha1(const std::string &filename) {
+    path file = work_tree() / path(filename);
     return get_sha1(file);
 }
 
@@ -27,24 +37,55 @@ std::string get_time_string() {
     return std::ctime(&now);
 }
 
+static std::time_t parse_time(const std::string &str, const char *format) {
+    std::tm tm{};
+    tm.tm_isdst = -1;   // let mktime figure out daylight saving time
+    istringstream is(str);
+    is >> get_time(&tm, format);
+    if (is.fail() || !(is >> ws).eof()) {  // reject trailing characters
+        return -1;
+    }
+    return mktime(&tm);
+}
+
+std::time_t parse_time_string(const std::string &time) {
+    return parse_time(time, "%a %b %d %H:%M:%S %Y");
+}
+
+std::time_t parse_date(const std::string &date) {
+    std::time_t time = parse_time(date, "%Y-%m-%d %H:%M:%S");
+    return time != -1 ? time : parse_time(date, "%Y-%m-%d");
+}
+
 bool restricted_delete(const std::string &filename) {
-    path gitlite = filesystem::current_path() / path(".gitlite");
+    path gitlite = work_tree() / path(".gitlite");
     if (!filesystem::is_directory(gitlite)) {
         // Only remove the file if it is in a directory with .gitlite
         return false;
     }
 
-    path file = filesystem::current_path() / path(filename);
-    return filesystem::remove(file);
+    path root = work_tree();
+    path file = root / path(filename);
+    trace_count(TraceCounter::FILE_OPERATIONS);
+    if (!filesystem::remove(file)) {
+        return false;
+    }
+
+    // Remove the directories that became empty, up to CWD
+    for (path dir = file.parent_path(); dir != root && filesystem::is_empty(dir);
+         dir = dir.parent_path()) {
+        filesystem::remove(dir);
+    }
+    return true;
 }
 
-void add_conflict_marker(const std::string &filename, const std::string &ref) {
+void add_conflict_marker(const std::string &filename, const ObjectId &ref) {
     string header = "<<<<<<< HEAD\n";
     string separator = "=======\n";
     string footer = ">>>>>>>\n";
 
-    path file = filesystem::current_path() / path(filename);
-    if (ref.empty()) {
+    path file = work_tree() / path(filename);
+    if (ref.is_null()) {
         if (!filesystem::is_regular_file(file)) {
             return;
         }
@@ -55,7 +96,7 @@ void add_conflict_marker(const std::string &filename, const std::string &ref) {
         return;
     }
 
-    path other = filesystem::current_path() / path(".gitlite/blobs") / path(ref);
+    path other = work_tree() / path(".gitlite/blobs") / path(ref.to_hex());
     if (!filesystem::is_regular_file(file) && !filesystem::is_regular_file((other))) {
         return;
     }
@@ -67,10 +108,77 @@ void add_conflict_marker(const std::string &filename, const std::string &ref) {
     os.close();
 }
 
-bool write_file(const std::string &filename, const std::string &ref) {
-    path gitlite = filesystem::current_path() / path(".gitlite");
-    path src = gitlite / path("blobs") / path(ref);
-    path dst = filesystem::current_path() / path(filename);
+bool add_conflict_marker(const std::string &filename, const ObjectId &base_ref, const ObjectId &ref) {
+    path file = work_tree() / path(filename);
+    path blobs = work_tree() / path(".gitlite/blobs");
+    path base = blobs / path(base_ref.to_hex()), other = blobs / path(ref.to_hex());
+    if (base_ref.is_null() || ref.is_null() || !filesystem::is_regular_file(file)
+        || !filesystem::is_regular_file(base) || !filesystem::is_regular_file(other)) {
+        add_conflict_marker(filename, ref);
+        return true;
+    }
+
+    string merged;
+    int conflicts;
+    {
+        MappedFile base_content(base), head_content(file), other_content(other);
+        if (is_binary(base_content.view()) || is_binary(head_content.view()) || is_binary(other_content.view())) {
+            conflicts = -1;
+        } else {
+            conflicts = merge_lines(merged, base_content.view(), head_content.view(), other_content.view());
+        }
+    }   // unmap the file before overwriting it
+
+    if (conflicts < 0) {
+        add_conflict_marker(filename, ref);
+        return true;
+    }
+    write_content(file, merged);
+    return conflicts > 0;
+}
+
+ObjectId merge_blobs(const ObjectId &base_ref, const ObjectId &ref, const ObjectId &other_ref,
+                     std::unordered_map<ObjectId, std::string> &unstored) {
+    path blobs = work_tree() / path(".gitlite/blobs");
+    string merged;
+    {
+        MappedFile files[3];
+        string_view contents[3];
+        const ObjectId *refs[3] = {&base_ref, &ref, &other_ref};
+        for (int i = 0; i < 3; ++i) {
+            auto iter = unstored.find(*refs[i]);
+            if (iter != unstored.end()) {
+                contents[i] = iter->second;
+            } else {
+                files[i] = MappedFile(blobs / path(refs[i]->to_hex()));
+                contents[i] = files[i].view();
+            }
+        }
+        if (is_binary(contents[0]) || is_binary(contents[1]) || is_binary(contents[2])
+            || merge_lines(merged, contents[0], contents[1], contents[2]) > 0) {
+            return ObjectId();
+        }
+    }
+
+    ObjectId hash = get_string_id(merged);
+    unstored.emplace(hash, std::move(merged));
+    return hash;
+}
+
+void store_blobs(const std::unordered_map<ObjectId, std::string> &unstored) {
+    path blobs = work_tree() / path(".gitlite/blobs");
+    for (auto &blob : unstored) {
+        path file = blobs / path(blob.first.to_hex());
+        if (!filesystem::is_regular_file(file)) {
+            write_content(file, blob.second);
+        }
+    }
+}
+
+bool write_file(const std::string &filename, const ObjectId &ref) {
+    path gitlite = work_tree() / path(".gitlite");
+    path src = gitlite / path("blobs") / path(ref.to_hex());
+    path dst = work_tree() / path(filename);
     if (!filesystem::is_regular_file(src)) {
         return false;
     }
@@ -79,13 +187,13 @@ bool write_file(const std::string &filename, const std::string &ref) {
 }
 
 bool is_file_exist(const std::string &filename) {
-    path file = filesystem::current_path() / path(filename);
+    path file = work_tree() / path(filename);
     return filesystem::is_regular_file(file);
 }
 
 void stage_content(const std::string &filename) {
-    path staged = filesystem::current_path() / path(".gitlite/index") / filename;
-    path src = filesystem::current_path() / path(filename);
+    path staged = work_tree() / path(".gitlite/index") / filename;
+    path src = work_tree() / path(filename);
     copy_file_overwrite(src, staged);
 }
 
@@ -100,6 +208,8 @@ std::string read_content(const std::filesystem::path &path) {
     istreambuf_iterator<char> begin(is), end;
     string content(begin, end);
     is.close();
+    trace_count(TraceCounter::FILE_OPERATIONS);
+    trace_count(TraceCounter::BYTES_READ, content.size());
     return content;
 }
 
@@ -113,26 +223,62 @@ std::vector<std::string> regular_files_in_path(const std::filesystem::path &path
     return filenames;
 }
 
+// Paths (separated by '/') of all the regular files under root, relative to root.
+// Directories named .gitlite, directories ignored by the matcher, and skipped_dirs are never entered.
+std::vector<std::string> regular_files_in_tree(const std::filesystem::path &root, const IgnoreMatcher *ignore,
+                                               const std::string &subdir,
+                                               const std::vector<std::filesystem::path> &skipped_dirs) {
+    vector<string> filenames;
+    auto iter = filesystem::recursive_directory_iterator(subdir.empty() ? root : root / path(subdir));
+    for (auto &entry : iter) {
+        bool is_directory = entry.is_directory();
+        if (!is_directory && !entry.is_regular_file()) {
+            continue;
+        }
+        auto skipped = [&](const filesystem::path &dir) {
+            std::error_code ec;
+            return filesystem::equivalent(dir, entry.path(), ec);
+        };
+        if (is_directory && (entry.path().filename() == ".gitlite"
+                             || std::any_of(skipped_dirs.begin(), skipped_dirs.end(), skipped))) {
+            iter.disable_recursion_pending();
+            continue;
+        }
+
+        string name = filesystem::relative(entry.path(), root).generic_string();
+        if (ignore != nullptr && ignore->is_ignored_entry(name, is_directory)) {
+            if (is_directory)
+                iter.disable_recursion_pending();
+        } else if (!is_directory) {
+            filenames.push_back(name);
+        }
+    }
+    return filenames;
+}
+
 void write_content(const std::filesystem::path &path, const std::string &content) {
     ofstream os(path);
     if (!os.is_open())
         throw std::runtime_error("failed to write to " + path.string());
     os << content;
     os.close();
+    trace_count(TraceCounter::FILE_OPERATIONS);
+    trace_count(TraceCounter::BYTES_WRITTEN, content.size());
 }
 
-std::string get_string_sha1(const string &str) {
+ObjectId get_string_id(const string &str) {
     sha1::SHA1 s;
     s.processBytes(str.c_str(), str.size());
     uint32_t digest[5];
     s.getDigest(digest);
-    char buf[48];
-    snprintf(buf, 42, "%08x%08x%08x%08x%08x",
-             digest[0], digest[1], digest[2], digest[3], digest[4]);
-    return buf;
+    return ObjectId::from_digest(digest);
+}
+
+std::string get_string_sha1(const string &str) {
+    return get_string_id(str).to_hex();
 }
 
-std::string get_sha1(const filesystem::path &path) {
+ObjectId get_sha1(const filesystem::path &path) {
     if (!filesystem::is_regular_file(path))
         throw invalid_argument(path.string() + " does not represent a regular file");
 
@@ -143,7 +289,11 @@ std::string get_sha1(const filesystem::path &path) {
     ostringstream buf;
     buf << is.rdbuf();
     is.close();
-    return get_string_sha1(buf.str());
+    string content = buf.str();
+    trace_count(TraceCounter::FILES_HASHED);
+    trace_count(TraceCounter::FILE_OPERATIONS);
+    trace_count(TraceCounter::BYTES_READ, content.size());
+    return get_string_id(content);
 }
 
 void copy_file_overwrite(const std::filesystem::path &from, const std::filesystem::path &to) {
@@ -155,7 +305,25 @@ void copy_file_overwrite(const std::filesystem::path &from, const std::filesyste
     }
     if (filesystem::is_regular_file(to)) {
         filesystem::remove(to);
+    } else if (to.has_parent_path()) {
+        filesystem::create_directories(to.parent_path());
     }
     // overwrite_existing does not work here
     filesystem::copy_file(from, to, filesystem::copy_options::overwrite_existing);
+    if (trace_enabled()) {
+        uintmax_t size = filesystem::file_size(to);
+        trace_count(TraceCounter::FILE_OPERATIONS);
+        trace_count(TraceCounter::BYTES_READ, size);
+        trace_count(TraceCounter::BYTES_WRITTEN, size);
+    }
+}
+
+path work_tree() {
+    return current_work_tree.empty() ? filesystem::current_path() : current_work_tree;
+}
+
+WorkTreeScope::WorkTreeScope(path root) : previous(std::exchange(current_work_tree, std::move(root))) {}
+
+WorkTreeScope::~WorkTreeScope() {
+    current_work_tree = std::move(previous);
 }
@@ -10,11 +10,14 @@
 
 #include <vector>
 #include <string>
+#include <ctime>
 #include <filesystem>
 #include <unordered_map>
 #include <cereal/archives/binary.hpp>
 #include <cereal/types/vector.hpp>
 
+#include "ObjectId.h"
+
 //=============================================================================
 // These are the utility functions you will probably want to use in your code.
 // They come along with docstrings to facilitate your invocation.
@@ -27,17 +30,17 @@
  * because it makes the tasks easier.
  * @param message the commit message
  * @param time the time of committing
- * @return a string containing the SHA1 value
+ * @return the SHA1 value
  */
-std::string get_sha1(const std::string &message, const std::string &time);
+ObjectId get_sha1(const std::string &message, const std::string &time);
 
 
 /**
  * Compute the SHA1 value of the file in CWD with given filename
  * @param filename the filename of the file
- * @return a string containing SHA1 value
+ * @return the SHA1 value
  */
-std::string get_sha1(const std::string &filename);
+ObjectId get_sha1(const std::string &filename);
 
 
 /**
@@ -46,10 +49,24 @@ std::string get_sha1(const std::string &filename);
  */
 std::string get_time_string();
 
+/**
+ * Convert a string from get_time_string back to a time
+ * @param time a formatted string, e.g. "Wed Jun 30 21:49:08 1993\n"
+ * @return the time, or -1 if the string cannot be parsed
+ */
+std::time_t parse_time_string(const std::string &time);
+
+/**
+ * Parse a date given on the command line, as "YYYY-MM-DD" or "YYYY-MM-DD HH:MM:SS" in local time
+ * @param date the date to parse
+ * @return the time, or -1 if the date cannot be parsed
+ */
+std::time_t parse_date(const std::string &date);
+
 
 /**
  * Delete the file in CWD with given filename only if there exists a directory
- * named .gitlite in CWD
+ * named .gitlite in CWD. Directories left empty by the deletion are removed as well.
  * This function WILL ACTUALLY DELETE THE FILE in your filesystem!
  * @param filename the filename of the file to be deleted
  * @return true if successfully deleted, false otherwise
@@ -61,9 +78,44 @@ bool restricted_delete(const std::string &filename);
  * Add conflict resolution marker to the file in CWD based on the its contents
  * and the contents of the checked-out file with ref.
  * @param filename the filename of the file in CWD
+ * @param ref the reference (SHA1 value) of the file compared to, null if it was removed
+ */
+void add_conflict_marker(const std::string &filename, const ObjectId &ref);
+
+
+/**
+ * Merge the file in CWD with the checked-out file with ref line by line, using the blob
+ * with base_ref (the version in the split point) as the common ancestor.
+ * Only the regions changed differently on both sides get conflict resolution markers.
+ * Falls back to add_conflict_marker(filename, ref) if either side or the base is missing,
+ * or if any of them is a binary file.
+ * @param filename the filename of the file in CWD
+ * @param base_ref the reference (SHA1 value) of the file in the split point
  * @param ref the reference (SHA1 value) of the file compared to
+ * @return true if conflict markers were added, false if the file merged cleanly
  */
-void add_conflict_marker(const std::string &filename, const std::string &ref);
+bool add_conflict_marker(const std::string &filename, const ObjectId &base_ref, const ObjectId &ref);
+
+
+/**
+ * Merge two blobs line by line against the blob of their common ancestor. The result is not stored
+ * yet but added to unstored, so nothing is written if the merge is given up later.
+ * Blobs found in unstored are read from there, so a merged blob can be merged again.
+ * @param base_ref the reference (SHA1 value) of the blob in the split point
+ * @param ref the reference (SHA1 value) of one side
+ * @param other_ref the reference (SHA1 value) of the other side
+ * @param unstored the merged blobs not stored yet, by reference
+ * @return the reference of the merged blob, or the null id if the changes conflict or any of the blobs is binary
+ */
+ObjectId merge_blobs(const ObjectId &base_ref, const ObjectId &ref, const ObjectId &other_ref,
+                     std::unordered_map<ObjectId, std::string> &unstored);
+
+
+/**
+ * Store the blobs merged by merge_blobs
+ * @param unstored the merged blobs, by reference
+ */
+void store_blobs(const std::unordered_map<ObjectId, std::string> &unstored);
 
 
 /**
@@ -73,7 +125,7 @@ void add_conflict_marker(const std::string &filename, const std::string &ref);
  * @param ref the reference (SHA1 value) to the blob
  * @return true if succeeded, false otherwise
  */
-bool write_file(const std::string &filename, const std::string &ref);
+bool write_file(const std::string &filename, const ObjectId &ref);
 
 
 /**
@@ -95,15 +147,39 @@ void stage_content(const std::string &filename);
 // You can safely ignore any of the following functions.
 //========================================================
 
+// The CWD of the functions above. It is the current directory of the process unless a WorkTreeScope
+// is active on the calling thread, so that one process can work on several repositories at once.
+std::filesystem::path work_tree();
+
+class WorkTreeScope {
+public:
+    explicit WorkTreeScope(std::filesystem::path root);
+    ~WorkTreeScope();
+
+    WorkTreeScope(const WorkTreeScope &) = delete;
+    WorkTreeScope &operator=(const WorkTreeScope &) = delete;
+
+private:
+    std::filesystem::path previous;
+};
+
 std::string read_content(const std::filesystem::path &path);
 
 std::vector<std::string> regular_files_in_path(const std::filesystem::path &path);
 
+class IgnoreMatcher;
+
+std::vector<std::string> regular_files_in_tree(const std::filesystem::path &root, const IgnoreMatcher *ignore = nullptr,
+                                               const std::string &subdir = std::string(),
+                                               const std::vector<std::filesystem::path> &skipped_dirs = {});
+
 void write_content(const std::filesystem::path &path, const std::string &content);
 
+ObjectId get_string_id(const std::string &str);
+
 std::string get_string_sha1(const std::string &str);
 
-std::string get_sha1(const std::filesystem::path &path);
+ObjectId get_sha1(const std::filesystem::path &path);
 
 void copy_file_overwrite(const std::filesystem::path &from, const std::filesystem::path &to);
 
@@ -0,0 +1,108 @@
+//
+// Benchmark of ancestor checks and merge bases on a long history with branches and merges.
+// Compares walking the history, as get_lca does without an index, with the reachability bitmaps,
+// and checks that both give the same answers.
+// Usage: ancestry_bench [commits] [branches] [queries]
+//
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Commit.h"
+#include "Reachability.h"
+#include "Utils.h"
+
+using namespace std;
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_ms(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    int count = argc > 1 ? stoi(argv[1]) : 100000;
+    int branch_count = argc > 2 ? stoi(argv[2]) : 32;
+    int queries = argc > 3 ? stoi(argv[3]) : 200;
+    mt19937 rng(2012);
+
+    // Branches fork from random commits, and one commit in twenty merges another branch
+    unordered_map<ObjectId, Commit *> commits;
+    vector<Commit *> all, heads;
+    for (int i = 0; i < count; ++i) {
+        Commit *commit = new Commit;
+        commit->message = "Commit " + to_string(i);
+        commit->commit_id = get_sha1(commit->message, to_string(i));
+        commit->tracked_files = list_new();
+        if (i > 0 && static_cast<int>(heads.size()) < branch_count && rng() % 100 == 0) {
+            heads.push_back(all[rng() % all.size()]);
+        }
+        if (heads.empty()) {
+            heads.push_back(nullptr);
+        }
+        size_t branch = rng() % heads.size();
+        commit->parent = heads[branch];
+        if (heads.size() > 1 && rng() % 20 == 0) {
+            Commit *other = heads[(branch + 1 + rng() % (heads.size() - 1)) % heads.size()];
+            if (other != commit->parent)
+                commit->second_parent = other;
+        }
+        heads[branch] = commit;
+        all.push_back(commit);
+        commits.emplace(commit->commit_id, commit);
+    }
+    List *branches = list_new();
+    for (size_t i = 0; i < heads.size(); ++i) {
+        list_put(branches, "b" + to_string(i), heads[i]);
+    }
+
+    vector<pair<Commit *, Commit *>> pairs;
+    for (int i = 0; i < queries; ++i) {
+        Commit *head = heads[rng() % heads.size()];
+        Commit *other = rng() % 2 ? heads[rng() % heads.size()] : all[rng() % all.size()];
+        pairs.emplace_back(head, other);
+    }
+    cout << "commits=" << count << "\tbranches=" << heads.size() << "\tqueries=" << queries << endl;
+
+    // The walks, with no index registered
+    Clock::time_point start = Clock::now();
+    vector<bool> walk_ancestor;
+    for (auto &pair : pairs) {
+        walk_ancestor.push_back(is_ancestor(pair.second, pair.first));
+    }
+    double ancestor_walk_ms = elapsed_ms(start);
+    start = Clock::now();
+    vector<Commit *> walk_lca;
+    for (auto &pair : pairs) {
+        walk_lca.push_back(get_lca(pair.first, pair.second));
+    }
+    double lca_walk_ms = elapsed_ms(start);
+
+    ReachabilityIndex index;
+    start = Clock::now();
+    index.update(commits, branches);
+    cout << "ancestry/build\tbitmaps=" << index.bitmap_count() << "\ttime_ms=" << elapsed_ms(start) << endl;
+    set_reachability_index(&index);
+
+    size_t mismatches = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        mismatches += is_ancestor(pairs[i].second, pairs[i].first) != walk_ancestor[i];
+    }
+    double ancestor_bitmap_ms = elapsed_ms(start);
+    start = Clock::now();
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        mismatches += get_lca(pairs[i].first, pairs[i].second) != walk_lca[i];
+    }
+    double lca_bitmap_ms = elapsed_ms(start);
+    set_reachability_index(nullptr);
+
+    cout << "ancestry/is_ancestor\twalk_ms=" << ancestor_walk_ms << "\tbitmap_ms=" << ancestor_bitmap_ms
+         << "\tspeedup=" << ancestor_walk_ms / ancestor_bitmap_ms << endl;
+    cout << "ancestry/get_lca\twalk_ms=" << lca_walk_ms << "\tbitmap_ms=" << lca_bitmap_ms
+         << "\tspeedup=" << lca_walk_ms / lca_bitmap_ms << "\tmismatches=" << mismatches << endl;
+    return mismatches == 0 ? 0 : 1;
+}
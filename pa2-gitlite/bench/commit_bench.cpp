@@ -0,0 +1,160 @@
+//
+// Benchmark of reading commit files. Compares deserializing the cereal format commit files had
+// before, kept here only as the baseline, with reading the CommitFile layout in place from a mapped file.
+// Usage: commit_bench [commits] [files per commit]
+//
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+
+#include "CommitFile.h"
+#include "Diff.h"
+#include "Repository.h"
+#include "Utils.h"
+
+using namespace std;
+using path = std::filesystem::path;
+
+// The cereal format of a commit file: message, time, id, parent ids, then the tracked files
+struct CerealBlob {
+    string name;
+    ObjectId ref;
+
+    template <class Archive>
+    void serialize(Archive &archive) {
+        archive(name, ref);
+    }
+};
+
+struct CerealCommit {
+    string message;
+    string time;
+    ObjectId commit_id;
+    vector<ObjectId> parent_refs;
+    vector<CerealBlob> tracked_files;
+
+    CerealCommit() = default;
+
+    explicit CerealCommit(const Commit *commit)
+            : message(commit->message), time(commit->time), commit_id(commit->commit_id) {
+        for (Blob *blob = commit->tracked_files->head->next; blob != commit->tracked_files->head; blob = blob->next) {
+            tracked_files.push_back({blob->name.str(), blob->ref});
+        }
+    }
+
+    template <class Archive>
+    void serialize(Archive &archive) {
+        archive(message, time, commit_id, parent_refs, tracked_files);
+    }
+};
+
+static Commit *generate_commit(int index, int files) {
+    Commit *commit = new Commit;
+    commit->message = "Commit number " + to_string(index);
+    commit->time = "Wed Oct 13 10:00:00 2021\n";
+    commit->commit_id = get_sha1(commit->message, to_string(index));
+    commit->tracked_files = list_new();
+    for (int i = 0; i < files; ++i) {
+        Blob *blob = new Blob;
+        blob->name = "src/module" + to_string(i % 20) + "/file" + to_string(i) + ".cpp";
+        blob->ref = get_string_id(to_string(index * files + i));
+        list_push_back(commit->tracked_files, blob);
+    }
+    return commit;
+}
+
+template <class Read>
+static void run(const char *name, int count, Read read) {
+    auto start = chrono::steady_clock::now();
+    size_t checksum = 0;
+    for (int i = 0; i < count; ++i) {
+        checksum += read(i);
+    }
+    auto end = chrono::steady_clock::now();
+    double ms = chrono::duration<double, milli>(end - start).count();
+    cout << "commit/" << name << "\tchecksum=" << checksum << "\ttime_ms=" << ms
+         << "\tus_per_commit=" << ms * 1000 / count << endl;
+}
+
+int main(int argc, char *argv[]) {
+    int count = argc > 1 ? stoi(argv[1]) : 2000;
+    int files = argc > 2 ? stoi(argv[2]) : 500;
+
+    path dir = filesystem::temp_directory_path() / path("gitlite-commit-bench");
+    filesystem::create_directories(dir);
+    auto cereal_file = [&](int i) { return dir / path("cereal" + to_string(i)); };
+    auto view_file = [&](int i) { return dir / path("view" + to_string(i)); };
+
+    for (int i = 0; i < count; ++i) {
+        Commit *commit = generate_commit(i, files);
+        CerealCommit persistent(commit);
+        {
+            ofstream os(cereal_file(i), ios::out | ios::binary);
+            cereal::BinaryOutputArchive oarchive(os);
+            oarchive(persistent);
+        }
+
+        vector<pair<string_view, ObjectId>> entries;
+        for (Blob *blob = commit->tracked_files->head->next; blob != commit->tracked_files->head; blob = blob->next) {
+            entries.emplace_back(blob->name.str(), blob->ref);
+        }
+        string content = encode_commit(commit->commit_id, ObjectId(), commit->message, commit->time,
+                                       {}, entries);
+        write_content(view_file(i), content);
+
+        list_delete(commit->tracked_files);
+        delete commit;
+    }
+
+    cout << "commits=" << count << "\tfiles=" << files << "\tcereal_bytes=" << filesystem::file_size(cereal_file(0))
+         << "\tview_bytes=" << filesystem::file_size(view_file(0)) << endl;
+    run("cereal", count, [&](int i) {
+        ifstream is(cereal_file(i), ios::in | ios::binary);
+        CerealCommit commit;
+        cereal::BinaryInputArchive iarchive(is);
+        iarchive(commit);
+        return size_t(1);
+    });
+    run("view", count, [&](int i) {
+        MappedFile file(view_file(i));
+        CommitView view(file.view());
+        size_t checksum = view.message().size();
+        for (size_t k = 0; k < view.file_count(); ++k) {
+            checksum += view.file_name(k).size() + view.file_ref(k).bytes()[0];
+        }
+        return checksum > 0 ? size_t(1) : size_t(0);
+    });
+
+    // The same without the file system, to compare the decoding alone
+    vector<string> cereal_contents, view_contents;
+    for (int i = 0; i < count; ++i) {
+        cereal_contents.push_back(read_content(cereal_file(i)));
+        view_contents.push_back(read_content(view_file(i)));
+    }
+    run("cereal_decode", count, [&](int i) {
+        istringstream is(cereal_contents[i]);
+        CerealCommit commit;
+        cereal::BinaryInputArchive iarchive(is);
+        iarchive(commit);
+        return size_t(1);
+    });
+    run("view_decode", count, [&](int i) {
+        CommitView view(view_contents[i]);
+        size_t checksum = view.message().size();
+        for (size_t k = 0; k < view.file_count(); ++k) {
+            checksum += view.file_name(k).size() + view.file_ref(k).bytes()[0];
+        }
+        return checksum > 0 ? size_t(1) : size_t(0);
+    });
+
+    filesystem::remove_all(dir);
+    return 0;
+}
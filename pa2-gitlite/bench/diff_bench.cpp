@@ -0,0 +1,94 @@
+//
+// Benchmark of the line-level diff on large generated files.
+// Usage: diff_bench [lines] [edits]
+//
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "Diff.h"
+#include "Utils.h"
+
+using namespace std;
+using path = std::filesystem::path;
+
+// Generate a file of random lines, with some lines repeated to mimic braces and blank lines in source code
+static string generate_file(int lines, mt19937 &rng) {
+    static const string common[] = {"}\n", "\n", "    return 0;\n", "{\n"};
+    string content;
+    for (int i = 0; i < lines; ++i) {
+        if (rng() % 4 == 0) {
+            content += common[rng() % 4];
+        } else {
+            content += "line " + to_string(rng()) + "\n";
+        }
+    }
+    return content;
+}
+
+// Apply random insertions, deletions and modifications of short runs of lines
+static string mutate_file(const string &content, int edits, mt19937 &rng) {
+    vector<string_view> lines = split_lines(content);
+    vector<string> result(lines.begin(), lines.end());
+    for (int i = 0; i < edits && !result.empty(); ++i) {
+        size_t pos = rng() % result.size();
+        size_t run = 1 + rng() % 5;
+        switch (rng() % 3) {
+            case 0:
+                result.insert(result.begin() + pos, run, "inserted " + to_string(rng()) + "\n");
+                break;
+            case 1:
+                result.erase(result.begin() + pos, result.begin() + min(result.size(), pos + run));
+                break;
+            default:
+                for (size_t k = pos; k < min(result.size(), pos + run); ++k) {
+                    result[k] = "modified " + to_string(rng()) + "\n";
+                }
+        }
+    }
+    string mutated;
+    for (auto &line : result) {
+        mutated += line;
+    }
+    return mutated;
+}
+
+static void run(const char *name, DiffAlgorithm algorithm, const path &old_file, const path &new_file) {
+    auto start = chrono::steady_clock::now();
+    MappedFile old_content(old_file), new_content(new_file);
+    vector<DiffChange> changes = diff_lines(split_lines(old_content.view()), split_lines(new_content.view()),
+                                            algorithm);
+    auto end = chrono::steady_clock::now();
+
+    size_t changed = 0;
+    for (auto &change : changes) {
+        changed += change.old_count + change.new_count;
+    }
+    cout << "diff/" << name << "\tchanges=" << changes.size() << "\tchanged_lines=" << changed
+         << "\ttime_ms=" << chrono::duration<double, milli>(end - start).count() << endl;
+}
+
+int main(int argc, char *argv[]) {
+    int lines = argc > 1 ? stoi(argv[1]) : 200000;
+    int edits = argc > 2 ? stoi(argv[2]) : 1000;
+
+    mt19937 rng(2012);
+    string original = generate_file(lines, rng);
+    string modified = mutate_file(original, edits, rng);
+
+    path dir = filesystem::temp_directory_path() / path("gitlite-diff-bench");
+    filesystem::create_directories(dir);
+    path old_file = dir / path("old.txt"), new_file = dir / path("new.txt");
+    write_content(old_file, original);
+    write_content(new_file, modified);
+
+    cout << "lines=" << lines << "\tedits=" << edits << endl;
+    run("myers", DiffAlgorithm::MYERS, old_file, new_file);
+    run("histogram", DiffAlgorithm::HISTOGRAM, old_file, new_file);
+
+    filesystem::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,169 @@
+//
+// Benchmark of the sorted linked list of Commit.h. Times list_put with names inserted in sorted,
+// reverse and random order, and list_find_name, list_remove, list_copy, list_replace and list_clear
+// on sorted lists, at sizes growing tenfold up to the maximum. Most of the operations take linear
+// time per call, so a size is skipped when the time measured at the previous size, scaled by the
+// expected growth of the operation, exceeds the budget.
+// Usage: list_bench [max size] [budget ms]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Commit.h"
+#include "Utils.h"
+
+using namespace std;
+using Clock = std::chrono::steady_clock;
+
+static const int QUERIES = 100;     // calls of list_find_name and list_remove per size
+
+static vector<string> generate_names(int size) {
+    vector<string> names;
+    names.reserve(size);
+    for (int i = 0; i < size; ++i) {
+        names.push_back("src/module" + to_string(i % 100) + "/file" + to_string(i) + ".cpp");
+    }
+    return names;
+}
+
+// A list holding the names, built in linear time by appending them in sorted order
+static List *sorted_list(const vector<string> &sorted_names) {
+    List *list = list_new();
+    for (const string &name : sorted_names) {
+        Blob *blob = new Blob;
+        blob->name = name;
+        blob->ref = get_string_id("ref");
+        list_push_back(list, blob);
+    }
+    return list;
+}
+
+static void free_list(List *list) {
+    // list_delete frees the nodes and the sentinel, but not the List itself
+    list_delete(list);
+    delete list;
+}
+
+// The times of one operation in one order at the sizes measured so far
+struct Series {
+    string name;
+    string order;
+    int exponent;       // the time of the measurement grows with size^exponent
+    double last_ms = 0;
+    int last_size = 0;
+    bool skipped = false;
+};
+
+// Measure run(size) unless the projection from the previous size is over budget. run returns the
+// number of operations it timed and sets ms.
+template <class Run>
+static void measure(Series &series, int size, double budget_ms, Run run) {
+    double ratio = series.last_size == 0 ? 0 : static_cast<double>(size) / series.last_size;
+    if (series.skipped || series.last_ms * pow(ratio, series.exponent) > budget_ms) {
+        series.skipped = true;
+        cout << "list/" << series.name << "\torder=" << series.order << "\tsize=" << size << "\tstatus=skipped"
+             << endl;
+        return;
+    }
+    double ms = 0;
+    long long operations = run(size, ms);
+    cout << "list/" << series.name << "\torder=" << series.order << "\tsize=" << size << "\tstatus=ok\ttime_ms="
+         << ms << "\tns_per_op=" << ms * 1e6 / max(1LL, operations) << endl;
+    series.last_ms = ms;
+    series.last_size = size;
+}
+
+static double elapsed_ms(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    int max_size = argc > 1 ? stoi(argv[1]) : 1000000;
+    double budget_ms = argc > 2 ? stod(argv[2]) : 5000;
+
+    // Putting n names takes quadratic time, a fixed number of lookups, a copy, a replace or a clear linear time
+    vector<Series> put_series{{"put", "sorted", 2}, {"put", "reverse", 2}, {"put", "random", 2}};
+    Series find_series{"find_name", "random", 1}, remove_series{"remove", "random", 1},
+            copy_series{"copy", "sorted", 1}, replace_series{"replace", "sorted", 1}, clear_series{"clear", "sorted", 1};
+
+    mt19937 random(2021);
+    const ObjectId ref = get_string_id("ref");
+    for (int size = 1000; size <= max_size; size *= 10) {
+        vector<string> names = generate_names(size);
+        vector<string> sorted_names(names);
+        sort(sorted_names.begin(), sorted_names.end());
+
+        for (Series &series : put_series) {
+            measure(series, size, budget_ms, [&](int n, double &ms) {
+                vector<string> order = series.order == "random" ? names : sorted_names;
+                if (series.order == "reverse") {
+                    reverse(order.begin(), order.end());
+                } else if (series.order == "random") {
+                    shuffle(order.begin(), order.end(), random);
+                }
+                List *list = list_new();
+                Clock::time_point start = Clock::now();
+                for (const string &name : order) {
+                    list_put(list, name, ref);
+                }
+                ms = elapsed_ms(start);
+                free_list(list);
+                return static_cast<long long>(n);
+            });
+        }
+
+        List *list = sorted_list(sorted_names);
+        measure(find_series, size, budget_ms, [&](int n, double &ms) {
+            uniform_int_distribution<int> pick(0, n - 1);
+            size_t found = 0;
+            Clock::time_point start = Clock::now();
+            for (int i = 0; i < QUERIES; ++i) {
+                found += list_find_name(list, names[pick(random)]) != nullptr;
+            }
+            ms = elapsed_ms(start);
+            return static_cast<long long>(found);
+        });
+        measure(remove_series, size, budget_ms, [&](int n, double &ms) {
+            uniform_int_distribution<int> pick(0, n - 1);
+            vector<string> targets;
+            for (int i = 0; i < QUERIES; ++i) {
+                targets.push_back(names[pick(random)]);
+            }
+            Clock::time_point start = Clock::now();
+            for (const string &target : targets) {
+                list_remove(list, target);
+            }
+            ms = elapsed_ms(start);
+            return static_cast<long long>(targets.size());
+        });
+        measure(copy_series, size, budget_ms, [&](int n, double &ms) {
+            Clock::time_point start = Clock::now();
+            List *copy = list_copy(list);
+            ms = elapsed_ms(start);
+            free_list(copy);
+            return static_cast<long long>(n);
+        });
+        measure(replace_series, size, budget_ms, [&](int n, double &ms) {
+            List *target = sorted_list(sorted_names);
+            Clock::time_point start = Clock::now();
+            list_replace(target, list);
+            ms = elapsed_ms(start);
+            free_list(target);
+            return static_cast<long long>(n);
+        });
+        measure(clear_series, size, budget_ms, [&](int n, double &ms) {
+            Clock::time_point start = Clock::now();
+            list_clear(list);
+            ms = elapsed_ms(start);
+            return static_cast<long long>(n);
+        });
+        free_list(list);
+    }
+    return 0;
+}
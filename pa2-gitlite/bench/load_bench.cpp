@@ -0,0 +1,103 @@
+//
+// Benchmark of loading the commits of a repository. Writes a synthetic .gitlite/commits with
+// the usual 256 shard directories, then reads and links it with an increasing number of threads.
+// Usage: load_bench [commits] [files per commit] [max threads]
+//
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "CommitFile.h"
+#include "CommitLoader.h"
+#include "Utils.h"
+
+using namespace std;
+using path = std::filesystem::path;
+
+// A first-parent chain where every tenth commit merges in a side commit. Each commit changes
+// one file, the others keep the blob they had in the parent as in a real history.
+static void generate_repository(const path &commits_dir, int count, int files) {
+    vector<ObjectId> ids;
+    vector<ObjectId> refs;
+    for (int k = 0; k < files; ++k) {
+        refs.push_back(get_string_id(to_string(k)));
+    }
+    for (int i = 0; i < count; ++i) {
+        string message = "Commit number " + to_string(i);
+        ObjectId id = get_sha1(message, to_string(i));
+        vector<ObjectId> parents;
+        if (i > 0)
+            parents.push_back(ids[i - 1]);
+        if (i % 10 == 9 && i > 1)
+            parents.push_back(ids[i - 2]);
+
+        vector<string> names;
+        vector<pair<string_view, ObjectId>> entries;
+        for (int k = 0; k < files; ++k) {
+            names.push_back("src/module" + to_string(k % 20) + "/file" + to_string(k) + ".cpp");
+        }
+        refs[i % files] = get_string_id(to_string(i * files + i % files));
+        for (int k = 0; k < files; ++k) {
+            entries.emplace_back(names[k], refs[k]);
+        }
+
+        string hex = id.to_hex();
+        path shard = commits_dir / path(hex.substr(0, 2));
+        filesystem::create_directories(shard);
+        write_content(shard / path(hex), encode_commit(id, ObjectId(), message, "Wed Oct 13 10:00:00 2021\n", parents, entries));
+        ids.push_back(id);
+    }
+}
+
+static void free_commits(const vector<LoadedCommit> &loaded) {
+    for (const LoadedCommit &entry : loaded) {
+        list_delete(entry.commit->tracked_files);
+        delete entry.commit->tracked_files;
+        delete entry.commit;
+    }
+}
+
+static double run(const path &commits_dir, unsigned threads, double serial_ms) {
+    auto start = chrono::steady_clock::now();
+    vector<LoadedCommit> loaded = load_commit_files(commits_dir, threads);
+    auto decoded = chrono::steady_clock::now();
+    unordered_map<ObjectId, Commit *> commits;
+    link_commits(loaded, commits);
+    auto end = chrono::steady_clock::now();
+
+    double ms = chrono::duration<double, milli>(end - start).count();
+    cout << "load/threads=" << threads << "\tcommits=" << commits.size()
+         << "\tdecode_ms=" << chrono::duration<double, milli>(decoded - start).count()
+         << "\tlink_ms=" << chrono::duration<double, milli>(end - decoded).count()
+         << "\ttime_ms=" << ms << "\tspeedup=" << (serial_ms > 0 ? serial_ms / ms : 1.0) << endl;
+    free_commits(loaded);
+    return ms;
+}
+
+int main(int argc, char *argv[]) {
+    int count = argc > 1 ? stoi(argv[1]) : 100000;
+    int files = argc > 2 ? stoi(argv[2]) : 10;
+
+    path dir = filesystem::temp_directory_path() / path("gitlite-load-bench");
+    filesystem::remove_all(dir);
+    generate_repository(dir, count, files);
+
+    // Read everything once so every run finds the files in the page cache
+    free_commits(load_commit_files(dir, 1));
+    unsigned cores = argc > 3 ? static_cast<unsigned>(stoi(argv[3])) : max(1u, thread::hardware_concurrency());
+    double serial_ms = run(dir, 1, 0);
+    for (unsigned threads = 2; threads <= cores; threads *= 2) {
+        run(dir, threads, serial_ms);
+    }
+    if ((cores & (cores - 1)) != 0) {
+        run(dir, cores, serial_ms);
+    }
+
+    filesystem::remove_all(dir);
+    return 0;
+}
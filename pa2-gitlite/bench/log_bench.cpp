@@ -0,0 +1,93 @@
+//
+// Benchmark of log rendering to a file. Compares flushing every line with std::endl, as
+// commit_print used to, with the buffered formatter, for the standard and a one-line format.
+// Usage: log_bench [commits]
+//
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Commit.h"
+#include "LogFormat.h"
+#include "Utils.h"
+
+using namespace std;
+using path = std::filesystem::path;
+
+// A first-parent chain where every tenth commit merges in a side commit
+static vector<Commit *> generate_history(int count) {
+    vector<Commit *> commits;
+    Commit *parent = nullptr;
+    for (int i = 0; i < count; ++i) {
+        Commit *commit = new Commit;
+        commit->message = "Commit number " + to_string(i);
+        commit->time = "Wed Oct 13 10:00:00 2021\n";
+        commit->commit_id = get_sha1(commit->message, to_string(i));
+        commit->parent = parent;
+        if (i % 10 == 9 && parent != nullptr) {
+            commit->second_parent = parent->parent;
+        }
+        commits.push_back(commit);
+        parent = commit;
+    }
+    return commits;
+}
+
+// The output of log before it was buffered
+static void print_unbuffered(ostream &os, const Commit *head) {
+    for (const Commit *commit = head; commit != nullptr; commit = commit->parent) {
+        os << "===" << endl;
+        os << "commit " << commit->commit_id << endl;
+        if (commit->second_parent != nullptr) {
+            os << "Merge: " << commit->parent->commit_id.to_hex().substr(0, 7)
+               << " " << commit->second_parent->commit_id.to_hex().substr(0, 7) << endl;
+        }
+        os << "Date: " << commit->time << endl << commit->message;
+        os << endl << endl;
+    }
+}
+
+static void print_buffered(ostream &os, const Commit *head, const LogFormat &format) {
+    OutputBuffer out(os);
+    for (const Commit *commit = head; commit != nullptr; commit = commit->parent) {
+        format.render(commit, out.buffer());
+        out.maybe_flush();
+    }
+}
+
+template <class Print>
+static void run(const char *name, const path &file, Print print) {
+    auto start = chrono::steady_clock::now();
+    {
+        ofstream os(file, ios::out | ios::binary | ios::trunc);
+        print(os);
+    }
+    auto end = chrono::steady_clock::now();
+
+    double ms = chrono::duration<double, milli>(end - start).count();
+    double mb = static_cast<double>(filesystem::file_size(file)) / (1 << 20);
+    cout << "log/" << name << "\tbytes=" << filesystem::file_size(file) << "\ttime_ms=" << ms
+         << "\tmb_per_s=" << mb / (ms / 1000) << endl;
+}
+
+int main(int argc, char *argv[]) {
+    int count = argc > 1 ? stoi(argv[1]) : 100000;
+    vector<Commit *> commits = generate_history(count);
+    const Commit *head = commits.back();
+
+    path file = filesystem::temp_directory_path() / path("gitlite-log-bench.txt");
+    cout << "commits=" << count << endl;
+    run("endl", file, [&](ostream &os) { print_unbuffered(os, head); });
+    run("buffered", file, [&](ostream &os) { print_buffered(os, head, LogFormat::log_entry()); });
+    run("oneline", file, [&](ostream &os) { print_buffered(os, head, LogFormat::compile("%h %s\n")); });
+
+    filesystem::remove(file);
+    for (Commit *commit : commits) {
+        delete commit;
+    }
+    return 0;
+}
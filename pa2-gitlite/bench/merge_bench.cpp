@@ -0,0 +1,94 @@
+//
+// Benchmark of merge classification on two branches with many tracked files.
+// Compares the single-pass planner with looking up every file in the three lists.
+// Usage: merge_bench [files]
+//
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "Commit.h"
+#include "MergePlan.h"
+#include "Utils.h"
+
+using namespace std;
+
+// Lists are filled in sorted order with list_push_back, as list_put would take quadratic time
+static Blob *new_blob(const string &name, const ObjectId &ref) {
+    Blob *blob = new Blob;
+    blob->name = name;
+    blob->ref = ref;
+    return blob;
+}
+
+static string file_name(int i) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "src/file%08d.cpp", i);
+    return buf;
+}
+
+// Lookup-based classification, as merge would do with list_find_name for every file
+static size_t classify_by_lookup(const List *split, const List *current, const List *given) {
+    size_t changed = 0;
+    auto check = [&](const List *list) {
+        for (Blob *blob = list->head->next; blob != list->head; blob = blob->next) {
+            Blob *s = list_find_name(split, blob->name);
+            Blob *c = list_find_name(current, blob->name);
+            Blob *g = list_find_name(given, blob->name);
+            if (!(s && c && g && s->ref == c->ref && s->ref == g->ref))
+                ++changed;
+        }
+    };
+    check(split);
+    check(current);
+    check(given);
+    return changed;
+}
+
+int main(int argc, char *argv[]) {
+    int files = argc > 1 ? stoi(argv[1]) : 100000;
+    mt19937 rng(2012);
+
+    List *split = list_new(), *current = list_new(), *given = list_new();
+    for (int i = 0; i < files; ++i) {
+        string name = file_name(i);
+        ObjectId ref = get_string_id(to_string(rng()));
+        list_push_back(split, new_blob(name, ref));
+        // About 5% of the files are touched on each branch, some are removed or added
+        unsigned r = rng() % 100;
+        if (r != 0)
+            list_push_back(current, new_blob(name, r < 5 ? get_string_id(to_string(rng())) : ref));
+        r = rng() % 100;
+        if (r != 0)
+            list_push_back(given, new_blob(name, r < 5 ? get_string_id(to_string(rng())) : ref));
+    }
+    for (int i = files; i < files + files / 100; ++i) {
+        list_push_back(rng() % 2 ? current : given, new_blob(file_name(i), get_string_id(to_string(rng()))));
+    }
+
+    auto start = chrono::steady_clock::now();
+    vector<MergeEntry> plan = plan_merge(split, current, given);
+    auto end = chrono::steady_clock::now();
+
+    size_t counts[4] = {};
+    for (auto &entry : plan) {
+        ++counts[static_cast<int>(entry.action)];
+    }
+    cout << "files=" << files << endl;
+    cout << "merge/plan\tentries=" << plan.size() << "\tkeep=" << counts[0] << "\ttake=" << counts[1]
+         << "\tremove=" << counts[2] << "\tconflict=" << counts[3]
+         << "\ttime_ms=" << chrono::duration<double, milli>(end - start).count() << endl;
+
+    // The lookup version is quadratic, only run it where it finishes in reasonable time
+    if (files <= 5000) {
+        start = chrono::steady_clock::now();
+        size_t changed = classify_by_lookup(split, current, given);
+        end = chrono::steady_clock::now();
+        cout << "merge/lookup\tchanged=" << changed
+             << "\ttime_ms=" << chrono::duration<double, milli>(end - start).count() << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,361 @@
+//
+// Benchmark of the gitlite commands on synthetic repositories. A deterministic generator writes a
+// repository of a given shape (files, file size, commits, branches, merge density), then every
+// command is timed in a child process on its own copy, so a command that crashes or changes the
+// repository does not affect the others. Each result is one line of tab-separated key=value pairs,
+// with status=failed for a command that reports an error and status=crashed for one that crashes.
+// Usage: repo_bench [small|medium|large]... or
+//        repo_bench --files N --size BYTES --commits N --branches N --merges RATIO
+//
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "Repository.h"
+#include "Utils.h"
+
+using namespace std;
+using path = std::filesystem::path;
+using Clock = std::chrono::steady_clock;
+
+struct RepoShape {
+    string name;
+    int files;
+    int file_size;          // bytes per file
+    int commits;
+    int branches;           // besides master
+    double merge_density;   // chance that a commit merges the head of another branch
+};
+
+static const RepoShape SCALES[] = {
+        {"small", 100, 1024, 50, 4, 0.1},
+        {"medium", 1000, 1024, 200, 16, 0.1},
+        {"large", 4000, 1024, 500, 64, 0.1},
+};
+
+static string file_name(int file) {
+    return "dir" + to_string(file % 32) + "/file" + to_string(file) + ".txt";
+}
+
+static string file_content(int file, int version, int size) {
+    string content;
+    for (int line = 0; static_cast<int>(content.size()) < size; ++line) {
+        content += "file " + to_string(file) + " version " + to_string(version) + " line " + to_string(line) + "\n";
+    }
+    return content;
+}
+
+// A commit with the version of every file in it
+struct GeneratedCommit {
+    Commit *commit;
+    vector<int> versions;
+};
+
+// Write a repository of the given shape into root. The same shape always gives the same repository.
+static void generate_repository(const path &root, const RepoShape &shape) {
+    Repository repository(root);
+    repository.make_file_structure();
+    mt19937 random(2021);
+
+    vector<int> order(shape.files);     // the files sorted by name, as in the lists of tracked files
+    for (int i = 0; i < shape.files; ++i)
+        order[i] = i;
+    sort(order.begin(), order.end(), [](int a, int b) { return file_name(a) < file_name(b); });
+
+    int next_version = 0;
+    auto store_blob = [&](int file, int version) {
+        string content = file_content(file, version, shape.file_size);
+        ObjectId ref = get_string_id(content);
+        write_content(repository.BLOBS / path(ref.to_hex()), content);
+        return ref;
+    };
+    vector<ObjectId> refs;    // ref of every version of every file, indexed by version
+    auto make_commit = [&](const string &message, int index, const vector<int> &versions) {
+        time_t time = 1634090400 + index * 60;
+        Commit *commit = new Commit;
+        commit->message = message;
+        commit->time = ctime(&time);
+        commit->commit_id = get_sha1(commit->message, commit->time);
+        commit->tracked_files = list_new();
+        for (int file : order) {
+            Blob *blob = new Blob;
+            blob->name = file_name(file);
+            blob->ref = refs[versions[file]];
+            list_push_back(commit->tracked_files, blob);
+        }
+        return commit;
+    };
+
+    vector<int> versions(shape.files);
+    for (int file = 0; file < shape.files; ++file) {
+        versions[file] = next_version++;
+        refs.push_back(store_blob(file, versions[file]));
+    }
+    vector<GeneratedCommit> heads{{make_commit("initial commit", 0, versions), versions}};
+    vector<string> names{"master"};
+    vector<Commit *> all{heads[0].commit};
+
+    uniform_real_distribution<double> chance(0, 1);
+    int changes = max(1, shape.files / 50);
+    for (int i = 1; i < shape.commits; ++i) {
+        // Branches fork from master at regular intervals
+        if (static_cast<int>(names.size()) <= shape.branches && i % max(1, shape.commits / (shape.branches + 1)) == 0) {
+            heads.push_back(heads[0]);
+            names.push_back("b" + to_string(names.size()));
+        }
+        size_t branch = random() % heads.size();
+        GeneratedCommit next = heads[branch];
+        Commit *second_parent = nullptr;
+        if (heads.size() > 1 && chance(random) < shape.merge_density) {
+            size_t other = (branch + 1 + random() % (heads.size() - 1)) % heads.size();
+            if (heads[other].commit != next.commit) {
+                second_parent = heads[other].commit;
+                for (int file = 0; file < shape.files; ++file)
+                    next.versions[file] = max(next.versions[file], heads[other].versions[file]);
+            }
+        }
+        for (int k = 0; k < changes; ++k) {
+            int file = static_cast<int>(random() % shape.files);
+            next.versions[file] = next_version++;
+            refs.push_back(store_blob(file, next.versions[file]));
+        }
+        Commit *parent = next.commit;
+        next.commit = make_commit("Commit " + to_string(i) + " on " + names[branch], i, next.versions);
+        next.commit->parent = parent;
+        next.commit->second_parent = second_parent;
+        heads[branch] = next;
+        all.push_back(next.commit);
+    }
+
+    TreeStore trees(repository.TREES);
+    for (Commit *commit : all) {
+        commit->tree_id = trees.build(commit->tracked_files);
+        trees.save(commit->tree_id);
+        PersistentCommit(commit).commit(repository.COMMITS);
+    }
+    for (size_t i = 0; i < heads.size(); ++i) {
+        write_content(repository.REFS / path(names[i]), heads[i].commit->commit_id.to_hex());
+    }
+    write_content(repository.HEAD, "master");
+
+    // Check out master, with nothing staged
+    for (int file = 0; file < shape.files; ++file) {
+        path target = root / path(file_name(file));
+        filesystem::create_directories(target.parent_path());
+        write_content(target, file_content(file, heads[0].versions[file], shape.file_size));
+    }
+    List *staged = list_new();
+    write_file_list(repository.TREE, heads[0].commit->tracked_files);
+    write_file_list(repository.STAGE, staged);
+    list_delete(staged);
+    delete staged;
+    for (Commit *commit : all) {
+        list_delete(commit->tracked_files);
+        delete commit->tracked_files;
+        delete commit;
+    }
+}
+
+// Copy the repository for a command that may change it. Commit files and blobs are never rewritten,
+// so they are linked instead of copied.
+static void copy_repository(const path &from, const path &to) {
+    for (auto iter = filesystem::recursive_directory_iterator(from); iter != filesystem::recursive_directory_iterator();
+         ++iter) {
+        path relative = filesystem::relative(iter->path(), from);
+        path target = to / relative;
+        if (iter->is_directory()) {
+            filesystem::create_directories(target);
+        } else if (relative.begin()->string() == ".gitlite"
+                   && (relative.parent_path().filename() == "blobs" || relative.parent_path().parent_path().filename() == "commits")) {
+            filesystem::create_hard_link(iter->path(), target);
+        } else {
+            filesystem::copy_file(iter->path(), target);
+        }
+    }
+}
+
+struct Timing {
+    bool succeeded = false;
+    double load_ms = 0, command_ms = 0, close_ms = 0;
+};
+
+static string format_result(const Timing &timing) {
+    return string(timing.succeeded ? "status=ok" : "status=failed") + "\tload_ms=" + to_string(timing.load_ms)
+           + "\ttime_ms=" + to_string(timing.command_ms) + "\tclose_ms=" + to_string(timing.close_ms);
+}
+
+// Load the repository, run the setup commands untimed and then the command, with their output
+// discarded, and close the repository
+static Timing time_command(const path &root, const vector<vector<string>> &setup, const vector<string> &args,
+                           bool load) {
+    Timing timing;
+    Repository repository(root);
+    Clock::time_point start = Clock::now();
+    if (load) {
+        repository.load_repository();
+    }
+    Clock::time_point loaded = Clock::now();
+    streambuf *original_output_buffer = cout.rdbuf();
+    ostringstream discarded;
+    cout.rdbuf(discarded.rdbuf());
+    bool ready = true;
+    for (const vector<string> &command : setup) {
+        ready = ready && parse_args(repository, command);
+    }
+    Clock::time_point prepared = Clock::now();
+    timing.succeeded = ready && parse_args(repository, args);
+    cout.rdbuf(original_output_buffer);
+    Clock::time_point ran = Clock::now();
+    repository.close();
+    Clock::time_point closed = Clock::now();
+    timing.load_ms = chrono::duration<double, milli>(loaded - start).count();
+    timing.command_ms = chrono::duration<double, milli>(ran - prepared).count();
+    timing.close_ms = chrono::duration<double, milli>(closed - ran).count();
+    return timing;
+}
+
+struct Operation {
+    string name;
+    vector<string> args;
+    bool changes_repository;
+    bool needs_repository;
+    vector<vector<string>> setup;   // commands run before the timed one
+};
+
+static void run_operation(const RepoShape &shape, const path &repo, const path &scratch, const Operation &operation) {
+    path root = repo;
+    if (!operation.needs_repository) {
+        root = scratch / path(operation.name);
+        filesystem::create_directories(root);
+    } else if (operation.changes_repository) {
+        root = scratch / path(operation.name);
+        copy_repository(repo, root);
+    }
+    if (operation.name == "add" || operation.name == "commit") {
+        write_content(root / path(file_name(0)), "changed by the benchmark\n");
+    }
+
+    string result;
+#ifndef _WIN32
+    // Run in a child process, so a command that crashes is reported instead of ending the benchmark
+    int fds[2];
+    if (pipe(fds) != 0) {
+        throw std::runtime_error("failed to create a pipe");
+    }
+    cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        ::close(fds[0]);
+        string line = format_result(time_command(root, operation.setup, operation.args, operation.needs_repository));
+        ssize_t written = write(fds[1], line.data(), line.size());
+        _exit(written == static_cast<ssize_t>(line.size()) ? 0 : 1);
+    }
+    ::close(fds[1]);
+    char buffer[256];
+    ssize_t count;
+    while ((count = read(fds[0], buffer, sizeof(buffer))) > 0) {
+        result.append(buffer, static_cast<size_t>(count));
+    }
+    ::close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (WIFSIGNALED(status)) {
+        result = "status=crashed\tsignal=" + to_string(WTERMSIG(status));
+    } else if (result.empty()) {
+        result = "status=failed";
+    }
+#else
+    result = format_result(time_command(root, operation.setup, operation.args, operation.needs_repository));
+#endif
+    cout << "repo/" << operation.name << "\tscale=" << shape.name << "\tfiles=" << shape.files
+         << "\tcommits=" << shape.commits << "\tbranches=" << shape.branches << "\t" << result << endl;
+    if (root != repo) {
+        filesystem::remove_all(root);
+    }
+}
+
+static void run_scale(const RepoShape &shape, const path &dir) {
+    path repo = dir / path(shape.name);
+    path scratch = dir / path(shape.name + "-scratch");
+    filesystem::remove_all(repo);
+    filesystem::create_directories(repo);
+    Clock::time_point start = Clock::now();
+    generate_repository(repo, shape);
+    cout << "repo/generate\tscale=" << shape.name << "\tfiles=" << shape.files << "\tcommits=" << shape.commits
+         << "\tbranches=" << shape.branches << "\tstatus=ok\ttime_ms="
+         << chrono::duration<double, milli>(Clock::now() - start).count() << endl;
+
+    const Operation operations[] = {
+            {"init", {"init"}, true, false, {}},
+            {"add", {"add", file_name(0)}, true, true, {}},
+            {"commit", {"commit", "benchmark"}, true, true, {{"add", file_name(0)}}},
+            {"status", {"status"}, false, true, {}},
+            {"checkout", {"checkout", "b1"}, true, true, {}},
+            {"merge", {"merge", "b1"}, true, true, {}},
+            {"log", {"log"}, false, true, {}},
+            {"global-log", {"global-log"}, false, true, {}},
+            {"find", {"find", "--grep", "on b1$"}, false, true, {}},
+    };
+    for (const Operation &operation : operations) {
+        run_operation(shape, repo, scratch, operation);
+    }
+    filesystem::remove_all(repo);
+    filesystem::remove_all(scratch);
+}
+
+int main(int argc, char *argv[]) {
+    vector<string> args(argv + 1, argv + argc);
+    vector<RepoShape> shapes;
+    if (!args.empty() && args[0].rfind("--", 0) == 0) {
+        RepoShape shape{"custom", 100, 1024, 50, 4, 0.1};
+        for (size_t i = 0; i + 1 < args.size(); i += 2) {
+            if (args[i] == "--files") {
+                shape.files = stoi(args[i + 1]);
+            } else if (args[i] == "--size") {
+                shape.file_size = stoi(args[i + 1]);
+            } else if (args[i] == "--commits") {
+                shape.commits = stoi(args[i + 1]);
+            } else if (args[i] == "--branches") {
+                shape.branches = stoi(args[i + 1]);
+            } else if (args[i] == "--merges") {
+                shape.merge_density = stod(args[i + 1]);
+            } else {
+                cerr << "unknown option " << args[i] << endl;
+                return 1;
+            }
+        }
+        shapes.push_back(shape);
+    } else {
+        if (args.empty()) {
+            args = {"small", "medium"};
+        }
+        for (const string &name : args) {
+            auto shape = find_if(begin(SCALES), end(SCALES), [&name](const RepoShape &s) { return s.name == name; });
+            if (shape == end(SCALES)) {
+                cerr << "unknown scale " << name << endl;
+                return 1;
+            }
+            shapes.push_back(*shape);
+        }
+    }
+
+    path dir = filesystem::temp_directory_path() / path("gitlite-repo-bench");
+    for (const RepoShape &shape : shapes) {
+        run_scale(shape, dir);
+    }
+    filesystem::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,152 @@
+//
+// Benchmark of the Tester on a long generated script. Compares substituting every line with a regex
+// per variable and compiling every expected output, as the Tester used to, with running the script
+// through the precompiled Tester.
+// Usage: tester_bench [commands]
+//
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Repository.h"
+#include "Tester.h"
+
+using namespace std;
+using path = std::filesystem::path;
+
+static const string OUTPUT = "No command with that name exists.\n";
+
+// Commands with a literal output, with variables, and with captured groups used by the next command
+static string generate_script(int count) {
+    string script = "D NOCMD \"No command\"\n"
+                    "D ARBLINE \"[^\\n]*(?=\\n|$)\"\n"
+                    "D ARBLINES \"(?:(?:.|\\n)*(?:\\n|$)|^|$)\"\n\n";
+    for (int i = 0; i < count; ++i) {
+        script += "> foo\n";
+        switch (i % 4) {
+            case 0:
+                script += "No command with that name exists.\n";
+                break;
+            case 1:
+                script += "${NOCMD} ${ARBLINE}\n";
+                break;
+            case 2:
+                script += "(No) command ${ARBLINES}\n";
+                break;
+            default:
+                script += "${1} command with that name exists.\n";
+                break;
+        }
+        script += "<<<\n\n";
+    }
+    return script;
+}
+
+// How the Tester used to handle a script: a regex for every variable on every line,
+// and a regex compiled from the expected output of every command
+static bool run_unprecompiled(const string &script) {
+    static const regex VAR_PATTERN(R"((\$\{.*?\}))");
+    static const regex DEF_PATTERN(R"#(^D\s*([a-zA-Z_][a-zA-Z_0-9]*)\s*"(.*)"\s*$)#");
+    unordered_map<string, string> defs, last_group;
+    auto substitute_once = [&](const string &raw) {
+        unordered_set<string> variables;
+        for (auto iter = sregex_iterator(raw.begin(), raw.end(), VAR_PATTERN); iter != sregex_iterator(); ++iter) {
+            variables.insert((*iter)[1].str());
+        }
+        string substituted(raw);
+        for (auto &var : variables) {
+            string varname = var.substr(2, var.length() - 3);
+            auto iter = last_group.find(varname);
+            if (iter == last_group.end()) {
+                iter = defs.find(varname);
+                if (iter == defs.end()) {
+                    continue;
+                }
+            }
+            substituted = regex_replace(substituted, regex(R"(\$\{)" + varname + R"(\})"), iter->second);
+        }
+        return substituted;
+    };
+    auto substitute = [&](const string &raw) {
+        string result = substitute_once(raw), tmp;
+        for (int depth = 0; result != raw && (tmp = substitute_once(result)) != result && depth < 3; ++depth) {
+            result = tmp;
+        }
+        return result;
+    };
+
+    istringstream is(script);
+    string line;
+    while (getline(is, line)) {
+        line = regex_replace(line, regex(R"(\r)"), "");
+        if (line.empty()) {
+            continue;
+        }
+        line = substitute(line);
+        smatch match;
+        if (line[0] == 'D' && regex_match(line, match, DEF_PATTERN)) {
+            defs.insert({match[1], match[2]});
+            continue;
+        }
+        string expected_output;
+        while (getline(is, line) && (line = substitute(line)) != "<<<") {
+            expected_output += expected_output.empty() ? line : "\n" + line;
+        }
+        last_group.clear();
+        string actual = regex_replace(OUTPUT, regex(R"([ \t]+\n)"), "\n");
+        expected_output = regex_replace(expected_output, regex(R"([ \t]+\n)"), "\n");
+        string trimmed_actual = actual.substr(0, actual.size() - 1);
+        if (!regex_match(actual, match, regex(expected_output))
+            && !regex_match(trimmed_actual, match, regex(expected_output))) {
+            return false;
+        }
+        for (unsigned int i = 1; i < match.size(); i++) {
+            last_group.insert({to_string(i), match[i].str()});
+        }
+    }
+    return true;
+}
+
+template <class Run>
+static void run(const char *name, int count, Run run) {
+    auto start = chrono::steady_clock::now();
+    bool passed = run();
+    auto end = chrono::steady_clock::now();
+    double ms = chrono::duration<double, milli>(end - start).count();
+    cout << "tester/" << name << "\tpassed=" << passed << "\ttime_ms=" << ms
+         << "\tus_per_command=" << ms * 1000 / count << endl;
+}
+
+int main(int argc, char *argv[]) {
+    int count = argc > 1 ? stoi(argv[1]) : 4000;
+
+    path dir = filesystem::temp_directory_path() / path("gitlite-tester-bench");
+    filesystem::create_directories(dir);
+    path file = dir / path("bench.in");
+    string script = generate_script(count);
+    ofstream(file) << script;
+
+    run("unprecompiled", count, [&] { return run_unprecompiled(script); });
+    run("precompiled", count, [&] {
+        // Silence the Tester, only the time is of interest
+        streambuf *original_output_buffer = cout.rdbuf();
+        ostringstream discarded;
+        cout.rdbuf(discarded.rdbuf());
+        Repository repository(dir);
+        Tester tester(file.string(), repository);
+        bool passed = tester.run();
+        cout.rdbuf(original_output_buffer);
+        return passed;
+    });
+
+    filesystem::remove_all(dir);
+    return 0;
+}
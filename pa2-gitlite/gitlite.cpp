@@ -1,6 +1,16 @@
 #include "gitlite.h"
+#include "LogFormat.h"
+#include "MergePlan.h"
+#include "Reachability.h"
+#include "Refs.h"
+#include "Rename.h"
+#include "Tree.h"
 #include "Utils.h"
 
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+
 using namespace std;
 
 const string msg_initial_commit = "initial commit";
@@ -33,6 +43,8 @@ const string msg_fast_forward = "Current branch fast-forwarded.";
 
 const string msg_encountered_merge_conflict = "Encountered a merge conflict.";
 
+const string msg_octopus_conflict = "Octopus merge has conflicting changes; merge the branches one at a time.";
+
 const string status_branches_header = "=== Branches ===";
 
 const string status_staged_files_header = "=== Staged Files ===";
@@ -45,6 +57,12 @@ const string msg_status_deleted = " (deleted)";
 
 const string msg_status_modified = " (modified)";
 
+const string msg_status_renamed_from = " (renamed from ";
+
+const string msg_status_copied_from = " (copied from ";
+
+const string msg_status_renamed_to = " (renamed to ";
+
 const string status_untracked_files_header = "=== Untracked Files ===";
 
 string get_merge_commit_message(const Blob *given_branch, const Blob *current_branch) {
@@ -52,54 +70,555 @@ string get_merge_commit_message(const Blob *given_branch, const Blob *current_br
     return message;
 }
 
-void init(Blob *&current_branch, List *&branches, List *&staged_files, List *&tracked_files, Commit *&head_commit) {
+string get_merge_commit_message(const std::vector<Blob *> &given_branches, const Blob *current_branch) {
+    string message("Merged ");
+    for (size_t i = 0; i < given_branches.size(); ++i) {
+        if (i > 0)
+            message += i + 1 == given_branches.size() ? " and " : ", ";
+        message += given_branches[i]->name;
+    }
+    return message + " into " + current_branch->name + ".";
+}
+
+// Whether the tracked files differ from the files in the commit, i.e. there are staged removals
+static bool tracking_changed(const List *tracked_files, const Commit *commit);
 
+void init(Blob *&current_branch, List *&branches, List *&staged_files, List *&tracked_files, Commit *&head_commit) {
+    head_commit = new Commit;
+    head_commit->message = msg_initial_commit;
+    head_commit->time = get_time_string();
+    head_commit->commit_id = get_sha1(head_commit->message, head_commit->time);
+    head_commit->tracked_files = list_new();
+
+    branches = list_new();
+    current_branch = list_put(branches, "master", head_commit);
+    staged_files = list_new();
+    tracked_files = list_new();
 }
 
 bool add(const string &filename, List *staged_files, List *tracked_files, const Commit *head_commit) {
-    return false;
+    ObjectId ref = get_sha1(filename);
+    Blob *committed = list_find_name(head_commit->tracked_files, filename);
+    if (committed != nullptr && committed->ref == ref) {
+        // Same as the current commit, nothing to stage, and a pending removal is undone
+        list_remove(staged_files, filename);
+        list_put(tracked_files, filename, ref);
+        return false;
+    }
+    list_put(staged_files, filename, ref);
+    list_put(tracked_files, filename, ref);
+    return true;
 }
 
 bool commit(const string &message, Blob *current_branch, List *staged_files, List *tracked_files, Commit *&head_commit) {
-    return false;
+    if (list_size(staged_files) == 0 && !tracking_changed(tracked_files, head_commit)) {
+        cout << msg_no_changes_added << endl;
+        return false;
+    }
+
+    auto *new_commit = new Commit;
+    new_commit->message = message;
+    new_commit->time = get_time_string();
+    new_commit->commit_id = get_sha1(new_commit->message, new_commit->time);
+    new_commit->parent = head_commit;
+    new_commit->tracked_files = list_copy(tracked_files);
+    head_commit = new_commit;
+    current_branch->commit = new_commit;
+    list_clear(staged_files);
+    return true;
 }
 
 bool remove(const string &filename, List* staged_files, List *tracked_files, const Commit *head_commit) {
-    return false;
+    bool staged = list_remove(staged_files, filename);
+    if (list_find_name(head_commit->tracked_files, filename) != nullptr) {
+        list_remove(tracked_files, filename);
+        restricted_delete(filename);
+        return true;
+    }
+    if (!staged) {
+        cout << msg_no_reason_remove << endl;
+        return false;
+    }
+    list_remove(tracked_files, filename);
+    return true;
 }
 
 void log(const Commit *head_commit) {
+    log(head_commit, LogFormat::log_entry());
+}
 
+// Print the first-parent history, buffering the output instead of flushing every line
+void log(const Commit *head_commit, const LogFormat &format) {
+    OutputBuffer out(cout);
+    for (const Commit *commit = head_commit; commit != nullptr; commit = commit->parent) {
+        format.render(commit, out.buffer());
+        out.maybe_flush();
+    }
+}
+
+// Pair added files with the files they were renamed or copied from, by the name of the added file
+static unordered_map<string, RenamePair> pair_renames(const vector<RenameCandidate> &deleted,
+                                                      const vector<RenameCandidate> &added,
+                                                      const vector<RenameCandidate> &modified) {
+    unordered_map<string, RenamePair> renames;
+    if (added.empty() || (deleted.empty() && modified.empty()))
+        return renames;
+    for (auto &rename : detect_renames(deleted, added, modified)) {
+        renames.emplace(rename.new_name, rename);
+    }
+    return renames;
+}
+
+static void print_status_name(const string &name, const unordered_map<string, RenamePair> &renames) {
+    cout << name;
+    auto rename = renames.find(name);
+    if (rename != renames.end())
+        cout << (rename->second.copy ? msg_status_copied_from : msg_status_renamed_from) << rename->second.old_name << ')';
+    cout << endl;
 }
 
 void status(const Blob *current_branch, const List *branches, const List *staged_files, const List *tracked_files,
             const List *cwd_files, const Commit *head_commit) {
-
+    cout << status_branches_header << endl;
+    for (const Blob *branch = branches->head->next; branch != branches->head; branch = branch->next) {
+        if (branch == current_branch)
+            cout << '*';
+        cout << branch->name << endl;
+    }
+
+    // The changes staged since the head commit, only looking into the directories that changed.
+    // Added files are paired with the removed files they were renamed from, or the modified ones
+    // they were copied from.
+    const std::filesystem::path gitlite_dir = work_tree() / ".gitlite";
+    vector<RenameCandidate> removed, added, modified;
+    TreeStore &trees = tree_store();
+    diff_trees(trees, trees.tree_of(head_commit), trees.build(tracked_files),
+               [&](const string &name, const ObjectId &old_ref, const ObjectId &new_ref) {
+                   if (old_ref.is_null()) {
+                       added.push_back({name, new_ref, gitlite_dir / "index" / name});
+                   } else if (new_ref.is_null()) {
+                       removed.push_back({name, old_ref, gitlite_dir / "blobs" / old_ref.to_hex()});
+                   } else {
+                       modified.push_back({name, old_ref, gitlite_dir / "blobs" / old_ref.to_hex()});
+                   }
+               });
+    unordered_map<string, RenamePair> staged_renames = pair_renames(removed, added, modified);
+
+    cout << endl << status_staged_files_header << endl;
+    for (const Blob *blob = staged_files->head->next; blob != staged_files->head; blob = blob->next) {
+        print_status_name(blob->name, staged_renames);
+    }
+
+    cout << endl << status_removed_files_header << endl;
+    unordered_map<string, string> renamed_to;
+    for (auto &rename : staged_renames) {
+        if (!rename.second.copy)
+            renamed_to[rename.second.old_name] = rename.first;
+    }
+    for (const RenameCandidate &file : removed) {
+        auto rename = renamed_to.find(file.name);
+        cout << file.name;
+        if (rename != renamed_to.end())
+            cout << msg_status_renamed_to << rename->second << ')';
+        cout << endl;
+    }
+
+    // Both lists are sorted by name, so one cursor walks the files in CWD alongside the tracked files.
+    // A file in CWD comes with the hash of its content if it is known already.
+    cout << endl << status_modifications_not_staged_header << endl;
+    vector<RenameCandidate> deleted, changed;     // the tracked versions, where they can be read
+    auto tracked_version = [&gitlite_dir](const Blob *blob) -> RenameCandidate {
+        std::filesystem::path file = gitlite_dir / "blobs" / blob->ref.to_hex();
+        if (!std::filesystem::is_regular_file(file))
+            file = gitlite_dir / "index" / blob->name.str();    // staged and not committed yet
+        return {blob->name, blob->ref, file};
+    };
+    const Blob *cwd = cwd_files->head->next;
+    for (const Blob *blob = tracked_files->head->next; blob != tracked_files->head; blob = blob->next) {
+        while (cwd != cwd_files->head && cwd->name < blob->name)
+            cwd = cwd->next;
+        if (cwd == cwd_files->head || cwd->name != blob->name) {
+            cout << blob->name << msg_status_deleted << endl;
+            deleted.push_back(tracked_version(blob));
+        } else if ((cwd->ref.is_null() ? get_sha1(blob->name) : cwd->ref) != blob->ref) {
+            cout << blob->name << msg_status_modified << endl;
+            changed.push_back(tracked_version(blob));
+        }
+    }
+
+    // Untracked files are paired with the deleted tracked files they were renamed from, or the
+    // modified ones they were copied from. They are only hashed if there is something to pair with.
+    vector<RenameCandidate> untracked;
+    const Blob *tracked = tracked_files->head->next;
+    for (const Blob *blob = cwd_files->head->next; blob != cwd_files->head; blob = blob->next) {
+        while (tracked != tracked_files->head && tracked->name < blob->name)
+            tracked = tracked->next;
+        if (tracked == tracked_files->head || tracked->name != blob->name)
+            untracked.push_back({blob->name, blob->ref, work_tree() / blob->name.str()});
+    }
+    if (!deleted.empty() || !changed.empty()) {
+        for (RenameCandidate &file : untracked) {
+            if (file.ref.is_null())
+                file.ref = get_sha1(file.name);
+        }
+    }
+    unordered_map<string, RenamePair> untracked_renames = pair_renames(deleted, untracked, changed);
+
+    cout << endl << status_untracked_files_header << endl;
+    for (const RenameCandidate &file : untracked) {
+        print_status_name(file.name, untracked_renames);
+    }
+    cout << endl;
 }
 
 bool checkout(const string &filename, Commit *commit) {
-    return false;
+    if (commit == nullptr) {
+        cout << msg_commit_does_not_exist << endl;
+        return false;
+    }
+    Blob *blob = list_find_name(commit->tracked_files, filename);
+    if (blob == nullptr) {
+        cout << msg_file_does_not_exist << endl;
+        return false;
+    }
+    return write_file(filename, blob->ref);
+}
+
+// Replace the files of the head commit in CWD with the files of another commit.
+// Refused if an untracked file would be overwritten.
+static bool switch_to_commit(Commit *commit, List *staged_files, List *tracked_files, const List *cwd_files,
+                             const Commit *head_commit) {
+    // One pass over the sorted lists finds the untracked files in the way and the files to write:
+    // those missing in CWD or whose content is not known to be the one in the target commit
+    const List *target = commit->tracked_files;
+    vector<const Blob *> writes;
+    const Blob *tracked = tracked_files->head->next, *cwd = cwd_files->head->next;
+    for (const Blob *blob = target->head->next; blob != target->head; blob = blob->next) {
+        while (tracked != tracked_files->head && tracked->name < blob->name)
+            tracked = tracked->next;
+        while (cwd != cwd_files->head && cwd->name < blob->name)
+            cwd = cwd->next;
+        bool in_cwd = cwd != cwd_files->head && cwd->name == blob->name;
+        if (in_cwd && (tracked == tracked_files->head || tracked->name != blob->name)) {
+            cout << msg_untracked_file << endl;
+            return false;
+        }
+        if (!in_cwd || cwd->ref != blob->ref)   // a null ref means the file has not been hashed
+            writes.push_back(blob);
+    }
+
+    // Delete the files that are gone in the target commit, skipping the directories that did not change
+    TreeStore &trees = tree_store();
+    diff_trees(trees, trees.tree_of(head_commit), trees.tree_of(commit),
+               [](const string &name, const ObjectId &, const ObjectId &new_ref) {
+                   if (new_ref.is_null())
+                       restricted_delete(name);
+               });
+    for (const Blob *blob : writes) {
+        write_file(blob->name, blob->ref);
+    }
+    list_replace(tracked_files, target);
+    list_clear(staged_files);
+    return true;
 }
 
 bool checkout(const string &branch_name, Blob *&current_branch, const List *branches, List *staged_files,
               List *tracked_files, const List *cwd_files, Commit *&head_commit) {
-    return false;
+    Blob *given_branch = find_branch(branches, branch_name);
+    if (given_branch == nullptr) {
+        cout << msg_branch_does_not_exist << endl;
+        return false;
+    }
+    if (given_branch == current_branch) {
+        cout << msg_checkout_current << endl;
+        return false;
+    }
+    if (!switch_to_commit(given_branch->commit, staged_files, tracked_files, cwd_files, head_commit))
+        return false;
+    current_branch = given_branch;
+    head_commit = given_branch->commit;
+    return true;
 }
 
 bool reset(Commit *commit, Blob *current_branch, List *staged_files, List *tracked_files, const List *cwd_files,
            Commit *&head_commit) {
-    return false;
+    if (commit == nullptr) {
+        cout << msg_commit_does_not_exist << endl;
+        return false;
+    }
+    if (!switch_to_commit(commit, staged_files, tracked_files, cwd_files, head_commit))
+        return false;
+    current_branch->commit = commit;
+    head_commit = commit;
+    return true;
 }
 
 Blob *branch(const string &branch_name, List *branches, Commit *head_commit) {
-    return nullptr;
+    if (find_branch(branches, branch_name) != nullptr) {
+        cout << msg_branch_exists << endl;
+        return nullptr;
+    }
+    return put_branch(branches, branch_name, head_commit);
 }
 
 bool remove_branch(const string &branch_name, Blob *current_branch, List *branches) {
-    return false;
+    Blob *given_branch = find_branch(branches, branch_name);
+    if (given_branch == nullptr) {
+        cout << msg_branch_does_not_exist << endl;
+        return false;
+    }
+    if (given_branch == current_branch) {
+        cout << msg_remove_current << endl;
+        return false;
+    }
+    erase_branch(branches, given_branch);
+    return true;
+}
+
+static bool tracking_changed(const List *tracked_files, const Commit *commit) {
+    const List *committed = commit->tracked_files;
+    Blob *a = tracked_files->head->next, *b = committed->head->next;
+    for (; a != tracked_files->head && b != committed->head; a = a->next, b = b->next) {
+        if (!(*a == *b))
+            return true;
+    }
+    return a != tracked_files->head || b != committed->head;
 }
 
 bool merge(const string &branch_name, Blob *&current_branch, List *branches, List *staged_files, List *tracked_files,
            const List *cwd_files, Commit *&head_commit) {
-    return false;
+    if (list_size(staged_files) > 0 || tracking_changed(tracked_files, head_commit)) {
+        cout << msg_exists_uncommitted_changes << endl;
+        return false;
+    }
+
+    Blob *given_branch = find_branch(branches, branch_name);
+    if (given_branch == nullptr) {
+        cout << msg_branch_does_not_exist << endl;
+        return false;
+    }
+    if (given_branch == current_branch) {
+        cout << msg_merge_current << endl;
+        return false;
+    }
+
+    Commit *given_commit = given_branch->commit;
+    if (is_ancestor(given_commit, head_commit)) {
+        cout << msg_given_is_ancestor_of_current << endl;
+        return false;
+    }
+    Commit *split_point = get_lca(head_commit, given_commit);
+
+    // Classify the files, only looking into the directories that differ between the two sides
+    TreeStore &trees = tree_store();
+    deque<Blob> plan_blobs;
+    vector<MergeEntry> plan = plan_merge(trees, trees.tree_of(split_point), trees.tree_of(head_commit),
+                                         trees.tree_of(given_commit), plan_blobs);
+    follow_renames(plan, work_tree() / ".gitlite/blobs");
+    for (const MergeEntry &entry : plan) {
+        bool untracked = entry.current == nullptr || entry.moved();
+        if ((entry.action != MergeAction::KEEP_CURRENT || entry.moved()) && untracked
+            && list_find_name(cwd_files, entry.name()) != nullptr) {
+            cout << msg_untracked_file << endl;
+            return false;
+        }
+    }
+
+    bool conflicted = false;
+    for (const MergeEntry &entry : plan) {
+        const string &filename = entry.name();
+        if (entry.moved() && entry.action != MergeAction::TAKE_GIVEN) {
+            // Renamed in the given branch, bring the current version over to the new name first
+            write_file(filename, entry.current->ref);
+            list_put(tracked_files, filename, entry.current->ref);
+        }
+        switch (entry.action) {
+            case MergeAction::KEEP_CURRENT:
+                break;
+            case MergeAction::TAKE_GIVEN:
+                write_file(filename, entry.given->ref);
+                list_put(tracked_files, filename, entry.given->ref);
+                break;
+            case MergeAction::REMOVE:
+                restricted_delete(filename);
+                list_remove(tracked_files, filename);
+                break;
+            case MergeAction::CONFLICT:
+                if (entry.current == nullptr || entry.given == nullptr || entry.split == nullptr) {
+                    add_conflict_marker(filename, entry.given ? entry.given->ref : ObjectId());
+                    conflicted = true;
+                } else {
+                    conflicted |= add_conflict_marker(filename, entry.split->ref, entry.given->ref);
+                }
+                stage_content(filename);
+                list_put(tracked_files, filename, get_sha1(filename));
+                break;
+        }
+    }
+
+    if (split_point == head_commit) {
+        head_commit = given_commit;
+        current_branch->commit = given_commit;
+        cout << msg_fast_forward << endl;
+        return true;
+    }
+
+    auto *merge_commit = new Commit;
+    merge_commit->message = get_merge_commit_message(given_branch, current_branch);
+    merge_commit->time = get_time_string();
+    merge_commit->commit_id = get_sha1(merge_commit->message, merge_commit->time);
+    merge_commit->parent = head_commit;
+    merge_commit->second_parent = given_commit;
+    merge_commit->tracked_files = list_copy(tracked_files);
+    head_commit = merge_commit;
+    current_branch->commit = merge_commit;
+    list_clear(staged_files);
+
+    if (conflicted) {
+        cout << msg_encountered_merge_conflict << endl;
+    }
+    return true;
+}
+
+// Octopus merge: merge several branches into the current one with a single commit.
+// The merged tree is computed in memory first and the working directory is only rewritten once;
+// the merge is refused if any of the branches would need manual conflict resolution.
+bool merge(const std::vector<string> &branch_names, Blob *&current_branch, List *branches, List *staged_files,
+           List *tracked_files, const List *cwd_files, Commit *&head_commit) {
+    if (list_size(staged_files) > 0 || tracking_changed(tracked_files, head_commit)) {
+        cout << msg_exists_uncommitted_changes << endl;
+        return false;
+    }
+
+    vector<Blob *> given_branches;
+    for (const string &branch_name : branch_names) {
+        Blob *given_branch = find_branch(branches, branch_name);
+        if (given_branch == nullptr) {
+            cout << msg_branch_does_not_exist << endl;
+            return false;
+        }
+        if (given_branch == current_branch) {
+            cout << msg_merge_current << endl;
+            return false;
+        }
+        given_branches.push_back(given_branch);
+    }
+
+    // Only keep the branches that are not already contained in the current or another given branch
+    vector<Blob *> heads;
+    for (Blob *given_branch : given_branches) {
+        Commit *given_commit = given_branch->commit;
+        bool contained = is_ancestor(given_commit, head_commit);
+        for (Blob *other : given_branches) {
+            if (contained)
+                break;
+            if (other->commit == given_commit)
+                contained = other != given_branch && find(heads.begin(), heads.end(), other) != heads.end();
+            else
+                contained = is_ancestor(given_commit, other->commit);
+        }
+        if (!contained)
+            heads.push_back(given_branch);
+    }
+    if (heads.empty()) {
+        cout << msg_given_is_ancestor_of_current << endl;
+        return false;
+    }
+    if (heads.size() == 1) {
+        return merge(heads[0]->name, current_branch, branches, staged_files, tracked_files, cwd_files, head_commit);
+    }
+
+    // Fold the branches one by one into the merged tree. The base of each step is the merge base of
+    // the next head with everything folded so far, found from a stand-in commit whose parents are
+    // the current commit and the heads already merged. Renames are followed as in a two-way merge.
+    TreeStore &trees = tree_store();
+    const std::filesystem::path blobs_dir = work_tree() / ".gitlite/blobs";
+    List *result = list_copy(head_commit->tracked_files);
+    unordered_map<ObjectId, string> merged_blobs;
+    Commit folded;
+    folded.parent = head_commit;
+    for (Blob *given_branch : heads) {
+        Commit *split_point = get_lca(folded.second_parent ? &folded : head_commit, given_branch->commit);
+        deque<Blob> plan_blobs;
+        vector<MergeEntry> plan = plan_merge(trees, trees.tree_of(split_point), trees.build(result),
+                                             trees.tree_of(given_branch->commit), plan_blobs);
+        // Rename detection reads the blobs merged in the earlier rounds from .gitlite/blobs
+        store_blobs(merged_blobs);
+        merged_blobs.clear();
+        follow_renames(plan, blobs_dir);
+        for (const MergeEntry &entry : plan) {
+            ObjectId ref;
+            if (entry.moved() && entry.action != MergeAction::TAKE_GIVEN) {
+                // Renamed in the given branch, the current version moves to the new name
+                list_put(result, entry.name(), entry.current->ref);
+            }
+            switch (entry.action) {
+                case MergeAction::KEEP_CURRENT:
+                    break;
+                case MergeAction::TAKE_GIVEN:
+                    list_put(result, entry.name(), entry.given->ref);
+                    break;
+                case MergeAction::REMOVE:
+                    list_remove(result, entry.name());
+                    break;
+                case MergeAction::CONFLICT:
+                    if (entry.split && entry.current && entry.given)
+                        ref = merge_blobs(entry.split->ref, entry.current->ref, entry.given->ref, merged_blobs);
+                    if (ref.is_null()) {
+                        cout << msg_octopus_conflict << endl;
+                        list_delete(result);
+                        return false;
+                    }
+                    list_put(result, entry.name(), ref);
+                    break;
+            }
+        }
+        if (folded.second_parent == nullptr)
+            folded.second_parent = given_branch->commit;
+        else
+            folded.other_parents.push_back(given_branch->commit);
+    }
+
+    // Update the working directory from the current tree to the merged tree in one pass,
+    // skipping the directories that no branch touched
+    vector<pair<string, ObjectId>> changes;     // the new ref of each changed file, null if deleted
+    const Blob *cwd = cwd_files->head->next;
+    bool blocked = false;
+    diff_trees(trees, trees.tree_of(head_commit), trees.build(result),
+               [&](const string &name, const ObjectId &old_ref, const ObjectId &new_ref) {
+                   // The changes come sorted by name, as the files in CWD do
+                   while (cwd != cwd_files->head && cwd->name < name)
+                       cwd = cwd->next;
+                   blocked |= old_ref.is_null() && cwd != cwd_files->head && cwd->name == name;
+                   changes.emplace_back(name, new_ref);
+               });
+    if (blocked) {
+        cout << msg_untracked_file << endl;
+        list_delete(result);
+        return false;
+    }
+    store_blobs(merged_blobs);
+    for (auto &change : changes) {
+        if (!change.second.is_null()) {
+            write_file(change.first, change.second);
+        } else {
+            restricted_delete(change.first);
+        }
+    }
+    list_replace(tracked_files, result);
+    list_delete(result);
+
+    auto *merge_commit = new Commit;
+    merge_commit->message = get_merge_commit_message(heads, current_branch);
+    merge_commit->time = get_time_string();
+    merge_commit->commit_id = get_sha1(merge_commit->message, merge_commit->time);
+    merge_commit->parent = head_commit;
+    merge_commit->second_parent = heads[0]->commit;
+    for (size_t i = 1; i < heads.size(); ++i) {
+        merge_commit->other_parents.push_back(heads[i]->commit);
+    }
+    merge_commit->tracked_files = list_copy(tracked_files);
+    head_commit = merge_commit;
+    current_branch->commit = merge_commit;
+    return true;
 }
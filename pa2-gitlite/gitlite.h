@@ -19,6 +19,10 @@ bool remove(const string &filename, List* staged_files, List *tracked_files, con
 
 void log(const Commit *head_commit);
 
+class LogFormat;
+
+void log(const Commit *head_commit, const LogFormat &format);
+
 void status(const Blob *current_branch, const List *branches, const List *staged_files, const List *tracked_files,
             const List *cwd_files, const Commit *head_commit);
 
@@ -37,4 +41,7 @@ bool remove_branch(const string &branch_name, Blob *current_branch, List *branch
 bool merge(const string &branch_name, Blob *&current_branch, List *branches, List *staged_files, List *tracked_files,
            const List *cwd_files, Commit *&head_commit);
 
+bool merge(const std::vector<string> &branch_names, Blob *&current_branch, List *branches, List *staged_files,
+           List *tracked_files, const List *cwd_files, Commit *&head_commit);
+
 #endif //COMP2012H_FA21_PA2_GITLITE_H
@@ -1,68 +1,43 @@
+#include <cstdlib>
 #include <iostream>
 #include <filesystem>
 #include <string>
 #include <vector>
 
 #include "Repository.h"
-#include "Tester.h"
+#include "TestRunner.h"
+#include "Trace.h"
 
 using std::cout;
 using std::endl;
 using path = std::filesystem::path;
 
-// Clean the testing directory for further testing
-void clean_environment() {
-    for (auto &entry : std::filesystem::directory_iterator(Repository::CWD)) {
-        if (entry.is_regular_file()) {
-            if (entry.path().filename() != "gitlite" && entry.path().filename() != "gitlite.exe") {
-                // Remove all the files other than the program itself
-                std::filesystem::remove(entry.path());
-            }
-        } else if (entry.is_directory() && entry.path().filename() == ".gitlite") {
-            // Remove the whole .gitlite directory recursively
-            std::filesystem::remove_all(entry.path());
-        }
+int run_test(const std::string &filename, bool verbose, unsigned jobs = 0) {
+    path dir = std::filesystem::current_path() / path(filename);
+    if (std::filesystem::is_directory(dir)) {
+        return run_test_dir(dir, verbose, jobs) ? 0 : 1;
     }
+    return run_test_file(filename, verbose) ? 0 : 1;
 }
 
-bool test_handler(const std::string &filename, bool verbose) {
-    try {
-        Tester tester(filename, verbose);
-        clean_environment();
-        if (!tester.run()) {
-            cout << "Test FAILED" << endl;
-            return false;
-        }
-    } catch (const std::exception &e) {
-        cout << e.what() << endl << "Test FAILED" << endl;
-        return false;
+int run_command(const std::vector<std::string> &args) {
+    TraceScope trace("gitlite " + args[0], "gitlite");
+    if (!validate_args(args)) {
+        return 0;
     }
-    return true;
-}
-
-void test_all(const path &dir, bool verbose) {
-    for (auto &entry : std::filesystem::directory_iterator(dir)) {
-        if (entry.is_regular_file() && entry.path().extension() == ".in") {
-            path relative = std::filesystem::relative(entry.path());
-            if (!test_handler(relative.string(), verbose)) {
-                Repository::close();
-                return;
-            }
-            Repository::close();
-            Repository::reset_states();
+    Repository repository;
+    if (repository.check_file_structure()) {
+        try {
+            repository.load_repository();
+        } catch (...) {
+            std::cout << ".gitlite directory detected, but failed to load." << std::endl;
+            std::cout << "File structures may be corrupted. Please delete .gitlite and retry." << std::endl;
+            return 0;
         }
     }
-    std::cout << "All tests PASSED" << std::endl;
-}
+    parse_args(repository, args);
+    repository.close();
 
-int run_test(const std::string &filename, bool verbose) {
-    path dir = Repository::CWD / path(filename);
-    if (std::filesystem::is_directory(dir)) {
-        test_all(dir, verbose);
-        return 0;
-    }
-    test_handler(filename, verbose);
-    Repository::close();
     return 0;
 }
 
@@ -78,6 +53,18 @@ int main(int argc, char *argv[]) {
         args.emplace_back(argv[i]);
     }
 
+    // --trace[=<file>] or GITLITE_TRACE=<file>: write a Chrome trace of the command
+    path trace_file;
+    if (!args.empty() && args[0].rfind("--trace", 0) == 0 && (args[0].size() == 7 || args[0][7] == '=')) {
+        trace_file = args[0].size() > 8 ? args[0].substr(8) : "gitlite-trace.json";
+        args.erase(args.begin());
+    } else if (const char *env = std::getenv("GITLITE_TRACE"); env != nullptr && *env != '\0') {
+        trace_file = env;
+    }
+    if (args.empty()) {
+        return 0;
+    }
+
     if (args.size() == 2 && args[0] == "-t") {
         return run_test(args[1], false);
     }
@@ -86,20 +73,19 @@ int main(int argc, char *argv[]) {
         return run_test(args[1], true);
     }
 
-    if (!validate_args(args)) {
-        return 0;
-    }
-    if (Repository::check_file_structure()) {
-        try {
-            Repository::load_repository();
-        } catch (...) {
-            std::cout << ".gitlite directory detected, but failed to load." << std::endl;
-            std::cout << "File structures may be corrupted. Please delete .gitlite and retry." << std::endl;
-            return 0;
-        }
+    // -t <directory> -j <jobs>: run the tests of the directory at most <jobs> at a time
+    if (args.size() == 4 && (args[0] == "-t" || args[0] == "-tv" || args[0] == "-vt") && args[2] == "-j"
+        && !args[3].empty() && args[3].size() <= 4 && args[3].find_first_not_of("0123456789") == std::string::npos) {
+        return run_test(args[1], args[0] != "-t", static_cast<unsigned>(std::stoul(args[3])));
     }
-    parse_args(args);
-    Repository::close();
 
-    return 0;
+    if (trace_file.empty()) {
+        return run_command(args);
+    }
+    trace_start(trace_file);
+    int status = run_command(args);
+    if (!trace_stop()) {
+        std::cerr << "failed to write the trace to " << trace_file.string() << std::endl;
+    }
+    return status;
 }
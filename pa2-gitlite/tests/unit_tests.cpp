@@ -0,0 +1,489 @@
+//
+// Unit tests of the pure logic that the auto-testing scripts cannot reach directly:
+// three-way merging of lines and blobs, the merge planner, tree objects, the ignore patterns, EWAH bitmaps,
+// the branch table, the time index and the drawing of log --graph.
+// Usage: unit_tests [name...], runs every test if no name is given
+//
+
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CommitFile.h"
+#include "CommitGraph.h"
+#include "Diff.h"
+#include "Ewah.h"
+#include "Ignore.h"
+#include "MergePlan.h"
+#include "Refs.h"
+#include "Repository.h"
+#include "TimeIndex.h"
+#include "Tree.h"
+#include "Utils.h"
+
+using namespace std;
+
+static int failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+static void check(bool passed, const char *condition, const char *file, int line) {
+    if (!passed) {
+        cout << file << ":" << line << ": CHECK(" << condition << ") failed" << endl;
+        ++failures;
+    }
+}
+
+// Files given as (name, content), each ref being the hash of the content
+static List *make_list(const vector<pair<string, string>> &files) {
+    List *list = list_new();
+    for (auto &file : files) {
+        list_put(list, file.first, get_string_id(file.second));
+    }
+    return list;
+}
+
+static const MergeEntry *find_entry(const vector<MergeEntry> &plan, const string &name) {
+    for (const MergeEntry &entry : plan) {
+        if (entry.name() == name)
+            return &entry;
+    }
+    return nullptr;
+}
+
+static void test_merge_lines() {
+    string result;
+    CHECK(merge_lines(result, "a\nb\nc\n", "A\nb\nc\n", "a\nb\nC\n") == 0);
+    CHECK(result == "A\nb\nC\n");
+
+    // The same change on both sides is taken once
+    CHECK(merge_lines(result, "a\nb\n", "a\nx\n", "a\nx\n") == 0);
+    CHECK(result == "a\nx\n");
+
+    CHECK(merge_lines(result, "a\nb\nc\n", "a\nx\nc\n", "a\ny\nc\n") == 1);
+    CHECK(result.find("<<<<<<<") != string::npos && result.find("x\n") != string::npos
+          && result.find("y\n") != string::npos);
+    CHECK(result.rfind("a\n", 0) == 0 && result.size() > 2 && result.substr(result.size() - 2) == "c\n");
+
+    // Changes in separate regions both survive, even if a line was added at the end on one side
+    CHECK(merge_lines(result, "1\n2\n3\n4\n5\n", "0\n1\n2\n3\n4\n5\n", "1\n2\n3\n4\n5\n6\n") == 0);
+    CHECK(result == "0\n1\n2\n3\n4\n5\n6\n");
+}
+
+static void test_merge_blobs() {
+    filesystem::path root = filesystem::temp_directory_path() / "gitlite-unit-tests";
+    filesystem::remove_all(root);
+    filesystem::path blobs = root / ".gitlite/blobs";
+    filesystem::create_directories(blobs);
+
+    string base = "a\nb\nc\n", ours = "A\nb\nc\n", theirs = "a\nb\nC\n", other = "a\nb\nX\n";
+    for (const string *content : {&base, &ours, &theirs, &other}) {
+        write_content(blobs / get_string_sha1(*content), *content);
+    }
+
+    {
+        WorkTreeScope scope(root);
+        size_t blob_count = regular_files_in_path(blobs).size();
+        unordered_map<ObjectId, string> unstored;
+        ObjectId merged = merge_blobs(get_string_id(base), get_string_id(ours), get_string_id(theirs), unstored);
+        CHECK(merged == get_string_id("A\nb\nC\n"));
+        CHECK(unstored.size() == 1 && unstored[merged] == "A\nb\nC\n");
+        CHECK(regular_files_in_path(blobs).size() == blob_count);
+
+        // A merged blob not stored yet can be merged again
+        ObjectId again = merge_blobs(get_string_id(theirs), merged, get_string_id(other), unstored);
+        CHECK(again == get_string_id("A\nb\nX\n"));
+        CHECK(unstored.size() == 2);
+
+        // Nothing is added for a conflict
+        CHECK(merge_blobs(get_string_id(base), get_string_id(theirs), get_string_id(other), unstored).is_null());
+        CHECK(unstored.size() == 2);
+
+        store_blobs(unstored);
+        CHECK(read_content(blobs / merged.to_hex()) == "A\nb\nC\n");
+        CHECK(read_content(blobs / again.to_hex()) == "A\nb\nX\n");
+        CHECK(regular_files_in_path(blobs).size() == blob_count + 2);
+    }
+    filesystem::remove_all(root);
+}
+
+static void test_plan_merge() {
+    List *split = make_list({{"conflict", "s"}, {"given_only", "s"}, {"removed", "s"}, {"same", "s"},
+                             {"removed_changed", "s"}, {"current_only", "s"}, {"both_same", "s"}});
+    List *current = make_list({{"conflict", "c"}, {"given_only", "s"}, {"removed", "s"}, {"same", "s"},
+                               {"removed_changed", "c"}, {"current_only", "c"}, {"both_same", "x"},
+                               {"added_current", "c"}});
+    List *given = make_list({{"conflict", "g"}, {"given_only", "g"}, {"same", "s"}, {"current_only", "s"},
+                             {"both_same", "x"}, {"added_given", "g"}, {"added_current", "g"}});
+
+    vector<MergeEntry> plan = plan_merge(split, current, given);
+    CHECK(plan.size() == 9);
+    for (size_t i = 1; i < plan.size(); ++i) {
+        CHECK(plan[i - 1].name() < plan[i].name());
+    }
+
+    auto action = [&plan](const string &name) {
+        const MergeEntry *entry = find_entry(plan, name);
+        return entry ? entry->action : MergeAction::KEEP_CURRENT;
+    };
+    CHECK(action("conflict") == MergeAction::CONFLICT);
+    CHECK(action("given_only") == MergeAction::TAKE_GIVEN);
+    CHECK(action("removed") == MergeAction::REMOVE);
+    CHECK(action("same") == MergeAction::KEEP_CURRENT);
+    CHECK(action("removed_changed") == MergeAction::CONFLICT);
+    CHECK(action("current_only") == MergeAction::KEEP_CURRENT);
+    CHECK(action("both_same") == MergeAction::KEEP_CURRENT);
+    CHECK(action("added_given") == MergeAction::TAKE_GIVEN);
+    CHECK(action("added_current") == MergeAction::CONFLICT);
+
+    const MergeEntry *entry = find_entry(plan, "added_given");
+    CHECK(entry != nullptr && entry->split == nullptr && entry->current == nullptr && entry->given != nullptr);
+
+    list_delete(split);
+    list_delete(current);
+    list_delete(given);
+}
+
+static void test_trees() {
+    filesystem::path dir = filesystem::temp_directory_path() / "gitlite-unit-tests-trees";
+    filesystem::remove_all(dir);
+    List *old_files = make_list({{"a.txt", "a"}, {"dir/b.txt", "b"}, {"dir/sub/c.txt", "c"}, {"dir0", "d"},
+                                 {"lib/x", "x"}, {"lib/y", "y"}});
+    List *new_files = make_list({{"a.txt", "a"}, {"dir/b.txt", "b"}, {"dir/new", "n"}, {"dir/sub/c.txt", "C"},
+                                 {"lib/x", "x"}, {"lib/y", "y"}});
+    ObjectId old_tree, new_tree, lib_tree;
+    {
+        TreeStore store(dir);
+        old_tree = store.build(old_files);
+        new_tree = store.build(new_files);
+        store.save(old_tree);
+        store.save(new_tree);
+        for (const TreeEntry &entry : store.entries(old_tree)) {
+            if (entry.name == "lib")
+                lib_tree = entry.id;
+        }
+        CHECK(store.build(old_files) == old_tree);
+    }
+    CHECK(!lib_tree.is_null());
+
+    // Read back from the directory. The unchanged lib/ is never read, so the diff works without it.
+    filesystem::remove(dir / lib_tree.to_hex());
+    TreeStore store(dir);
+    string changes;
+    diff_trees(store, old_tree, new_tree, [&changes](const string &name, const ObjectId &old_ref,
+                                                     const ObjectId &new_ref) {
+        changes += name + (old_ref.is_null() ? "+" : new_ref.is_null() ? "-" : "~") + " ";
+    });
+    CHECK(changes == "dir/new+ dir/sub/c.txt~ dir0- ");
+
+    // Everything against an empty tree, in the order of the sorted names
+    TreeStore memory;
+    string names;
+    diff_trees(memory, ObjectId(), memory.build(old_files),
+               [&names](const string &name, const ObjectId &, const ObjectId &) { names += name + " "; });
+    CHECK(names == "a.txt dir/b.txt dir/sub/c.txt dir0 lib/x lib/y ");
+
+    // A merge only visits the files that differ between the current and the given side
+    List *given_files = make_list({{"a.txt", "A"}, {"dir/b.txt", "b"}, {"dir/sub/c.txt", "C"}, {"dir0", "d"},
+                                   {"lib/x", "x"}, {"lib/y", "y"}});
+    string visited;
+    walk_merge_trees(memory, memory.build(old_files), memory.build(new_files), memory.build(given_files),
+                     [&visited](const string &name, const ObjectId &split, const ObjectId &current,
+                                const ObjectId &given) {
+                         visited += name + ":" + (split.is_null() ? "" : "s") + (current.is_null() ? "" : "c")
+                                    + (given.is_null() ? "" : "g") + " ";
+                     });
+    CHECK(visited == "a.txt:scg dir/new:c dir0:sg ");
+
+    // A tree that was never saved is not found in the directory
+    bool missing = false;
+    try {
+        store.entries(memory.build(given_files));
+    } catch (const std::runtime_error &) {
+        missing = true;
+    }
+    CHECK(missing);
+
+    list_delete(old_files);
+    list_delete(new_files);
+    list_delete(given_files);
+    filesystem::remove_all(dir);
+}
+
+static void test_file_list() {
+    string ref_a = get_string_sha1("a"), ref_b = get_string_sha1("b");
+    List *files = make_list({{"a.txt", "a"}, {"dir/b.txt", "b"}, {"empty", "a"}});
+    filesystem::path file = filesystem::temp_directory_path() / "gitlite-unit-tests-TREE";
+    write_file_list(file, files);
+
+    List *read = read_file_list(file);
+    string contents;
+    for (Blob *blob = read->head->next; blob != read->head; blob = blob->next) {
+        contents += blob->name.str() + "=" + blob->ref.to_hex() + " ";
+    }
+    CHECK(contents == "a.txt=" + ref_a + " dir/b.txt=" + ref_b + " empty=" + ref_a + " ");
+
+    // Truncated or foreign contents are rejected
+    string encoded = read_content(file);
+    bool rejected = false;
+    try {
+        FileListView view(string_view(encoded).substr(0, encoded.size() - 1));
+    } catch (const std::runtime_error &) {
+        rejected = true;
+    }
+    CHECK(rejected);
+    rejected = false;
+    try {
+        FileListView view(string_view("GLC1\0\0\0\0", 8));
+    } catch (const std::runtime_error &) {
+        rejected = true;
+    }
+    CHECK(rejected);
+
+    list_delete(files);
+    list_delete(read);
+    filesystem::remove(file);
+}
+
+static void test_ignore() {
+    IgnoreMatcher matcher("# comment\n"
+                          "\n"
+                          "*.o\n"
+                          "!keep.o\n"
+                          "build/\n"
+                          "/root.txt\n"
+                          "docs/*.md\n"
+                          "logs/**/*.log\n"
+                          "data?.csv\n"
+                          "[ab]ck.txt\n");
+
+    CHECK(matcher.is_ignored("main.o"));
+    CHECK(matcher.is_ignored("src/main.o"));
+    CHECK(!matcher.is_ignored("keep.o"));
+    CHECK(!matcher.is_ignored("src/keep.o"));
+    CHECK(!matcher.is_ignored("main.cpp"));
+
+    CHECK(matcher.is_ignored("build", true));
+    CHECK(!matcher.is_ignored("build", false));
+    CHECK(matcher.is_ignored("build/out.txt"));
+    CHECK(matcher.is_ignored("src/build/out.txt"));
+
+    CHECK(matcher.is_ignored("root.txt"));
+    CHECK(!matcher.is_ignored("src/root.txt"));
+
+    CHECK(matcher.is_ignored("docs/readme.md"));
+    CHECK(!matcher.is_ignored("docs/sub/readme.md"));
+    CHECK(!matcher.is_ignored("src/docs/readme.md"));
+
+    CHECK(matcher.is_ignored("logs/a.log"));
+    CHECK(matcher.is_ignored("logs/x/y/a.log"));
+    CHECK(!matcher.is_ignored("logs/a.txt"));
+
+    CHECK(matcher.is_ignored("data1.csv"));
+    CHECK(!matcher.is_ignored("data12.csv"));
+    CHECK(matcher.is_ignored("ack.txt"));
+    CHECK(matcher.is_ignored("bck.txt"));
+    CHECK(!matcher.is_ignored("cck.txt"));
+
+    CHECK(!IgnoreMatcher().is_ignored("anything"));
+}
+
+// "**/" stands for whole directories only, never for part of a name
+static void test_ignore_globstar() {
+    IgnoreMatcher leading("**/foo\n");
+    CHECK(leading.is_ignored("foo"));
+    CHECK(leading.is_ignored("a/foo"));
+    CHECK(leading.is_ignored("a/b/foo"));
+    CHECK(leading.is_ignored("foo/bar.txt"));
+    CHECK(!leading.is_ignored("xfoo"));
+    CHECK(!leading.is_ignored("barfoo"));
+    CHECK(!leading.is_ignored("a/xfoo"));
+
+    IgnoreMatcher middle("a/**/b\n");
+    CHECK(middle.is_ignored("a/b"));
+    CHECK(middle.is_ignored("a/x/b"));
+    CHECK(middle.is_ignored("a/x/y/b"));
+    CHECK(!middle.is_ignored("a/xb"));
+    CHECK(!middle.is_ignored("a/xyb"));
+    CHECK(!middle.is_ignored("a/x/yb"));
+    CHECK(!middle.is_ignored("ab"));
+
+    IgnoreMatcher suffix("logs/**/*.log\n");
+    CHECK(suffix.is_ignored("logs/a.log"));
+    CHECK(suffix.is_ignored("logs/x/a.log"));
+    CHECK(!suffix.is_ignored("logsx/a.log"));
+}
+
+static void test_ewah() {
+    mt19937_64 rng(2012);
+    for (int round = 0; round < 50; ++round) {
+        // Long clean runs mixed with dirty words, like the bitmaps of a history
+        vector<uint64_t> words(rng() % 300);
+        for (uint64_t &word : words) {
+            switch (rng() % 4) {
+                case 0: word = 0; break;
+                case 1: word = ~uint64_t(0); break;
+                case 2: word = uint64_t(1) << rng() % 64; break;
+                default: word = rng(); break;
+            }
+        }
+
+        EwahBitmap bitmap = EwahBitmap::compress(words);
+        vector<uint64_t> decoded(words.size());
+        bitmap.or_into(decoded);
+        CHECK(decoded == words);
+        for (size_t bit = 0; bit < words.size() * 64; bit += 1 + rng() % 50) {
+            CHECK(bitmap.get(bit) == bool(words[bit / 64] >> bit % 64 & 1));
+        }
+        CHECK(!bitmap.get(words.size() * 64 + 1));
+
+        // A shorter target only receives the bits that fit
+        vector<uint64_t> prefix(words.size() / 2);
+        bitmap.or_into(prefix);
+        CHECK(equal(prefix.begin(), prefix.end(), words.begin()));
+    }
+
+    EwahBitmap clean = EwahBitmap::compress(vector<uint64_t>(1000, 0));
+    CHECK(clean.word_count() == 1);
+    CHECK(!clean.get(500));
+}
+
+static void test_branch_table() {
+    Commit commit;
+    List *branches = list_new();
+    for (const char *name : {"b", "d"}) {
+        list_put(branches, name, &commit);
+    }
+    BranchTable table(branches);
+    set_branch_table(&table);
+
+    // New branches are linked in name order, wherever they fall
+    for (const char *name : {"e", "a", "c"}) {
+        CHECK(put_branch(branches, name, &commit) == find_branch(branches, name));
+    }
+    erase_branch(branches, find_branch(branches, "d"));
+    CHECK(find_branch(branches, "d") == nullptr);
+
+    string names;
+    for (Blob *blob = branches->head->next; blob != branches->head; blob = blob->next) {
+        names += blob->name.str();
+        CHECK(blob->next->prev == blob);
+    }
+    CHECK(names == "abce");
+
+    set_branch_table(nullptr);
+    list_delete(branches);
+    delete branches;
+}
+
+// Commits at or before the epoch, like an initial commit at 1970-01-01 00:00:00 in UTC+8, are still listed
+static void test_time_index() {
+    filesystem::path file = filesystem::temp_directory_path() / "gitlite-unit-tests-TIMES";
+    TimeIndex index(file);
+    index.rebuild({{100, "c"}, {-28800, "a"}, {0, "b"}});
+    index.add(200, "e");
+    index.add(50, "d");     // out of order
+    CHECK(index.size() == 5);
+
+    string order;
+    vector<time_t> times;
+    index.scan_newest_first([&](time_t time, const string &commit_id) {
+        order += commit_id;
+        times.push_back(time);
+        return true;
+    });
+    CHECK(order == "ecdba");
+    CHECK(times == vector<time_t>({200, 100, 50, 0, -28800}));
+    filesystem::remove(file);
+}
+
+static Commit *make_commit(const string &message, Commit *parent = nullptr, Commit *second_parent = nullptr) {
+    Commit *commit = new Commit;
+    commit->message = message;
+    commit->parent = parent;
+    commit->second_parent = second_parent;
+    return commit;
+}
+
+static string render_graph(const vector<const Commit *> &commits, const Commit *head) {
+    ostringstream os;
+    {
+        OutputBuffer out(os);
+        CommitGraph graph(commits);
+        print_graph(out, graph, graph.topo_order(graph.position(head)), LogFormat::compile("%s\n"));
+    }
+    return os.str();
+}
+
+// Criss-cross merges: m1 and m2 both merge y and z, so the second parent of each already has a column
+static void test_print_graph() {
+    Commit *root = make_commit("root");
+    Commit *y = make_commit("y", root), *z = make_commit("z", root);
+    Commit *m1 = make_commit("m1", y, z), *m2 = make_commit("m2", z, y);
+    Commit *tip = make_commit("t", m1, m2);
+    CHECK(render_graph({root, y, z, m1, m2, tip}, tip) == "* t\n"
+                                                         "|\\\n"
+                                                         "| * m2\n"
+                                                         "| |\\\n"
+                                                         "* | | m1\n"
+                                                         "|\\| |\n"
+                                                         "|_|/\n"
+                                                         "| * z\n"
+                                                         "* | y\n"
+                                                         "|/\n"
+                                                         "* root\n");
+
+    // The second parent of b is on the line to its left
+    Commit *c = make_commit("c", root), *a = make_commit("a", root);
+    Commit *b = make_commit("b", c, a);
+    Commit *top = make_commit("top", a, b);
+    CHECK(render_graph({root, a, b, c, top}, top) == "* top\n"
+                                                      "|\\\n"
+                                                      "| * b\n"
+                                                      "|/|\n"
+                                                      "* | a\n"
+                                                      "| * c\n"
+                                                      "|/\n"
+                                                      "* root\n");
+
+    for (Commit *commit : {root, y, z, m1, m2, tip, a, b, c, top}) {
+        delete commit;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    vector<pair<string, function<void()>>> tests = {
+        {"merge_lines", test_merge_lines},
+        {"merge_blobs", test_merge_blobs},
+        {"plan_merge", test_plan_merge},
+        {"trees", test_trees},
+        {"file_list", test_file_list},
+        {"ignore", test_ignore},
+        {"ignore_globstar", test_ignore_globstar},
+        {"ewah", test_ewah},
+        {"branch_table", test_branch_table},
+        {"time_index", test_time_index},
+        {"print_graph", test_print_graph},
+    };
+
+    int run = 0;
+    for (auto &test : tests) {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc; ++i) {
+            selected |= test.first == argv[i];
+        }
+        if (!selected)
+            continue;
+        int before = failures;
+        test.second();
+        cout << (failures == before ? "PASSED " : "FAILED ") << test.first << endl;
+        ++run;
+    }
+    cout << run << " tests run, " << failures << " checks failed" << endl;
+    return failures == 0 ? 0 : 1;
+}